@@ -0,0 +1,376 @@
+/**
+ * @file bench.c
+ * @brief Resource Khan benchmarks.
+ * https://github.com/schilkp/ResourceKhan
+ *
+ * Generates synthetic graphs of increasing size, and measures the time (ns/op) and the number
+ * of node callbacks (node visits/op) of all graph operations.
+ *
+ * Usage: bench [-c] [max_nodes]
+ *   -c         Compile all graphs (see rk_csr).
+ *   max_nodes  Largest graph size to benchmark (default: 1000000, at most BENCH_MAX_NODES).
+ *
+ * The benchmark links against the same library as the tests. Informational logging would dominate
+ * all measurements, so configure the build with -DRK_CONF_DIR=bench to use the configuration in
+ * bench/resource_khan_conf_custom.h.
+ */
+#include "resource_khan.h"
+#include "resource_khan_ext.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Largest supported graph size. Node and client names are numbered using 32-bit indices:
+#define BENCH_MAX_NODES UINT32_MAX
+
+// ==== Graphs =================================================================
+
+struct bench_graph {
+  struct rk_graph graph;
+  struct rk_arena arena;
+  struct rk_csr csr;
+
+  struct rk_node *nodes;
+  struct rk_node **node_list;
+  size_t node_count;
+
+  struct rk_client *clients;
+  size_t client_count;
+
+  // Clients that are enabled/disabled during the benchmark:
+  struct rk_client **bench_clients;
+  size_t bench_client_count;
+};
+
+static uint64_t visits = 0;
+
+static int bench_cb_update(const struct rk_node *self) {
+  (void)self;
+  visits++;
+  return 0;
+}
+
+static void *bench_alloc(size_t size) {
+  void *ptr = calloc(1, size);
+  if (ptr == 0) {
+    printf("ERR: Out of memory.\n");
+    exit(1);
+  }
+  return ptr;
+}
+
+static void graph_alloc(struct bench_graph *bg, size_t node_count, size_t client_count, size_t edge_count) {
+  memset(bg, 0, sizeof(*bg));
+
+  if (node_count > BENCH_MAX_NODES || client_count > BENCH_MAX_NODES) {
+    printf("ERR: Graph too large.\n");
+    exit(1);
+  }
+
+  bg->nodes = bench_alloc(node_count * sizeof(struct rk_node));
+  bg->node_list = bench_alloc(node_count * sizeof(struct rk_node *));
+  bg->node_count = node_count;
+  bg->clients = bench_alloc((client_count + 1) * sizeof(struct rk_client));
+  bg->client_count = client_count;
+  bg->bench_clients = bench_alloc((client_count + 1) * sizeof(struct rk_client *));
+
+  // Every edge is stored twice. Arrays grow by doubling and may be copied while growing:
+  bg->arena.size = 8 * (edge_count + node_count) * sizeof(void *);
+  bg->arena.buf = bench_alloc(bg->arena.size);
+
+  for (size_t i = 0; i < node_count; i++) {
+    struct rk_node *node = &bg->nodes[i];
+    snprintf(node->name, sizeof(node->name), "n%u", (unsigned int)i);
+    node->cb_update = bench_cb_update;
+    bg->node_list[i] = node;
+  }
+  for (size_t i = 0; i < client_count; i++) {
+    snprintf(bg->clients[i].name, sizeof(bg->clients[i].name), "c%u", (unsigned int)i);
+  }
+
+  bg->graph.nodes = bg->node_list;
+  bg->graph.node_count = node_count;
+  bg->graph.root = &bg->nodes[0];
+}
+
+static void graph_free(struct bench_graph *bg) {
+  free(bg->nodes);
+  free(bg->node_list);
+  free(bg->clients);
+  free(bg->bench_clients);
+  free(bg->arena.buf);
+  free(bg->csr.buf);
+}
+
+static void add_child(struct bench_graph *bg, size_t node, size_t child) {
+  if (rk_node_add_child_arena(&bg->arena, &bg->nodes[node], &bg->nodes[child])) exit(1);
+}
+
+static void add_client(struct bench_graph *bg, size_t node, size_t client) {
+  if (rk_node_add_client_arena(&bg->arena, &bg->nodes[node], &bg->clients[client])) exit(1);
+}
+
+static void add_bench_client(struct bench_graph *bg, size_t client) {
+  bg->bench_clients[bg->bench_client_count++] = &bg->clients[client];
+}
+
+// Chain of n nodes with a single client at the end.
+static void gen_chain(struct bench_graph *bg, size_t n) {
+  graph_alloc(bg, n, 1, n);
+  for (size_t i = 1; i < n; i++) {
+    add_child(bg, i - 1, i);
+  }
+  add_client(bg, n - 1, 0);
+  add_bench_client(bg, 0);
+}
+
+// Root with n-1 children, each with a single client.
+static void gen_fan(struct bench_graph *bg, size_t n) {
+  graph_alloc(bg, n, n - 1, 2 * n);
+  for (size_t i = 1; i < n; i++) {
+    add_child(bg, 0, i);
+    add_client(bg, i, i - 1);
+    add_bench_client(bg, i - 1);
+  }
+}
+
+// Square lattice in which every node depends on its upper and left neighbour. Every node of
+// the last row has a client.
+static void gen_lattice(struct bench_graph *bg, size_t n) {
+  size_t side = (size_t)sqrt((double)n);
+  if (side < 2) side = 2;
+  n = side * side;
+
+  graph_alloc(bg, n, side, 3 * n);
+  for (size_t row = 0; row < side; row++) {
+    for (size_t col = 0; col < side; col++) {
+      size_t idx = row * side + col;
+      if (row > 0) add_child(bg, idx - side, idx);
+      if (col > 0) add_child(bg, idx - 1, idx);
+    }
+  }
+  for (size_t col = 0; col < side; col++) {
+    add_client(bg, (side - 1) * side + col, col);
+    add_bench_client(bg, col);
+  }
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t bench_rand(void) {
+  // xorshift32:
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+// Layers of sqrt(n) nodes. Every node depends on 1 to 3 random nodes of the previous layer, and
+// every node of the last layer has a client.
+static void gen_layered(struct bench_graph *bg, size_t n) {
+  size_t width = (size_t)sqrt((double)n);
+  if (width < 1) width = 1;
+  rand_state = 1;
+
+  graph_alloc(bg, n, width, 4 * n);
+  for (size_t idx = 1; idx < n; idx++) {
+    size_t layer_start = 1 + ((idx - 1) / width) * width;
+
+    if (layer_start == 1) {
+      add_child(bg, 0, idx);
+      continue;
+    }
+
+    size_t prev_start = layer_start - width;
+    size_t parent_count = 1 + bench_rand() % 3;
+    size_t first = bench_rand() % width;
+    for (size_t i = 0; i < parent_count; i++) {
+      add_child(bg, prev_start + (first + i) % width, idx);
+    }
+  }
+
+  size_t last_start = 1 + ((n - 2) / width) * width;
+  for (size_t idx = last_start; idx < n; idx++) {
+    add_client(bg, idx, idx - last_start);
+    add_bench_client(bg, idx - last_start);
+  }
+}
+
+// n/8 copies of the test_complex1 graph below a common root.
+static void gen_complex1(struct bench_graph *bg, size_t n) {
+  size_t copies = n / 8 > 0 ? n / 8 : 1;
+
+  graph_alloc(bg, 1 + 8 * copies, 10 * copies, 20 * copies);
+  for (size_t copy = 0; copy < copies; copy++) {
+    size_t root = 1 + 8 * copy;
+    size_t a = root + 1, b = root + 2, c = root + 3, d = root + 4, e = root + 5, f = root + 6, g = root + 7;
+    size_t client = 10 * copy;
+
+    add_child(bg, 0, root);
+    add_child(bg, root, a);
+    add_child(bg, root, b);
+    add_child(bg, a, d);
+    add_child(bg, a, c);
+    add_child(bg, b, e);
+    add_child(bg, d, f);
+    add_child(bg, c, e);
+    add_child(bg, e, f);
+    add_child(bg, f, g);
+
+    add_client(bg, root, client + 0);
+    add_client(bg, a, client + 1);
+    add_client(bg, b, client + 2);
+    add_client(bg, c, client + 3);
+    add_client(bg, c, client + 3);
+    add_client(bg, d, client + 4);
+    add_client(bg, e, client + 5);
+    add_client(bg, f, client + 6);
+    add_client(bg, g, client + 7);
+    add_client(bg, g, client + 8);
+    add_client(bg, a, client + 9);
+    add_client(bg, d, client + 9);
+    add_client(bg, e, client + 9);
+
+    for (size_t i = 0; i < 10; i++) {
+      add_bench_client(bg, client + i);
+    }
+  }
+}
+
+struct generator {
+  const char *name;
+  void (*gen)(struct bench_graph *bg, size_t n);
+};
+
+static const struct generator generators[] = {
+    {"chain", gen_chain},     {"fan", gen_fan},           {"lattice", gen_lattice},
+    {"layered", gen_layered}, {"complex1", gen_complex1},
+};
+
+// ==== Measurements ===========================================================
+
+// Minimum measurement duration per operation:
+#define BENCH_MIN_NS   (50 * 1000 * 1000)
+#define BENCH_MAX_REPS 100000
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void report(const char *graph, size_t node_count, const char *op, uint64_t ns, uint64_t op_visits,
+                   size_t reps, bool count_visits) {
+  printf("%-10s %10zu  %-10s %14.1f", graph, node_count, op, (double)ns / (double)reps);
+  if (count_visits) {
+    printf(" %14.1f\n", (double)op_visits / (double)reps);
+  } else {
+    printf(" %14s\n", "-");
+  }
+}
+
+static void check(int err, const char *op) {
+  if (err) {
+    printf("ERR: %s failed (%i).\n", op, err);
+    exit(1);
+  }
+}
+
+static size_t dot_bytes = 0;
+
+static void dot_out(const char *msg) { dot_bytes += strlen(msg); }
+
+static void bench_graph(const struct generator *generator, size_t n, bool compile) {
+  struct bench_graph bg;
+  generator->gen(&bg, n);
+
+  if (compile) {
+    bg.csr.buf_size = rk_csr_size(&bg.graph);
+    bg.csr.buf = bench_alloc(bg.csr.buf_size);
+    bg.graph.csr = &bg.csr;
+  }
+
+  const char *name = generator->name;
+  size_t node_count = bg.node_count;
+  size_t reps;
+  uint64_t start;
+
+  // rk_init:
+  start = now_ns();
+  for (reps = 0; reps == 0 || (now_ns() - start < BENCH_MIN_NS && reps < BENCH_MAX_REPS); reps++) {
+    check(rk_init(&bg.graph), "rk_init");
+  }
+  report(name, node_count, "init", now_ns() - start, 0, reps, false);
+
+  // rk_enable_client/rk_disable_client, cycling through all benchmark clients:
+  uint64_t enable_ns = 0, disable_ns = 0, enable_visits = 0, disable_visits = 0;
+  start = now_ns();
+  for (reps = 0; reps == 0 || (now_ns() - start < 2 * BENCH_MIN_NS && reps < BENCH_MAX_REPS); reps++) {
+    struct rk_client *client = bg.bench_clients[reps % bg.bench_client_count];
+
+    visits = 0;
+    uint64_t op_start = now_ns();
+    check(rk_enable_client(&bg.graph, client), "rk_enable_client");
+    enable_ns += now_ns() - op_start;
+    enable_visits += visits;
+
+    visits = 0;
+    op_start = now_ns();
+    check(rk_disable_client(&bg.graph, client), "rk_disable_client");
+    disable_ns += now_ns() - op_start;
+    disable_visits += visits;
+  }
+  report(name, node_count, "enable", enable_ns, enable_visits, reps, true);
+  report(name, node_count, "disable", disable_ns, disable_visits, reps, true);
+
+  // rk_optimize, with a single client enabled:
+  check(rk_enable_client(&bg.graph, bg.bench_clients[0]), "rk_enable_client");
+  visits = 0;
+  start = now_ns();
+  for (reps = 0; reps == 0 || (now_ns() - start < BENCH_MIN_NS && reps < BENCH_MAX_REPS); reps++) {
+    check(rk_optimize(&bg.graph), "rk_optimize");
+  }
+  report(name, node_count, "optimize", now_ns() - start, visits, reps, true);
+
+  // rk_exportdot_cb:
+  struct rk_dot_params params = {.include_state = true};
+  start = now_ns();
+  for (reps = 0; reps == 0 || (now_ns() - start < BENCH_MIN_NS && reps < BENCH_MAX_REPS); reps++) {
+    check(rk_exportdot_cb(&bg.graph, dot_out, &params), "rk_exportdot_cb");
+  }
+  report(name, node_count, "exportdot", now_ns() - start, 0, reps, false);
+
+  graph_free(&bg);
+}
+
+// ==== Main ===================================================================
+
+int main(int argc, char **argv) {
+  bool compile = false;
+  size_t max_nodes = 1000000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-c") == 0) {
+      compile = true;
+    } else {
+      max_nodes = strtoul(argv[i], 0, 10);
+      if (max_nodes > BENCH_MAX_NODES) {
+        printf("ERR: max_nodes must be at most %u.\n", (unsigned int)BENCH_MAX_NODES);
+        return 1;
+      }
+    }
+  }
+
+  printf("%-10s %10s  %-10s %14s %14s\n", "graph", "nodes", "op", "ns/op", "visits/op");
+
+  for (size_t g = 0; g < sizeof(generators) / sizeof(generators[0]); g++) {
+    for (size_t n = 10; n <= max_nodes; n *= 10) {
+      bench_graph(&generators[g], n, compile);
+    }
+  }
+
+  return 0;
+}
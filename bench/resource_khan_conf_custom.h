@@ -0,0 +1,30 @@
+/**
+ * @file resource_khan_conf_custom.h
+ * @brief Resource Khan configuration used by the benchmarks.
+ * https://github.com/schilkp/ResourceKhan
+ *
+ * Disables informational logging (which would otherwise dominate all measurements), and removes
+ * the default arena: All adjacency arrays are stored in the benchmark graphs' own arenas.
+ */
+#ifndef RESOURCE_KHAN_CONF_CUSTOM_H_
+#define RESOURCE_KHAN_CONF_CUSTOM_H_
+
+#include <stdio.h>
+
+#define RK_MAX_NAME_LEN 15
+#define RK_ERR          1
+
+#define RK_DEFAULT_ARENA_SIZE 0
+
+#define RK_LOG_INF(_fmt_, ...)                                                                                         \
+  do {                                                                                                                 \
+  } while (0)
+
+#define RK_LOG_ERR(_fmt_, ...)                                                                                         \
+  do {                                                                                                                 \
+    printf("ERR: "_fmt_                                                                                                \
+           "\n",                                                                                                       \
+           __VA_ARGS__);                                                                                               \
+  } while (0)
+
+#endif /* RESOURCE_KHAN_CONF_CUSTOM_H_ */
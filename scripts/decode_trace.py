@@ -0,0 +1,75 @@
+import argparse
+import struct
+import sys
+from typing import List, Optional
+
+# Layout of 'struct rk_trace_record' (see src/resource_khan.h):
+#   uint32_t timestamp, uint32_t duration, uint32_t node, int32_t cb_return,
+#   uint8_t old_state, uint8_t new_state, uint16_t type
+RECORD = struct.Struct("IIIiBBH")
+
+# 'enum rk_trace_type':
+TRACE_UPDATE = 0
+TRACE_REQUEST = 1
+
+# 'enum rk_trace_request', stored in the node field of request records:
+REQUEST_NAMES = ["rk_enable_client", "rk_enable_client_atomic", "rk_disable_client", "rk_apply", "rk_optimize",
+                 "rk_optimize_dirty", "rk_node_fault", "rk_node_recover"]
+
+
+def on_off(state: int) -> str:
+    return "ON" if state else "OFF"
+
+
+def decode(data: bytes, names: Optional[List[str]], byteorder: str):
+    record = struct.Struct(byteorder + RECORD.format)
+
+    if len(data) % record.size != 0:
+        print(f"Warning: Trailing {len(data) % record.size} bytes ignored.", file=sys.stderr)
+
+    for offset in range(0, len(data) - record.size + 1, record.size):
+        timestamp, duration, node, cb_return, old_state, new_state, kind = record.unpack_from(data, offset)
+
+        if kind == TRACE_REQUEST:
+            request = REQUEST_NAMES[node] if node < len(REQUEST_NAMES) else f"request[{node}]"
+            line = f"{timestamp:>10} {duration:>10}  {request}()"
+            if cb_return != 0:
+                line += f" (returned {cb_return})"
+            print(line)
+            continue
+
+        if names is not None and node < len(names):
+            name = names[node]
+        else:
+            name = f"node[{node}]"
+
+        line = f"{timestamp:>10} {duration:>10}  {name}: {on_off(old_state)} -> {on_off(new_state)}"
+        if cb_return != 0:
+            line += f" (callback returned {cb_return})"
+        print(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode a binary ResourceKhan event trace.")
+    parser.add_argument('trace', help="File containing raw trace records, as read using rk_trace_read().")
+    parser.add_argument('-n', '--names', required=False,
+                        help="File containing the name of every node, one per line, in the order of the graph's "
+                        "node array.")
+    parser.add_argument('-b', '--big-endian', required=False, action="store_true",
+                        help="Trace was recorded on a big-endian target.")
+    args = parser.parse_args()
+
+    names = None
+    if args.names:
+        with open(args.names) as f:
+            names = [line.strip() for line in f]
+
+    with open(args.trace, 'rb') as f:
+        data = f.read()
+
+    print(f"{'timestamp':>10} {'duration':>10}  event")
+    decode(data, names, '>' if args.big_endian else '<')
+
+
+if __name__ == '__main__':
+    main()
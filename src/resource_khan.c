@@ -9,12 +9,108 @@
 
 // ==== Private Prototypes =====================================================
 
+// Queue of nodes of an asynchronous request whose dependencies have all settled.
+struct rk_ready_queue {
+  struct rk_node *head;
+  struct rk_node *tail;
+};
+
 static void reset_node_ctx_all(struct rk_graph *pt);
-static void reset_node_ctx_ll_trv(struct rk_graph *pt);
-static int enable_node(struct rk_graph *pt, struct rk_node *node);
-static int optimize_node(struct rk_graph *pt, struct rk_node *node);
-static int update_node(struct rk_node *node, bool new_state);
-static bool has_active_dependant(struct rk_node *node);
+static int enable_client(struct rk_graph *pt, struct rk_client *client, bool atomic);
+static int disable_client(struct rk_graph *pt, struct rk_client *client);
+static int shard_enable_client(struct rk_graph *pt, struct rk_client *client, bool atomic);
+static int shard_disable_client(struct rk_graph *pt, struct rk_client *client);
+static int shard_update(struct rk_graph *pt, struct rk_node *node, bool new_state);
+static void shard_set_client_state(struct rk_graph *pt, struct rk_client *client, bool enabled);
+static void start_shard_traversal(struct rk_shard *shard);
+static void shard_release_node(struct rk_graph *pt, struct rk_node **stack, struct rk_node *node,
+                               bool *root_released);
+static int collect_shard_traversal(struct rk_graph *pt, struct rk_node *node, struct rk_node **trv_head,
+                                   bool *root_reached);
+static uint32_t client_shard(struct rk_graph *pt, struct rk_client *client);
+static int optimize_graph(struct rk_graph *pt);
+static int optimize_dirty(struct rk_graph *pt);
+static int optimize_bitset(struct rk_graph *pt);
+static void mark_dirty(struct rk_graph *pt, struct rk_node *node);
+static void mark_client_dirty(struct rk_graph *pt, struct rk_client *client);
+static void clear_dirty(struct rk_graph *pt);
+static void clear_dirty_list(struct rk_node **head);
+static void unmark_dirty(struct rk_graph *pt, struct rk_node *node);
+static void start_traversal(struct rk_graph *pt);
+static int enable_node(struct rk_graph *pt, struct rk_node *node, struct rk_node **undo_log);
+static int enable_plan(struct rk_graph *pt, struct rk_client *client, struct rk_node **undo_log);
+static int enable_step(struct rk_graph *pt, struct rk_node *node, struct rk_node **undo_log);
+static int check_fault(struct rk_node *node);
+static void rollback_enable(struct rk_graph *pt, struct rk_node *undo_log);
+static void release_node(struct rk_graph *pt, struct rk_node **stack, struct rk_node *node);
+static int disable_released(struct rk_graph *pt, struct rk_node *stack);
+static int collect_descendants(struct rk_graph *pt, struct rk_node *node, bool reverse, struct rk_node **trv_head);
+static int fault_node(struct rk_graph *pt, struct rk_node *node);
+static int recover_node(struct rk_graph *pt, struct rk_node *node);
+static int collect_traversal(struct rk_graph *pt, struct rk_node **trv_head, bool reverse, bool prune);
+static int flood_ancestors(struct rk_graph *pt, struct rk_node *trv_head, struct rk_node *trv_tail);
+static struct rk_node *countdown_traversal(struct rk_node *list, bool upward, struct rk_node *skip);
+static struct rk_node *reverse_traversal(struct rk_node *list);
+static struct rk_node *heap_meld(struct rk_node *a, struct rk_node *b);
+static struct rk_node *heap_pop(struct rk_node **heap);
+static struct rk_node *sort_traversal(struct rk_node *list, bool reverse);
+static struct rk_node *csr_collect_traversal(struct rk_graph *pt, struct rk_node *trv_head, bool reverse, bool prune);
+static void csr_heap_push(struct rk_csr *csr, size_t *heap_len, uint32_t idx);
+static uint32_t csr_heap_pop(struct rk_csr *csr, size_t *heap_len);
+static size_t csr_layout(struct rk_graph *pt, struct rk_csr *csr, uint8_t *buf);
+static int compile_csr(struct rk_graph *pt);
+static int plans_layout(struct rk_graph *pt, struct rk_node **buf, size_t *entry_count);
+static size_t count_ancestors(struct rk_graph *pt, struct rk_node *node);
+static void reset_plans(struct rk_graph *pt);
+static int build_plans(struct rk_graph *pt);
+static int impact_layout(struct rk_graph *pt, struct rk_client **buf, size_t *entry_count);
+static int build_impact(struct rk_graph *pt);
+static size_t bitset_layout(struct rk_graph *pt, struct rk_bitset *bs, uint8_t *buf);
+static int build_bitset(struct rk_graph *pt);
+static int shards_layout(struct rk_graph *pt, struct rk_shard *shards, size_t *shard_count);
+static int build_shards(struct rk_graph *pt);
+static int update_node(struct rk_graph *pt, struct rk_node *node, bool new_state);
+static int call_update(struct rk_graph *pt, struct rk_node *node, bool new_state);
+static int start_update(struct rk_graph *pt, struct rk_node *node, bool new_state, bool dispatch);
+static int finish_update(struct rk_graph *pt, struct rk_node *node, int err);
+static void ready_push(struct rk_ready_queue *q, struct rk_node *node);
+static struct rk_node *ready_pop(struct rk_ready_queue *q);
+static void settle_node(struct rk_graph *pt, struct rk_ready_queue *q, struct rk_node *node, int err);
+static int run_request(struct rk_graph *pt, struct rk_ready_queue *q);
+static void set_node_state(struct rk_node *node, bool state);
+static void set_client_state(struct rk_client *client, bool enabled);
+static int count_active_dependants(struct rk_graph *pt);
+static bool graph_is_modifiable(struct rk_graph *pt, struct rk_node *node);
+static int invalidate_indices(struct rk_graph *pt);
+static int refresh_indices(struct rk_graph *pt);
+static int rebuild_indices(struct rk_graph *pt);
+static struct rk_node *take_dirty(struct rk_graph *pt);
+static int check_new_edge(struct rk_graph *pt, struct rk_node *node, struct rk_node *child);
+static void reorder_topo(struct rk_graph *pt, struct rk_node *node, struct rk_node *child);
+static struct rk_node *next_in_group(struct rk_graph *pt, struct rk_node *node, bool backward);
+static bool has_child_edge(struct rk_node *node, struct rk_node *child);
+static bool has_client_edge(struct rk_node *node, struct rk_client *client);
+static void append_topo(struct rk_graph *pt, struct rk_node *node);
+static void unlink_topo(struct rk_graph *pt, struct rk_node *node);
+static int simplify_graph(struct rk_graph *pt);
+static int mark_redundant_parents(struct rk_graph *pt, struct rk_node **parents, uint32_t parent_count);
+static void remove_child_edge(struct rk_node *node, struct rk_node *child);
+static void remove_client_edge(struct rk_node *node, struct rk_client *client);
+static void *grow_array(struct rk_arena *arena, void *array, uint32_t count, uint32_t *capacity, size_t elem_size);
+static bool has_active_dependant(struct rk_graph *pt, struct rk_node *node);
+static void trace_update(struct rk_graph *pt, struct rk_node *node, bool old_state, int err);
+static void trace_request(struct rk_graph *pt, uint32_t request, uint32_t start, int err);
+static void trace_push(struct rk_trace *trace, const struct rk_trace_record *record);
+static uint32_t hist_bucket(uint32_t value);
+static uint32_t hist_bucket_max(uint32_t bucket);
+
+#if RK_DEFAULT_ARENA_SIZE > 0
+// Memory of the default arena. Declared as an array of pointers, which is suitably aligned:
+static void *default_arena_buf[(RK_DEFAULT_ARENA_SIZE + sizeof(void *) - 1) / sizeof(void *)];
+static struct rk_arena default_arena = {.buf = default_arena_buf, .size = sizeof(default_arena_buf)};
+#else
+static struct rk_arena default_arena = {0};
+#endif
 
 static inline bool handle_contains_nullptr(struct rk_graph *graph) {
   if (graph == 0) return true;
@@ -23,6 +119,14 @@ static inline bool handle_contains_nullptr(struct rk_graph *graph) {
   return false;
 }
 
+static inline bool graph_is_busy(struct rk_graph *graph) {
+  if (graph->req_remaining != 0) {
+    RK_LOG_ERR("Graph is busy: %zd nodes of an asynchronous request have not yet settled.", graph->req_remaining);
+    return true;
+  }
+  return false;
+}
+
 static inline bool node_contains_nullptr(struct rk_node *node) {
   if (node == 0) return true;
   for (size_t i = 0; i < node->child_count; i++) {
@@ -38,346 +142,3391 @@ static inline bool node_contains_nullptr(struct rk_node *node) {
   return false;
 }
 
-#define RK_ON_OFF(_i_) ((_i_) ? "ON" : "OFF")
+// Check if a node is in the "traverse" list of the current traversal.
+static inline bool in_traversal(struct rk_graph *pt, struct rk_node *node) {
+  return node->ctx.trv_epoch == pt->trv_epoch;
+}
 
-// ==== Public Functions =======================================================
+// Add a node to the current traversal. Does not link it into the "traverse" list.
+static inline void mark_traversed(struct rk_graph *pt, struct rk_node *node) {
+  node->ctx.trv_epoch = pt->trv_epoch;
+  node->ctx.ll_trv = 0;
+  node->ctx.ll_heap = 0;
+  node->ctx.trv_delta = 0;
+  node->ctx.trv_pending = 0;
+}
 
-int rk_enable_client(struct rk_graph *pt, struct rk_client *client) {
-  if (handle_contains_nullptr(pt)) return RK_ERR;
-  if (client == 0) return RK_ERR;
+// Add a node to the current traversal and append it to the "traverse" list, unless it
+// is already part of it.
+static inline void append_traversed(struct rk_graph *pt, struct rk_node **trv_head, struct rk_node **trv_tail,
+                                    struct rk_node *node) {
+  if (in_traversal(pt, node)) return;
+  mark_traversed(pt, node);
+  if (*trv_tail == 0) {
+    *trv_head = node;
+  } else {
+    (*trv_tail)->ctx.ll_trv = node;
+  }
+  *trv_tail = node;
+}
 
+static inline bool client_contains_nullptr(struct rk_client *client) {
+  if (client == 0) return true;
   for (size_t i = 0; i < client->parent_count; i++) {
-    int err = enable_node(pt, client->parents[i]);
-    if (err) return err;
+    if (client->parents[i] == 0) {
+      return true;
+    }
   }
-
-  client->enabled = true;
-
-  return 0;
+  return false;
 }
 
-int rk_disable_client(struct rk_graph *pt, struct rk_client *client) {
-  if (handle_contains_nullptr(pt)) return RK_ERR;
-  if (client == 0) return RK_ERR;
-
-  client->enabled = false;
+// Read an index from one of the index arrays of a compiled graph.
+static inline uint32_t csr_load(const struct rk_csr *csr, const void *array, size_t i) {
+  return csr->wide ? ((const uint32_t *)array)[i] : ((const uint16_t *)array)[i];
+}
 
-  for (size_t i = 0; i < client->parent_count; i++) {
-    int err = optimize_node(pt, client->parents[i]);
-    if (err) return err;
+// Write an index to one of the index arrays of a compiled graph.
+static inline void csr_store(struct rk_csr *csr, void *array, size_t i, uint32_t value) {
+  if (csr->wide) {
+    ((uint32_t *)array)[i] = value;
+  } else {
+    ((uint16_t *)array)[i] = (uint16_t)value;
   }
+}
 
-  return 0;
+// Get the node preceding a node in topological order.
+static inline struct rk_node *topo_prev(struct rk_graph *pt, struct rk_node *node) {
+  if (pt->csr != 0) {
+    return node->ctx.topo_rank == 0 ? 0 : pt->csr->order[node->ctx.topo_rank - 1];
+  }
+  return node->ctx.ll_topo_prev;
 }
 
-int rk_optimize(struct rk_graph *pt) {
-  if (handle_contains_nullptr(pt)) return RK_ERR;
+// Check if the callback of a node that is being updated is skipped, because its state does not
+// change and the graph or node only calls callbacks on transitions.
+static inline bool cb_elided(struct rk_graph *pt, struct rk_node *node) {
+  if (node->cb_update == 0 || node->desired_state != node->state) return false;
+  return pt->transitions_only || node->transitions_only;
+}
 
-  // Traverse in reverse-topological order, disabling all nodes if they no longer have
-  // any active dependent:
-  struct rk_node *node = pt->ll_topo_tail;
+// Get the current time for a latency histogram (if given).
+static inline uint32_t latency_now(struct rk_graph *pt, struct rk_histogram *hist) {
+  return hist != 0 ? pt->cb_timestamp() : 0;
+}
 
-  while (node != 0) {
+// Record the time since start in a latency histogram (if given).
+static inline void record_latency(struct rk_graph *pt, struct rk_histogram *hist, uint32_t start) {
+  if (hist != 0) {
+    rk_histogram_record(hist, pt->cb_timestamp() - start);
+  }
+}
 
-    if (node_contains_nullptr(node)) {
-      RK_LOG_ERR("Node '%s' contains a null pointer.", node->name);
-      return RK_ERR;
+// Get the index of the most significant set bit of a non-zero word.
+static inline uint32_t highest_bit(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+  return 63u - (uint32_t)__builtin_clzll(word);
+#else
+  uint32_t bit = 0;
+  for (uint32_t shift = 32; shift != 0; shift /= 2) {
+    if ((word >> shift) != 0) {
+      word >>= shift;
+      bit += shift;
     }
+  }
+  return bit;
+#endif
+}
 
-    int err = update_node(node, has_active_dependant(node));
-    if (err) return err;
-
-    node = node->ctx.ll_topo_prev;
+// Set or clear a bit in a bitset.
+static inline void bitset_assign(uint64_t *bits, uint32_t idx, bool value) {
+  uint64_t mask = (uint64_t)1 << (idx % 64);
+  if (value) {
+    bits[idx / 64] |= mask;
+  } else {
+    bits[idx / 64] &= ~mask;
   }
+}
 
-  return 0;
+// Take one of the locks of a graph (if it is sharded).
+static inline void lock_shard(struct rk_graph *pt, uint32_t shard) {
+  if (pt->shards != 0) {
+    pt->shards->cb_lock(pt, shard);
+  }
 }
 
-int rk_node_add_child(struct rk_node *node, struct rk_node *child) {
-  if (node == 0) return RK_ERR;
-  if (child == 0) return RK_ERR;
+// Release one of the locks of a graph (if it is sharded).
+static inline void unlock_shard(struct rk_graph *pt, uint32_t shard) {
+  if (pt->shards != 0) {
+    pt->shards->cb_unlock(pt, shard);
+  }
+}
 
-  if (node->child_count == RK_MAX_CHILDREN) {
-    RK_LOG_ERR("Cannot add child to node '%s': Node already contains %u children.", node->name, RK_MAX_CHILDREN);
-    return RK_ERR;
+// Check if the root is one of the given parents.
+static inline bool has_root_parent(struct rk_graph *pt, struct rk_node **parents, uint32_t parent_count) {
+  for (uint32_t i = 0; i < parent_count; i++) {
+    if (parents[i] == pt->root) return true;
   }
+  return false;
+}
 
-  if (child->parent_count == RK_MAX_PARENTS) {
-    RK_LOG_ERR("Cannot add node '%s' as a child: Node already has %u parents.", child->name, RK_MAX_PARENTS);
-    return RK_ERR;
+// Get the "dirty" list a node is tracked in: The list of its shard (if the graph is sharded), so that
+// it can be marked while only holding the lock of the shard, or the list of the graph.
+static inline struct rk_node **dirty_list(struct rk_graph *pt, struct rk_node *node) {
+  if (pt->shards != 0 && node->ctx.shard < pt->shards->shard_count) {
+    return &pt->shards->shard[node->ctx.shard].ll_dirty_head;
   }
+  return &pt->ll_dirty_head;
+}
 
-  node->children[node->child_count] = child;
-  node->child_count++;
-  child->parents[child->parent_count] = node;
-  child->parent_count++;
+#define RK_ON_OFF(_i_) ((_i_) ? "ON" : "OFF")
 
-  return 0;
+// Add to one of the graph's work counters (if it has any).
+#define RK_COUNT(_pt_, _counter_, _n_)                                                                               \
+  do {                                                                                                                 \
+    if ((_pt_)->stats != 0) {                                                                                          \
+      atomic_fetch_add_explicit(&(_pt_)->stats->_counter_, (uint32_t)(_n_), memory_order_relaxed);                     \
+    }                                                                                                                  \
+  } while (0)
+
+// Count a new request, and get the time at which it started (if the graph has a trace).
+static inline uint32_t start_request(struct rk_graph *pt) {
+  RK_COUNT(pt, requests, 1);
+  return pt->trace != 0 ? pt->trace->cb_timestamp() : 0;
 }
 
-int rk_node_add_client(struct rk_node *node, struct rk_client *client) {
-  if (node == 0) return RK_ERR;
+// ==== Public Functions =======================================================
+
+int rk_enable_client(struct rk_graph *pt, struct rk_client *client) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (graph_is_busy(pt)) return RK_ERR;
   if (client == 0) return RK_ERR;
+  if (refresh_indices(pt)) return RK_ERR;
+
+  uint32_t trace_start = start_request(pt);
+  uint32_t shard = client_shard(pt, client);
+  lock_shard(pt, shard);
+  uint32_t latency_start = latency_now(pt, client->latency);
+  int err = shard != RK_SHARD_ROOT ? shard_enable_client(pt, client, false) : enable_client(pt, client, false);
+  record_latency(pt, client->latency, latency_start);
+  unlock_shard(pt, shard);
+  trace_request(pt, RK_TRACE_ENABLE, trace_start, err);
+
+  return err;
+}
 
-  if (node->client_count == RK_MAX_CHILDREN) {
-    RK_LOG_ERR("Cannot add client to node '%s': Node already contains %u clients.", node->name, RK_MAX_CHILDREN);
-    return RK_ERR;
-  }
+int rk_enable_client_atomic(struct rk_graph *pt, struct rk_client *client) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (graph_is_busy(pt)) return RK_ERR;
+  if (client == 0) return RK_ERR;
+  if (refresh_indices(pt)) return RK_ERR;
+
+  uint32_t trace_start = start_request(pt);
+  uint32_t shard = client_shard(pt, client);
+  lock_shard(pt, shard);
+  uint32_t latency_start = latency_now(pt, client->latency);
+  int err = shard != RK_SHARD_ROOT ? shard_enable_client(pt, client, true) : enable_client(pt, client, true);
+  record_latency(pt, client->latency, latency_start);
+  unlock_shard(pt, shard);
+  trace_request(pt, RK_TRACE_ENABLE_ATOMIC, trace_start, err);
+
+  return err;
+}
 
-  if (client->parent_count == RK_MAX_PARENTS) {
-    RK_LOG_ERR("Cannot add client to node '%s': Client already has %u parents.", client->name, RK_MAX_PARENTS);
-    return RK_ERR;
+int rk_disable_client(struct rk_graph *pt, struct rk_client *client) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (graph_is_busy(pt)) return RK_ERR;
+  if (client == 0) return RK_ERR;
+  if (refresh_indices(pt)) return RK_ERR;
+
+  uint32_t trace_start = start_request(pt);
+  uint32_t shard = client_shard(pt, client);
+  lock_shard(pt, shard);
+  uint32_t latency_start = latency_now(pt, client->latency);
+  int err = shard != RK_SHARD_ROOT ? shard_disable_client(pt, client) : disable_client(pt, client);
+  record_latency(pt, client->latency, latency_start);
+  unlock_shard(pt, shard);
+  trace_request(pt, RK_TRACE_DISABLE, trace_start, err);
+
+  return err;
+}
+
+int rk_apply(struct rk_graph *pt, struct rk_client **enable_list, size_t enable_count, struct rk_client **disable_list,
+             size_t disable_count) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (graph_is_busy(pt)) return RK_ERR;
+  if (enable_list == 0 && enable_count != 0) return RK_ERR;
+  if (disable_list == 0 && disable_count != 0) return RK_ERR;
+  for (size_t i = 0; i < disable_count; i++) {
+    if (client_contains_nullptr(disable_list[i])) return RK_ERR;
   }
+  for (size_t i = 0; i < enable_count; i++) {
+    if (client_contains_nullptr(enable_list[i])) return RK_ERR;
+  }
+  if (refresh_indices(pt)) return RK_ERR;
 
-  node->clients[node->client_count] = client;
-  node->client_count++;
-  client->parents[client->parent_count] = node;
-  client->parent_count++;
+  pt->req_trace_start = start_request(pt);
 
-  return 0;
-}
+  // == STEP 1: Flood from the parents of all clients up to the root to discover all nodes which require an update ==
 
-int rk_init(struct rk_graph *pt) {
-  if (handle_contains_nullptr(pt)) return RK_ERR;
+  start_traversal(pt);
 
-  reset_node_ctx_all(pt);
+  struct rk_node *trv_head = 0;
+  struct rk_node *trv_tail = 0;
 
-  // == Topological sort (Kahn's algorithm): ==
+  for (size_t i = 0; i < disable_count; i++) {
+    struct rk_client *client = disable_list[i];
 
-  // The "topo" doubly-linked-list (stored in the nodes themselves) serves
-  // as the L list, storing all sorted nodes:
-  struct rk_node *ll_topo_tail = 0;
+    // Stamp client so that it is not enabled if also contained in the enable list:
+    client->trv_epoch = pt->trv_epoch;
 
-  // The "trv" traversal single-linked list (also stored in the nodes themselves)
-  // serves as the S list, storing nodes that are not yet in L, but already have
-  // no parents when ignoring all nodes already in L. They are next candidates
-  // to be added to L.
-  struct rk_node *trv_head = pt->root;
-  struct rk_node *trv_tail = pt->root;
+    for (size_t parent_idx = 0; parent_idx < client->parent_count; parent_idx++) {
+      append_traversed(pt, &trv_head, &trv_tail, client->parents[parent_idx]);
+    }
+  }
 
-  while (trv_head != 0) {
-    // Append trv_head to topo list (L):
-    if (ll_topo_tail == 0) {
-      ll_topo_tail = trv_head;
-    } else {
-      trv_head->ctx.ll_topo_prev = ll_topo_tail;
-      ll_topo_tail->ctx.ll_topo_next = trv_head;
-      ll_topo_tail = trv_head;
+  for (size_t i = 0; i < enable_count; i++) {
+    struct rk_client *client = enable_list[i];
+
+    for (size_t parent_idx = 0; parent_idx < client->parent_count; parent_idx++) {
+      append_traversed(pt, &trv_head, &trv_tail, client->parents[parent_idx]);
     }
+  }
 
-    // Check all children nodes. If they no longer have any parents outside of
-    // L, add them to S:
-    for (size_t child_idx = 0; child_idx < trv_head->child_count; child_idx++) {
-      struct rk_node *node_to_check = trv_head->children[child_idx];
+  if (trv_head == 0) {
+    // Nothing to do.
+    trace_request(pt, RK_TRACE_APPLY, pt->req_trace_start, 0);
+    return 0;
+  }
 
-      // Validate that this child is not inside L, which can only happen if the
-      // graph is not acyclic:
-      if (node_to_check->ctx.ll_topo_next != 0 || ll_topo_tail == node_to_check) {
-        // Cyclic graph. Abort.
-        RK_LOG_ERR("Graph contains cycle, likely involving node '%s'!", node_to_check->name);
-        return RK_ERR;
-      }
+  // Sort in reverse-topological order, so that every node's children have already settled
+  // on their final state once it is reached in step 2:
+  int err = collect_traversal(pt, &trv_head, true, false);
+  if (err) {
+    trace_request(pt, RK_TRACE_APPLY, pt->req_trace_start, err);
+    return err;
+  }
 
-      bool has_parent_outside_l = false;
-      for (size_t parent_idx = 0; parent_idx < node_to_check->parent_count; parent_idx++) {
-        struct rk_node *parent = node_to_check->parents[parent_idx];
+  // == STEP 2: Determine the final state of all nodes traversed in step 1 ==
 
-        if (parent->ctx.ll_topo_next == 0 && parent != ll_topo_tail) { // Check if not in L.
-          has_parent_outside_l = true;
-          break;
-        }
-      }
+  for (size_t i = 0; i < disable_count; i++) {
+    set_client_state(disable_list[i], false);
+    disable_list[i]->unserved = false;
+  }
 
-      // Add to trv list (S):
-      if (!has_parent_outside_l) {
-        // Check if node_to_check is already in S, which can happen
-        // if the node contains redundant parallel edges between nodes:
-        if (node_to_check->ctx.ll_trv != 0 || node_to_check == trv_tail) {
-          continue;
-        }
-        trv_tail->ctx.ll_trv = node_to_check;
-        trv_tail = node_to_check;
-      }
-    }
+  // Clients that are about to be enabled only count as active dependants once all their
+  // parents are enabled, so their demand is recorded separately:
+  for (size_t i = 0; i < enable_count; i++) {
+    struct rk_client *client = enable_list[i];
+    if (client->enabled || client->trv_epoch == pt->trv_epoch) continue;
 
-    // Advance traversal list (S), effectively removing the current node from it:
-    trv_head = trv_head->ctx.ll_trv;
+    for (size_t parent_idx = 0; parent_idx < client->parent_count; parent_idx++) {
+      client->parents[parent_idx]->ctx.trv_delta++;
+    }
   }
 
-  // == Validate that graph is acyclic & connected ==
-  size_t topo_count = 0;
-  struct rk_node *ll_topo_head = pt->root;
+  // Propagate the final state of every node to its parents:
+  for (struct rk_node *node = trv_head; node != 0; node = node->ctx.ll_trv) {
 
-  while (ll_topo_head != 0) {
-    topo_count++;
-    ll_topo_head = ll_topo_head->ctx.ll_topo_next;
+    RK_COUNT(pt, topo_visits, 1);
+    RK_COUNT(pt, dependant_evals, 1);
+    node->desired_state = ((int64_t)node->ctx.active_dependants + node->ctx.trv_delta) > 0;
+
+    if (node->desired_state != node->state) {
+      for (size_t i = 0; i < node->parent_count; i++) {
+        node->parents[i]->ctx.trv_delta += node->desired_state ? 1 : -1;
+      }
+    }
   }
 
-  if (topo_count != pt->node_count) {
-    RK_LOG_ERR("Graph malformed. It may contain nodes not in the node list, be cyclic or be disconnected. "
-               "Topological list contains %zd elements, but graph claims to have %zd nodes!",
-               topo_count, pt->node_count);
-    return RK_ERR;
+  // == STEP 3: Determine the dependencies between all updates ==
+
+  // A node that is to be enabled has to wait for all its parents to be enabled. A node that is
+  // to be disabled has to wait for all its children that are also to be disabled. There are no
+  // dependencies between the two groups: The parents of a node that remains enabled also remain
+  // enabled, and the children of a node that is disabled are not enabled.
+  pt->req_remaining = 0;
+  pt->req_err = 0;
+  pt->req_enable_list = enable_list;
+  pt->req_enable_count = enable_count;
+
+  for (struct rk_node *node = trv_head; node != 0; node = node->ctx.ll_trv) {
+    node->ctx.trv_pending = node->desired_state ? node->parent_count : 0;
+    node->ctx.trv_inflight = false;
+    node->ctx.trv_cancelled = false;
+    pt->req_remaining++;
   }
 
-  pt->ll_topo_tail = ll_topo_tail;
+  for (struct rk_node *node = trv_head; node != 0; node = node->ctx.ll_trv) {
+    if (node->desired_state) continue;
+    for (size_t i = 0; i < node->parent_count; i++) {
+      if (!node->parents[i]->desired_state) {
+        node->parents[i]->ctx.trv_pending++;
+      }
+    }
+  }
 
-  return 0;
+  // == STEP 4: Update all nodes as soon as their dependencies have settled ==
+
+  struct rk_ready_queue q = {0};
+  for (struct rk_node *node = trv_head; node != 0; node = node->ctx.ll_trv) {
+    if (node->ctx.trv_pending == 0) {
+      ready_push(&q, node);
+    }
+  }
+
+  return run_request(pt, &q);
 }
 
-// ==== Private Functions ======================================================
+int rk_node_complete(struct rk_graph *pt, struct rk_node *node, int err) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (node == 0) return RK_ERR;
 
-static void reset_node_ctx_all(struct rk_graph *pt) {
-  for (size_t i = 0; i < pt->node_count; i++) {
-    struct rk_node_ctx *ctx = &(pt->nodes[i]->ctx);
-    memset(ctx, 0, sizeof(*ctx));
+  if (!node->ctx.trv_inflight || !in_traversal(pt, node) || pt->req_remaining == 0) {
+    RK_LOG_ERR("Node '%s' completed, but has no pending update.", node->name);
+    return RK_ERR;
   }
-}
 
-static void reset_node_ctx_ll_trv(struct rk_graph *pt) {
-  for (size_t i = 0; i < pt->node_count; i++) {
-    struct rk_node_ctx *ctx = &(pt->nodes[i]->ctx);
-    ctx->ll_trv = 0;
+  if (err == RK_PENDING) {
+    RK_LOG_ERR("Node '%s' completed with RK_PENDING.", node->name);
+    err = RK_ERR;
   }
+
+  node->ctx.trv_inflight = false;
+
+  struct rk_ready_queue q = {0};
+  settle_node(pt, &q, node, finish_update(pt, node, err));
+  return run_request(pt, &q);
 }
 
-static int enable_node(struct rk_graph *pt, struct rk_node *node) {
+int rk_what_if(struct rk_graph *pt, struct rk_client **clients, const uint64_t *enabled, size_t client_count,
+               uint64_t *node_on, uint32_t *on_count) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (clients == 0 && client_count != 0) return RK_ERR;
+  if (enabled == 0 && client_count != 0) return RK_ERR;
+  if (node_on == 0) return RK_ERR;
+  if (refresh_indices(pt)) return RK_ERR;
 
-  // == STEP 1: Flood from node up to root to discover all nodes which require an update ==
+  memset(node_on, 0, pt->node_count * sizeof(uint64_t));
 
-  reset_node_ctx_ll_trv(pt);
+  // Every client enables its parents:
+  for (size_t i = 0; i < client_count; i++) {
+    struct rk_client *client = clients[i];
+    if (client_contains_nullptr(client)) return RK_ERR;
 
-  // "Traverse" linked-list:
-  struct rk_node *trv_head = node;
-  struct rk_node *trv_tail = node;
+    for (size_t parent_idx = 0; parent_idx < client->parent_count; parent_idx++) {
+      node_on[client->parents[parent_idx]->ctx.node_idx] |= enabled[i];
+    }
+  }
 
-  while (trv_head != 0) {
+  // Every node enables its parents. Visiting all nodes in reverse-topological order ensures every node has
+  // received the configurations of all its children before it is reached:
+  for (struct rk_node *node = pt->ll_topo_tail; node != 0; node = topo_prev(pt, node)) {
+    uint64_t on = node_on[node->ctx.node_idx];
+    if (on == 0) continue;
 
-    for (size_t i = 0; i < trv_head->parent_count; i++) {
-      struct rk_node *parent = trv_head->parents[i];
-      if (parent == 0) {
-        RK_LOG_ERR("Node '%s's parent %zd is a null pointer.", trv_head->name, i);
-        return RK_ERR;
-      }
+    for (size_t parent_idx = 0; parent_idx < node->parent_count; parent_idx++) {
+      node_on[node->parents[parent_idx]->ctx.node_idx] |= on;
+    }
+  }
 
-      // Check if parent is already in "traverse" linked list:
-      if (parent->ctx.ll_trv == 0 && parent != trv_tail) {
-        // Parent not already in list. Append:
-        trv_tail->ctx.ll_trv = parent;
-        trv_tail = parent;
+  if (on_count != 0) {
+    memset(on_count, 0, 64 * sizeof(uint32_t));
+    for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+      uint64_t on = node_on[node_idx];
+      for (uint32_t config = 0; on != 0; config++, on >>= 1) {
+        on_count[config] += (uint32_t)(on & 1);
       }
     }
-
-    trv_head = trv_head->ctx.ll_trv;
   }
 
-  // == STEP 2: Traverse in topological order, enabling all nodes that were traversed in step 1 ==
-
-  struct rk_node *topo_head = pt->root;
-  while (topo_head != 0) {
+  return 0;
+}
 
-    // Check if this node is in the "traverse" list:
-    if (topo_head->ctx.ll_trv != 0 || topo_head == trv_tail) {
-      int err = update_node(topo_head, true);
-      if (err) return err;
-    }
+int rk_node_impact(struct rk_graph *pt, struct rk_node *node, struct rk_client ***clients, size_t *count) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (node == 0 || clients == 0 || count == 0) return RK_ERR;
+  if (refresh_indices(pt)) return RK_ERR;
 
-    topo_head = topo_head->ctx.ll_topo_next;
+  if (pt->impact == 0) {
+    RK_LOG_ERR("Cannot get impact of node '%s': Graph has no impact index.", node->name);
+    return RK_ERR;
   }
 
+  *clients = node->ctx.impact;
+  *count = node->ctx.impact_len;
   return 0;
 }
 
-static int optimize_node(struct rk_graph *pt, struct rk_node *node) {
+uint32_t rk_client_shard(struct rk_graph *pt, struct rk_client *client) {
+  if (handle_contains_nullptr(pt)) return RK_SHARD_ROOT;
+  if (client_contains_nullptr(client)) return RK_SHARD_ROOT;
 
-  // == STEP 1: Flood from node up to root to discover all nodes which require an update ==
+  return client_shard(pt, client);
+}
 
-  reset_node_ctx_ll_trv(pt);
+bool rk_trace_read(struct rk_trace *trace, struct rk_trace_record *record) {
+  if (trace == 0 || record == 0) return false;
 
-  // "Traverse" linked-list:
-  struct rk_node *trv_head = node;
-  struct rk_node *trv_tail = node;
+  uint32_t tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+  uint32_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
 
-  while (trv_head != 0) {
+  if (head == tail) return false;
 
-    for (size_t i = 0; i < trv_head->parent_count; i++) {
-      struct rk_node *parent = trv_head->parents[i];
-      if (parent == 0) {
-        RK_LOG_ERR("Node '%s's parent %zd is a null pointer.", trv_head->name, i);
-        return RK_ERR;
-      }
+  *record = trace->records[tail & (trace->record_count - 1)];
 
-      // Check if parent is already in "traverse" linked list:
-      if (parent->ctx.ll_trv == 0 && parent != trv_tail) {
-        // Parent not already in list. Append:
-        trv_tail->ctx.ll_trv = parent;
-        trv_tail = parent;
-      }
-    }
+  // Release record slot:
+  atomic_store_explicit(&trace->tail, tail + 1, memory_order_release);
+  return true;
+}
 
-    trv_head = trv_head->ctx.ll_trv;
-  }
+void rk_stats_read(struct rk_stats *stats, struct rk_stats_snapshot *snapshot) {
+  if (stats == 0 || snapshot == 0) return;
+
+  snapshot->requests = atomic_load_explicit(&stats->requests, memory_order_relaxed);
+  snapshot->flood_visits = atomic_load_explicit(&stats->flood_visits, memory_order_relaxed);
+  snapshot->topo_visits = atomic_load_explicit(&stats->topo_visits, memory_order_relaxed);
+  snapshot->dependant_evals = atomic_load_explicit(&stats->dependant_evals, memory_order_relaxed);
+  snapshot->cb_calls = atomic_load_explicit(&stats->cb_calls, memory_order_relaxed);
+  snapshot->cb_transitions = atomic_load_explicit(&stats->cb_transitions, memory_order_relaxed);
+  snapshot->cb_failures = atomic_load_explicit(&stats->cb_failures, memory_order_relaxed);
+}
 
-  // == STEP 2: Traverse in reverse-topological order, updating all nodes ==
+void rk_stats_reset(struct rk_stats *stats) {
+  if (stats == 0) return;
 
-  struct rk_node *topo_tail = pt->ll_topo_tail;
-  while (topo_tail != 0) {
+  atomic_store_explicit(&stats->requests, 0, memory_order_relaxed);
+  atomic_store_explicit(&stats->flood_visits, 0, memory_order_relaxed);
+  atomic_store_explicit(&stats->topo_visits, 0, memory_order_relaxed);
+  atomic_store_explicit(&stats->dependant_evals, 0, memory_order_relaxed);
+  atomic_store_explicit(&stats->cb_calls, 0, memory_order_relaxed);
+  atomic_store_explicit(&stats->cb_transitions, 0, memory_order_relaxed);
+  atomic_store_explicit(&stats->cb_failures, 0, memory_order_relaxed);
+}
 
-    // Check if this node is in the "traverse" list:
-    if (topo_tail->ctx.ll_trv != 0 || topo_tail == trv_tail) {
+void rk_histogram_record(struct rk_histogram *hist, uint32_t value) {
+  if (hist == 0) return;
 
-      if (node_contains_nullptr(topo_tail)) {
-        RK_LOG_ERR("Node '%s' contains a null pointer.", node->name);
-        return RK_ERR;
-      }
+  hist->buckets[hist_bucket(value)]++;
+  hist->count++;
+  if (value > hist->max) {
+    hist->max = value;
+  }
+}
 
-      int err = update_node(topo_tail, has_active_dependant(topo_tail));
-      if (err) return err;
-    }
+uint32_t rk_histogram_percentile(const struct rk_histogram *hist, uint32_t percent) {
+  if (hist == 0 || hist->count == 0) return 0;
+  if (percent > 100) percent = 100;
 
-    topo_tail = topo_tail->ctx.ll_topo_prev;
+  // Number of values that are smaller than or equal to the percentile:
+  uint64_t rank = ((uint64_t)hist->count * percent + 99) / 100;
+  if (rank == 0) rank = 1;
+
+  uint64_t seen = 0;
+  for (uint32_t bucket = 0; bucket < RK_HIST_BUCKETS; bucket++) {
+    seen += hist->buckets[bucket];
+    if (seen >= rank) {
+      uint32_t bucket_max = hist_bucket_max(bucket);
+      return bucket_max < hist->max ? bucket_max : hist->max;
+    }
   }
 
-  return 0;
+  return hist->max;
 }
 
-static int update_node(struct rk_node *node, bool new_state) {
-  node->desired_state = new_state;
+void rk_histogram_summarize(const struct rk_histogram *hist, struct rk_histogram_summary *summary) {
+  if (hist == 0 || summary == 0) return;
 
-  if (node->desired_state != node->state) {
-    RK_LOG_INF("%s: %s -> %s", node->name, RK_ON_OFF(node->state), RK_ON_OFF(node->desired_state));
-  }
+  summary->count = hist->count;
+  summary->p50 = rk_histogram_percentile(hist, 50);
+  summary->p99 = rk_histogram_percentile(hist, 99);
+  summary->max = hist->max;
+}
 
-  if (node->cb_update != 0) {
+void rk_histogram_reset(struct rk_histogram *hist) {
+  if (hist == 0) return;
+  memset(hist, 0, sizeof(*hist));
+}
+
+int rk_optimize(struct rk_graph *pt) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (graph_is_busy(pt)) return RK_ERR;
+  if (refresh_indices(pt)) return RK_ERR;
+
+  uint32_t trace_start = start_request(pt);
+  int err = pt->bitset != 0 ? optimize_bitset(pt) : optimize_graph(pt);
+  trace_request(pt, RK_TRACE_OPTIMIZE, trace_start, err);
+
+  return err;
+}
+
+int rk_optimize_dirty(struct rk_graph *pt) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (graph_is_busy(pt)) return RK_ERR;
+  if (refresh_indices(pt)) return RK_ERR;
+
+  uint32_t trace_start = start_request(pt);
+  int err = optimize_dirty(pt);
+  trace_request(pt, RK_TRACE_OPTIMIZE_DIRTY, trace_start, err);
+
+  return err;
+}
+
+int rk_node_fault(struct rk_graph *pt, struct rk_node *node) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (graph_is_busy(pt)) return RK_ERR;
+  if (node == 0) return RK_ERR;
+  if (refresh_indices(pt)) return RK_ERR;
+
+  uint32_t trace_start = start_request(pt);
+  int err = fault_node(pt, node);
+  trace_request(pt, RK_TRACE_FAULT, trace_start, err);
+
+  return err;
+}
+
+int rk_node_recover(struct rk_graph *pt, struct rk_node *node) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (graph_is_busy(pt)) return RK_ERR;
+  if (node == 0) return RK_ERR;
+  if (refresh_indices(pt)) return RK_ERR;
+
+  if (!node->faulted) {
+    RK_LOG_ERR("Cannot recover node '%s': Node has not faulted.", node->name);
+    return RK_ERR;
+  }
+
+  uint32_t trace_start = start_request(pt);
+  int err = recover_node(pt, node);
+  trace_request(pt, RK_TRACE_RECOVER, trace_start, err);
+
+  return err;
+}
+
+int rk_node_add_child(struct rk_node *node, struct rk_node *child) {
+  return rk_node_add_child_arena(0, node, child);
+}
+
+int rk_node_add_client(struct rk_node *node, struct rk_client *client) {
+  return rk_node_add_client_arena(0, node, client);
+}
+
+int rk_graph_add_child(struct rk_graph *pt, struct rk_arena *arena, struct rk_node *node, struct rk_node *child) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (child == 0) return RK_ERR;
+  if (!graph_is_modifiable(pt, node)) return RK_ERR;
+
+  if (child->state && !node->state) {
+    RK_LOG_ERR("Cannot add enabled node '%s' as a child of disabled node '%s'.", child->name, node->name);
+    return RK_ERR;
+  }
+
+  bool is_new = child != pt->root && child->parent_count == 0;
+
+  if (is_new) {
+    if (child->child_count != 0 || child->client_count != 0) {
+      RK_LOG_ERR("Cannot add node '%s' to the graph: New nodes must not have children or clients.", child->name);
+      return RK_ERR;
+    }
+    if (pt->node_count >= pt->node_capacity) {
+      RK_LOG_ERR("Cannot add node '%s' to the graph: Graph already contains %zd nodes.", child->name, pt->node_count);
+      return RK_ERR;
+    }
+  } else if (child->ctx.topo_rank <= node->ctx.topo_rank) {
+    int err = check_new_edge(pt, node, child);
+    if (err) return err;
+  }
+
+  int err = rk_node_add_child_arena(arena != 0 ? arena : pt->arena, node, child);
+  if (err) return err;
+
+  if (is_new) {
+    // New nodes are ranked last:
+    memset(&child->ctx, 0, sizeof(child->ctx));
+    child->ctx.node_idx = (uint32_t)pt->node_count;
+    pt->nodes[pt->node_count] = child;
+    pt->node_count++;
+    append_topo(pt, child);
+  } else if (child->ctx.topo_rank <= node->ctx.topo_rank) {
+    reorder_topo(pt, node, child);
+  }
+
+  if (child->state) {
+    node->ctx.active_dependants++;
+
+    // A new node has no dependants yet, and is not required:
+    if (is_new) mark_dirty(pt, child);
+  }
+
+  return invalidate_indices(pt);
+}
+
+int rk_graph_add_client(struct rk_graph *pt, struct rk_arena *arena, struct rk_node *node,
+                        struct rk_client *client) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (client == 0) return RK_ERR;
+  if (!graph_is_modifiable(pt, node)) return RK_ERR;
+
+  if (client->enabled && !node->state) {
+    RK_LOG_ERR("Cannot add enabled client '%s' to disabled node '%s'.", client->name, node->name);
+    return RK_ERR;
+  }
+
+  int err = rk_node_add_client_arena(arena != 0 ? arena : pt->arena, node, client);
+  if (err) return err;
+
+  if (client->enabled) {
+    node->ctx.active_dependants++;
+  }
+
+  return invalidate_indices(pt);
+}
+
+int rk_graph_remove_child(struct rk_graph *pt, struct rk_node *node, struct rk_node *child) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (child == 0) return RK_ERR;
+  if (!graph_is_modifiable(pt, node)) return RK_ERR;
+
+  if (!has_child_edge(node, child)) {
+    RK_LOG_ERR("Cannot remove node '%s' from node '%s': Not a child.", child->name, node->name);
+    return RK_ERR;
+  }
+
+  if (child->parent_count == 1) {
+    RK_LOG_ERR("Cannot remove node '%s' from node '%s': Node has no other parent.", child->name, node->name);
+    return RK_ERR;
+  }
+
+  remove_child_edge(node, child);
+
+  // Removing edges never invalidates the topological order. The node may no longer be required:
+  if (child->state) {
+    node->ctx.active_dependants--;
+    mark_dirty(pt, node);
+  }
+
+  return invalidate_indices(pt);
+}
+
+int rk_graph_remove_client(struct rk_graph *pt, struct rk_node *node, struct rk_client *client) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (client == 0) return RK_ERR;
+  if (!graph_is_modifiable(pt, node)) return RK_ERR;
+
+  if (!has_client_edge(node, client)) {
+    RK_LOG_ERR("Cannot remove client '%s' from node '%s': Not a client.", client->name, node->name);
+    return RK_ERR;
+  }
+
+  if (client->enabled && client->parent_count == 1) {
+    RK_LOG_ERR("Cannot remove client '%s' from node '%s': Client is enabled.", client->name, node->name);
+    return RK_ERR;
+  }
+
+  remove_client_edge(node, client);
+  client->plan = 0;
+  client->plan_len = 0;
+
+  if (client->enabled) {
+    node->ctx.active_dependants--;
+    mark_dirty(pt, node);
+  }
+
+  return invalidate_indices(pt);
+}
+
+int rk_graph_detach_node(struct rk_graph *pt, struct rk_node *node) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (!graph_is_modifiable(pt, node)) return RK_ERR;
+
+  if (node == pt->root) {
+    RK_LOG_ERR("Cannot detach node '%s': Node is the root.", node->name);
+    return RK_ERR;
+  }
+
+  if (node->state) {
+    if (node->ctx.active_dependants != 0) {
+      RK_LOG_ERR("Cannot detach node '%s': Node is required by %u enabled children or clients.", node->name,
+                 (unsigned int)node->ctx.active_dependants);
+    } else {
+      RK_LOG_ERR("Cannot detach node '%s': Node is enabled.", node->name);
+    }
+    return RK_ERR;
+  }
+
+  for (size_t i = 0; i < node->child_count; i++) {
+    struct rk_node *child = node->children[i];
+    bool has_other_parent = false;
+    for (size_t parent_idx = 0; parent_idx < child->parent_count; parent_idx++) {
+      has_other_parent |= child->parents[parent_idx] != node;
+    }
+    if (!has_other_parent) {
+      RK_LOG_ERR("Cannot detach node '%s': Node is the only parent of node '%s'.", node->name, child->name);
+      return RK_ERR;
+    }
+  }
+
+  // The node is disabled, and so are all its children and clients. No dependant counters change:
+  while (node->child_count != 0) {
+    remove_child_edge(node, node->children[0]);
+  }
+  while (node->client_count != 0) {
+    struct rk_client *client = node->clients[0];
+    remove_client_edge(node, client);
+    client->plan = 0;
+    client->plan_len = 0;
+  }
+  while (node->parent_count != 0) {
+    remove_child_edge(node->parents[0], node);
+  }
+
+  // Ranks of all other nodes remain in order, but are no longer consecutive. Only the derived indices require
+  // consecutive ranks, and are renumbered when they are rebuilt:
+  unmark_dirty(pt, node);
+  unlink_topo(pt, node);
+
+  struct rk_node *last = pt->nodes[pt->node_count - 1];
+  pt->nodes[node->ctx.node_idx] = last;
+  last->ctx.node_idx = node->ctx.node_idx;
+  pt->node_count--;
+
+  memset(&node->ctx, 0, sizeof(node->ctx));
+  return invalidate_indices(pt);
+}
+
+int rk_node_add_child_arena(struct rk_arena *arena, struct rk_node *node, struct rk_node *child) {
+  if (node == 0) return RK_ERR;
+  if (child == 0) return RK_ERR;
+  if (arena == 0) arena = &default_arena;
+
+  struct rk_node **children =
+      grow_array(arena, node->children, node->child_count, &node->storage.child_capacity, sizeof(*children));
+  if (children == 0) {
+    RK_LOG_ERR("Cannot add child to node '%s': Arena exhausted at %u children.", node->name, node->child_count);
+    return RK_ERR;
+  }
+  node->children = children;
+
+  struct rk_node **parents =
+      grow_array(arena, child->parents, child->parent_count, &child->storage.parent_capacity, sizeof(*parents));
+  if (parents == 0) {
+    RK_LOG_ERR("Cannot add node '%s' as a child: Arena exhausted at %u parents.", child->name, child->parent_count);
+    return RK_ERR;
+  }
+  child->parents = parents;
+
+  node->children[node->child_count] = child;
+  node->child_count++;
+  child->parents[child->parent_count] = node;
+  child->parent_count++;
+
+  return 0;
+}
+
+int rk_node_add_client_arena(struct rk_arena *arena, struct rk_node *node, struct rk_client *client) {
+  if (node == 0) return RK_ERR;
+  if (client == 0) return RK_ERR;
+  if (arena == 0) arena = &default_arena;
+
+  struct rk_client **clients =
+      grow_array(arena, node->clients, node->client_count, &node->storage.client_capacity, sizeof(*clients));
+  if (clients == 0) {
+    RK_LOG_ERR("Cannot add client to node '%s': Arena exhausted at %u clients.", node->name, node->client_count);
+    return RK_ERR;
+  }
+  node->clients = clients;
+
+  struct rk_node **parents =
+      grow_array(arena, client->parents, client->parent_count, &client->storage.parent_capacity, sizeof(*parents));
+  if (parents == 0) {
+    RK_LOG_ERR("Cannot add client to node '%s': Arena exhausted at %u parents.", client->name, client->parent_count);
+    return RK_ERR;
+  }
+  client->parents = parents;
+
+  // Enable plan is outdated until the graph is re-initialized:
+  client->plan = 0;
+
+  node->clients[node->client_count] = client;
+  node->client_count++;
+  client->parents[client->parent_count] = node;
+  client->parent_count++;
+
+  return 0;
+}
+
+void rk_default_arena_reset(void) { default_arena.used = 0; }
+
+size_t rk_csr_size(struct rk_graph *pt) {
+  if (handle_contains_nullptr(pt)) return 0;
+
+  for (size_t i = 0; i < pt->node_count; i++) {
+    if (pt->nodes[i] == 0) return 0;
+  }
+
+  struct rk_csr csr = {0};
+  return csr_layout(pt, &csr, 0);
+}
+
+size_t rk_plans_size(struct rk_graph *pt) {
+  if (handle_contains_nullptr(pt)) return 0;
+  if (graph_is_busy(pt)) return 0;
+
+  for (size_t i = 0; i < pt->node_count; i++) {
+    if (node_contains_nullptr(pt->nodes[i])) return 0;
+  }
+
+  size_t entry_count = 0;
+  if (plans_layout(pt, 0, &entry_count)) return 0;
+  return entry_count * sizeof(struct rk_node *);
+}
+
+size_t rk_bitset_size(struct rk_graph *pt) {
+  if (handle_contains_nullptr(pt)) return 0;
+  if (graph_is_busy(pt)) return 0;
+
+  for (size_t i = 0; i < pt->node_count; i++) {
+    if (node_contains_nullptr(pt->nodes[i])) return 0;
+  }
+
+  struct rk_bitset bs = {0};
+  return bitset_layout(pt, &bs, 0);
+}
+
+size_t rk_impact_size(struct rk_graph *pt) {
+  if (handle_contains_nullptr(pt)) return 0;
+  if (graph_is_busy(pt)) return 0;
+
+  for (size_t i = 0; i < pt->node_count; i++) {
+    if (node_contains_nullptr(pt->nodes[i])) return 0;
+  }
+
+  size_t entry_count = 0;
+  if (impact_layout(pt, 0, &entry_count)) return 0;
+  return entry_count * sizeof(struct rk_client *);
+}
+
+size_t rk_shards_size(struct rk_graph *pt) {
+  if (handle_contains_nullptr(pt)) return 0;
+  if (graph_is_busy(pt)) return 0;
+
+  for (size_t i = 0; i < pt->node_count; i++) {
+    if (node_contains_nullptr(pt->nodes[i])) return 0;
+  }
+
+  size_t shard_count = 0;
+  if (shards_layout(pt, 0, &shard_count)) return 0;
+  return shard_count * sizeof(struct rk_shard);
+}
+
+int rk_init(struct rk_graph *pt) {
+  if (handle_contains_nullptr(pt)) return RK_ERR;
+  if (graph_is_busy(pt)) return RK_ERR;
+
+  // Null pointers are only checked here and when changing edges. Requests rely on a valid graph:
+  for (size_t i = 0; i < pt->node_count; i++) {
+    if (node_contains_nullptr(pt->nodes[i])) {
+      RK_LOG_ERR("Node %zd contains a null pointer.", i);
+      return RK_ERR;
+    }
+  }
+
+  reset_node_ctx_all(pt);
+  pt->ll_dirty_head = 0;
+  pt->indices_stale = false;
+
+  if (pt->shards != 0) {
+    pt->shards->shard_count = 0;
+    pt->shards->shard = 0;
+  }
+
+  if (pt->trace != 0) {
+    struct rk_trace *trace = pt->trace;
+    if (trace->records == 0 || trace->cb_timestamp == 0) return RK_ERR;
+
+    if (trace->record_count == 0 || (trace->record_count & (trace->record_count - 1)) != 0) {
+      RK_LOG_ERR("Trace buffer length must be a power of two, but is %u.", (unsigned int)trace->record_count);
+      return RK_ERR;
+    }
+  }
+
+  if (pt->cb_timestamp == 0) {
+    for (size_t i = 0; i < pt->node_count; i++) {
+      struct rk_node *node = pt->nodes[i];
+      bool has_histogram = node->cb_latency != 0;
+      for (size_t client_idx = 0; client_idx < node->client_count; client_idx++) {
+        has_histogram |= node->clients[client_idx]->latency != 0;
+      }
+      if (has_histogram) {
+        RK_LOG_ERR("Node '%s' or its clients record latency, but the graph has no timestamp source.", node->name);
+        return RK_ERR;
+      }
+    }
+  }
+
+  // == Topological sort (Kahn's algorithm): ==
+
+  // The "topo" doubly-linked-list (stored in the nodes themselves) serves
+  // as the L list, storing all sorted nodes:
+  struct rk_node *ll_topo_tail = 0;
+
+  // The "trv" traversal single-linked list (also stored in the nodes themselves)
+  // serves as the S list, storing nodes that are not yet in L, but already have
+  // no parents when ignoring all nodes already in L. They are next candidates
+  // to be added to L.
+  struct rk_node *trv_head = pt->root;
+  struct rk_node *trv_tail = pt->root;
+
+  while (trv_head != 0) {
+    // Append trv_head to topo list (L):
+    if (ll_topo_tail == 0) {
+      ll_topo_tail = trv_head;
+    } else {
+      trv_head->ctx.ll_topo_prev = ll_topo_tail;
+      ll_topo_tail->ctx.ll_topo_next = trv_head;
+      ll_topo_tail = trv_head;
+    }
+
+    // Check all children nodes. If they no longer have any parents outside of
+    // L, add them to S:
+    for (size_t child_idx = 0; child_idx < trv_head->child_count; child_idx++) {
+      struct rk_node *node_to_check = trv_head->children[child_idx];
+
+      // Validate that this child is not inside L, which can only happen if the
+      // graph is not acyclic:
+      if (node_to_check->ctx.ll_topo_next != 0 || ll_topo_tail == node_to_check) {
+        // Cyclic graph. Abort.
+        RK_LOG_ERR("Graph contains cycle, likely involving node '%s'!", node_to_check->name);
+        return RK_ERR;
+      }
+
+      bool has_parent_outside_l = false;
+      for (size_t parent_idx = 0; parent_idx < node_to_check->parent_count; parent_idx++) {
+        struct rk_node *parent = node_to_check->parents[parent_idx];
+
+        if (parent->ctx.ll_topo_next == 0 && parent != ll_topo_tail) { // Check if not in L.
+          has_parent_outside_l = true;
+          break;
+        }
+      }
+
+      // Add to trv list (S):
+      if (!has_parent_outside_l) {
+        // Check if node_to_check is already in S, which can happen
+        // if the node contains redundant parallel edges between nodes:
+        if (node_to_check->ctx.ll_trv != 0 || node_to_check == trv_tail) {
+          continue;
+        }
+        trv_tail->ctx.ll_trv = node_to_check;
+        trv_tail = node_to_check;
+      }
+    }
+
+    // Advance traversal list (S), effectively removing the current node from it:
+    trv_head = trv_head->ctx.ll_trv;
+  }
+
+  // == Validate that graph is acyclic & connected, and rank all nodes in topological order ==
+  size_t topo_count = 0;
+  struct rk_node *ll_topo_head = pt->root;
+
+  while (ll_topo_head != 0) {
+    ll_topo_head->ctx.topo_rank = (uint32_t)topo_count;
+    topo_count++;
+    ll_topo_head = ll_topo_head->ctx.ll_topo_next;
+  }
+
+  if (topo_count != pt->node_count) {
+    RK_LOG_ERR("Graph malformed. It may contain nodes not in the node list, be cyclic or be disconnected. "
+               "Topological list contains %zd elements, but graph claims to have %zd nodes!",
+               topo_count, pt->node_count);
+    return RK_ERR;
+  }
+
+  pt->ll_topo_tail = ll_topo_tail;
+
+  pt->edges_removed = 0;
+  if (pt->simplify) {
+    int err = simplify_graph(pt);
+    if (err) return err;
+  }
+
+  if (pt->csr != 0) {
+    int err = compile_csr(pt);
+    if (err) return err;
+  }
+
+  int err = count_active_dependants(pt);
+  if (err) return err;
+
+  err = build_plans(pt);
+  if (err) return err;
+
+  if (pt->impact != 0) {
+    err = build_impact(pt);
+    if (err) return err;
+  }
+
+  if (pt->bitset != 0) {
+    err = build_bitset(pt);
+    if (err) return err;
+  }
+
+  if (pt->shards != 0) {
+    err = build_shards(pt);
+    if (err) return err;
+  }
+
+  // Nodes initialized as enabled without an enabled dependant are not in an optimal state:
+  for (size_t i = 0; i < pt->node_count; i++) {
+    struct rk_node *node = pt->nodes[i];
+    if (node->state && node->ctx.active_dependants == 0) {
+      mark_dirty(pt, node);
+    }
+  }
+
+  return 0;
+}
+
+// ==== Private Functions ======================================================
+
+static void reset_node_ctx_all(struct rk_graph *pt) {
+  for (size_t i = 0; i < pt->node_count; i++) {
+    struct rk_node_ctx *ctx = &(pt->nodes[i]->ctx);
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->node_idx = (uint32_t)i;
+  }
+}
+
+// Start a new traversal. Instead of clearing the "traverse" list of every node, this
+// advances the graph's epoch, implicitly removing all nodes from the list.
+static void start_traversal(struct rk_graph *pt) {
+  pt->trv_epoch++;
+
+  if (pt->trv_epoch == 0) {
+    // Epoch wrapped around. Clear all stamps so that no node appears to be part of the new traversal:
+    for (size_t i = 0; i < pt->node_count; i++) {
+      struct rk_node *node = pt->nodes[i];
+      node->ctx.trv_epoch = 0;
+      for (size_t client_idx = 0; client_idx < node->client_count; client_idx++) {
+        node->clients[client_idx]->trv_epoch = 0;
+      }
+      if (pt->csr != 0 && !pt->indices_stale) {
+        pt->csr->trv_epoch[i] = 0;
+      }
+    }
+    pt->trv_epoch = 1;
+  }
+}
+
+static int enable_client(struct rk_graph *pt, struct rk_client *client, bool atomic) {
+  // Stack of all nodes enabled during this call, most recently enabled node first (if atomic):
+  struct rk_node *undo_log = 0;
+
+  if (client->plan != 0) {
+    int err = enable_plan(pt, client, atomic ? &undo_log : 0);
+    if (err) {
+      rollback_enable(pt, undo_log);
+      mark_client_dirty(pt, client);
+      return err;
+    }
+  } else {
+    for (size_t i = 0; i < client->parent_count; i++) {
+      int err = enable_node(pt, client->parents[i], atomic ? &undo_log : 0);
+      if (err) {
+        rollback_enable(pt, undo_log);
+        mark_client_dirty(pt, client);
+        return err;
+      }
+    }
+  }
+
+  set_client_state(client, true);
+
+  return 0;
+}
+
+static int disable_client(struct rk_graph *pt, struct rk_client *client) {
+  set_client_state(client, false);
+  client->unserved = false;
+
+  // Parents are pushed in reverse, so that they are disabled in order:
+  start_traversal(pt);
+  struct rk_node *stack = 0;
+  for (size_t i = client->parent_count; i > 0; i--) {
+    release_node(pt, &stack, client->parents[i - 1]);
+  }
+
+  int err = disable_released(pt, stack);
+  if (err) mark_client_dirty(pt, client);
+  return err;
+}
+
+// Enable a client of a shard, while holding the lock of the shard. Equivalent to enable_client(), but
+// only traverses the nodes of the shard: The root is updated separately, while holding the root lock.
+static int shard_enable_client(struct rk_graph *pt, struct rk_client *client, bool atomic) {
+  if (client_contains_nullptr(client)) return RK_ERR;
+
+  // Stack of all nodes of the shard enabled during this call, most recently enabled node first (if atomic):
+  struct rk_node *undo_log = 0;
+  bool root_held = false;
+  bool root_enabled = false;
+  int err = 0;
+
+  for (size_t i = 0; i < client->parent_count && err == 0; i++) {
+    struct rk_node *trv_head = 0;
+    bool root_reached = false;
+    err = collect_shard_traversal(pt, client->parents[i], &trv_head, &root_reached);
+    if (err) break;
+
+    // If the flood reached the root, it is enabled first. The root is held by an additional dependant
+    // until the client is enabled, so that requests of other shards cannot disable it in the meantime:
+    if (root_reached) {
+      lock_shard(pt, RK_SHARD_ROOT);
+      if (!root_held) {
+        pt->root->ctx.active_dependants++;
+        root_held = true;
+      }
+      bool was_enabled = pt->root->state;
+      RK_COUNT(pt, topo_visits, 1);
+      err = check_fault(pt->root);
+      if (!err) err = update_node(pt, pt->root, true);
+      root_enabled = root_enabled || (!was_enabled && pt->root->state);
+      unlock_shard(pt, RK_SHARD_ROOT);
+    }
+
+    for (struct rk_node *node = trv_head; node != 0 && err == 0; node = node->ctx.ll_trv) {
+      RK_COUNT(pt, topo_visits, 1);
+      bool was_enabled = node->state;
+      err = check_fault(node);
+      if (!err) err = shard_update(pt, node, true);
+
+      // Record transition in undo log (if requested):
+      if (!err && atomic && !was_enabled) {
+        node->ctx.ll_undo = undo_log;
+        undo_log = node;
+      }
+    }
+  }
+
+  if (!err) {
+    shard_set_client_state(pt, client, true);
+  } else {
+    // Revert in reverse order, as rollback_enable() does. The root is reverted last, once it is released:
+    for (; undo_log != 0; undo_log = undo_log->ctx.ll_undo) {
+      RK_LOG_INF("%s: Rolling back.", undo_log->name);
+      shard_update(pt, undo_log, has_active_dependant(pt, undo_log));
+    }
+  }
+
+  lock_shard(pt, RK_SHARD_ROOT);
+  if (root_held) {
+    pt->root->ctx.active_dependants--;
+  }
+  if (err) {
+    if (atomic && root_enabled) {
+      RK_LOG_INF("%s: Rolling back.", pt->root->name);
+      update_node(pt, pt->root, has_active_dependant(pt, pt->root));
+    }
+    mark_client_dirty(pt, client);
+  }
+  unlock_shard(pt, RK_SHARD_ROOT);
+
+  return err;
+}
+
+// Disable a client of a shard, while holding the lock of the shard. Equivalent to disable_client(), but
+// only traverses the nodes of the shard: The root is updated separately, while holding the root lock.
+static int shard_disable_client(struct rk_graph *pt, struct rk_client *client) {
+  if (client_contains_nullptr(client)) return RK_ERR;
+
+  shard_set_client_state(pt, client, false);
+  client->unserved = false;
+
+  struct rk_shard *shard = &pt->shards->shard[client_shard(pt, client)];
+  start_shard_traversal(shard);
+  struct rk_node *stack = 0;
+  bool root_released = false;
+  for (size_t i = client->parent_count; i > 0; i--) {
+    shard_release_node(pt, &stack, client->parents[i - 1], &root_released);
+  }
+
+  int err = 0;
+  while (stack != 0 && err == 0) {
+    struct rk_node *node = stack;
+    stack = node->ctx.ll_trv;
+
+    RK_COUNT(pt, topo_visits, 1);
+    err = shard_update(pt, node, false);
+
+    for (size_t i = node->parent_count; i > 0 && err == 0; i--) {
+      shard_release_node(pt, &stack, node->parents[i - 1], &root_released);
+    }
+  }
+
+  if (err == 0 && root_released) {
+    // Every node depends on the root, which is disabled last if it is no longer required:
+    lock_shard(pt, RK_SHARD_ROOT);
+    if (pt->root->state && pt->root->ctx.active_dependants == 0) {
+      RK_COUNT(pt, topo_visits, 1);
+      err = update_node(pt, pt->root, false);
+    }
+    unlock_shard(pt, RK_SHARD_ROOT);
+  }
+
+  if (err) {
+    // The root's "dirty" list is protected by the root lock:
+    bool root_parent = has_root_parent(pt, client->parents, client->parent_count);
+    if (root_parent) lock_shard(pt, RK_SHARD_ROOT);
+    mark_client_dirty(pt, client);
+    if (root_parent) unlock_shard(pt, RK_SHARD_ROOT);
+  }
+
+  return err;
+}
+
+// Update a node of a shard. The callback is called while only holding the lock of the shard: The root
+// cannot be disabled in the meantime, as it is held by the node itself or the client being enabled. The
+// state of a node that depends on the root changes the dependant counter of the root, and is therefore
+// only changed while holding the root lock.
+static int shard_update(struct rk_graph *pt, struct rk_node *node, bool new_state) {
+  bool root_parent = has_root_parent(pt, node->parents, node->parent_count);
+  int err = call_update(pt, node, new_state);
+
+  if (root_parent) lock_shard(pt, RK_SHARD_ROOT);
+  err = finish_update(pt, node, err);
+  if (root_parent) unlock_shard(pt, RK_SHARD_ROOT);
+
+  return err;
+}
+
+// Change the state of a client of a shard. The state of a client that depends on the root changes the
+// dependant counter of the root, and is therefore only changed while holding the root lock.
+static void shard_set_client_state(struct rk_graph *pt, struct rk_client *client, bool enabled) {
+  bool root_parent = has_root_parent(pt, client->parents, client->parent_count);
+
+  if (root_parent) lock_shard(pt, RK_SHARD_ROOT);
+  set_client_state(client, enabled);
+  if (root_parent) unlock_shard(pt, RK_SHARD_ROOT);
+}
+
+// Start a new traversal of a shard. Equivalent to start_traversal(), but uses the epoch of the shard
+// instead of the graph's epoch, so that different shards can be traversed concurrently.
+static void start_shard_traversal(struct rk_shard *shard) {
+  shard->trv_epoch++;
+
+  if (shard->trv_epoch == 0) {
+    // Epoch wrapped around. Clear the stamps of all nodes of the shard:
+    for (struct rk_node *node = shard->ll_topo_head; node != 0; node = node->ctx.ll_shard) {
+      node->ctx.shard_epoch = 0;
+    }
+    shard->trv_epoch = 1;
+  }
+}
+
+// Push a node of a shard onto a stack of nodes to be disabled, as release_node() does. The root is not part
+// of any shard, and its dependant counter may only be read while holding the root lock: Sets root_released
+// instead of pushing it.
+static void shard_release_node(struct rk_graph *pt, struct rk_node **stack, struct rk_node *node,
+                               bool *root_released) {
+  if (node == pt->root) {
+    *root_released = true;
+    return;
+  }
+
+  struct rk_shard *shard = &pt->shards->shard[node->ctx.shard];
+  if (!node->state || node->ctx.active_dependants != 0 || node->ctx.shard_epoch == shard->trv_epoch) return;
+  node->ctx.shard_epoch = shard->trv_epoch;
+  node->ctx.ll_trv = *stack;
+  *stack = node;
+}
+
+// Collect a node and all its (direct and indirect) disabled parents into the "traverse" list of a new
+// traversal of its shard, sorted in topological order, as enable_node() does. The root is not part of
+// any shard, and is never collected. Sets trv_head to the head of the list, and root_reached if the
+// root is a parent of any collected node.
+static int collect_shard_traversal(struct rk_graph *pt, struct rk_node *node, struct rk_node **trv_head,
+                                   bool *root_reached) {
+  size_t visits = 0;
+  *trv_head = 0;
+  *root_reached = node == pt->root;
+
+  if (node != pt->root) {
+    struct rk_shard *shard = &pt->shards->shard[node->ctx.shard];
+    start_shard_traversal(shard);
+    node->ctx.shard_epoch = shard->trv_epoch;
+    node->ctx.ll_trv = 0;
+    node->ctx.ll_heap = 0;
+    node->ctx.trv_pending = 0;
+
+    // Nodes are taken from a frontier heap:
+    struct rk_node *heap = node;
+
+    while (heap != 0) {
+      struct rk_node *current = heap_pop(&heap);
+      current->ctx.ll_trv = *trv_head;
+      *trv_head = current;
+      visits++;
+
+      for (size_t i = 0; !current->state && i < current->parent_count; i++) {
+        struct rk_node *parent = current->parents[i];
+        if (parent == 0) {
+          RK_LOG_ERR("Node '%s's parent %zd is a null pointer.", current->name, i);
+          return RK_ERR;
+        }
+
+        if (parent == pt->root) {
+          *root_reached = true;
+          continue;
+        }
+
+        if (parent->ctx.shard_epoch != shard->trv_epoch) {
+          parent->ctx.shard_epoch = shard->trv_epoch;
+          parent->ctx.ll_trv = 0;
+          parent->ctx.ll_heap = 0;
+          parent->ctx.trv_pending = 0;
+          heap = heap_meld(heap, parent);
+        }
+        parent->ctx.trv_pending++;
+      }
+    }
+  }
+
+  // The root is not collected, but counted as visited:
+  if (*root_reached) visits++;
+  RK_COUNT(pt, flood_visits, visits);
+  return 0;
+}
+
+// Get the shard of a client, which is the shard of all of its parents except the root. Returns
+// RK_SHARD_ROOT if the client only depends on the root, or the graph is not sharded.
+static uint32_t client_shard(struct rk_graph *pt, struct rk_client *client) {
+  if (pt->shards == 0) return RK_SHARD_ROOT;
+
+  for (size_t i = 0; i < client->parent_count; i++) {
+    struct rk_node *parent = client->parents[i];
+    if (parent != 0 && parent->ctx.shard < pt->shards->shard_count) {
+      return parent->ctx.shard;
+    }
+  }
+
+  return RK_SHARD_ROOT;
+}
+
+static int optimize_graph(struct rk_graph *pt) {
+  // Re-derive all dependant counters, in case node states were changed since the
+  // graph was initialized:
+  int err = count_active_dependants(pt);
+  if (err) return err;
+
+  // Traverse in reverse-topological order, disabling all nodes if they no longer have
+  // any active dependent:
+  struct rk_node *node = pt->ll_topo_tail;
+
+  while (node != 0) {
+
+    RK_COUNT(pt, topo_visits, 1);
+    int err = update_node(pt, node, has_active_dependant(pt, node));
+    if (err) return err;
+
+    node = topo_prev(pt, node);
+  }
+
+  clear_dirty(pt);
+  return 0;
+}
+
+static int optimize_dirty(struct rk_graph *pt) {
+
+  // == STEP 1: Flood from all dirty nodes up to root to discover all nodes which may require an update ==
+
+  start_traversal(pt);
+  struct rk_node *trv_head = 0;
+  struct rk_node *trv_tail = 0;
+
+  for (struct rk_node *node = pt->ll_dirty_head; node != 0; node = node->ctx.ll_dirty) {
+    append_traversed(pt, &trv_head, &trv_tail, node);
+  }
+
+  for (size_t i = 0; pt->shards != 0 && i < pt->shards->shard_count; i++) {
+    for (struct rk_node *node = pt->shards->shard[i].ll_dirty_head; node != 0; node = node->ctx.ll_dirty) {
+      append_traversed(pt, &trv_head, &trv_tail, node);
+    }
+  }
+
+  if (trv_head == 0) return 0; // Nothing to do.
+
+  int err = collect_traversal(pt, &trv_head, true, false);
+  if (err) return err;
+
+  clear_dirty(pt);
+
+  // == STEP 2: Update all non-optimal nodes traversed in step 1 in reverse-topological order ==
+
+  while (trv_head != 0) {
+    RK_COUNT(pt, topo_visits, 1);
+
+
+    bool desired_state = has_active_dependant(pt, trv_head);
+    if (desired_state != trv_head->state) {
+      err = update_node(pt, trv_head, desired_state);
+      if (err) {
+        // Nodes that were not reached remain dirty:
+        for (struct rk_node *node = trv_head->ctx.ll_trv; node != 0; node = node->ctx.ll_trv) {
+          mark_dirty(pt, node);
+        }
+        return err;
+      }
+    }
+
+    trv_head = trv_head->ctx.ll_trv;
+  }
+
+  return 0;
+}
+
+// Equivalent to optimize_graph(), using the graph's bitsets. Only nodes that change state are updated.
+static int optimize_bitset(struct rk_graph *pt) {
+  struct rk_bitset *bs = pt->bitset;
+  size_t word_count = bs->word_count;
+  uint64_t *required = bs->required;
+
+  // Re-derive all dependant counters and the state bitset, in case node states were changed since the
+  // graph was initialized:
+  int err = count_active_dependants(pt);
+  if (err) return err;
+
+  for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+    struct rk_node *node = pt->nodes[node_idx];
+    bitset_assign(bs->state, node->ctx.topo_rank, node->state);
+  }
+
+  // == STEP 1: Determine all nodes required by enabled clients ==
+
+  memset(required, 0, word_count * sizeof(uint64_t));
+
+  for (size_t client_idx = 0; client_idx < bs->client_count; client_idx++) {
+    if (!bs->clients[client_idx]->enabled) continue;
+
+    const uint64_t *closure = &bs->closures[client_idx * word_count];
+    for (size_t w = 0; w < word_count; w++) {
+      required[w] |= closure[w];
+    }
+  }
+
+  // == STEP 2: Find all nodes that are not in the required state ==
+
+  for (size_t w = 0; w < word_count; w++) {
+    required[w] ^= bs->state[w];
+  }
+
+  // == STEP 3: Update these nodes in reverse-topological order ==
+
+  // A node that is not required may still have to remain enabled, because a child failed to disable.
+  // Whether a node actually has to change state is therefore decided by its dependants:
+  for (size_t w = word_count; w-- > 0;) {
+    uint64_t diff = required[w];
+
+    while (diff != 0) {
+      uint32_t bit = highest_bit(diff);
+      diff &= ~((uint64_t)1 << bit);
+
+      struct rk_node *node = bs->order[w * 64 + bit];
+      RK_COUNT(pt, topo_visits, 1);
+
+      bool desired_state = has_active_dependant(pt, node);
+      if (desired_state != node->state) {
+        int err = update_node(pt, node, desired_state);
+        if (err) return err;
+      }
+    }
+  }
+
+  clear_dirty(pt);
+  return 0;
+}
+
+// Add a node to the graph's "dirty" list, unless it is already part of it.
+static void mark_dirty(struct rk_graph *pt, struct rk_node *node) {
+  if (node->ctx.dirty) return;
+  struct rk_node **head = dirty_list(pt, node);
+  node->ctx.dirty = true;
+  node->ctx.ll_dirty = *head;
+  *head = node;
+}
+
+// Add all parents of a client whose enabling or disabling failed to the graph's "dirty" list. All
+// nodes that were updated for this client are parents of these nodes.
+static void mark_client_dirty(struct rk_graph *pt, struct rk_client *client) {
+  for (size_t i = 0; i < client->parent_count; i++) {
+    mark_dirty(pt, client->parents[i]);
+  }
+}
+
+// Empty the graph's "dirty" list, and the lists of all its shards.
+static void clear_dirty(struct rk_graph *pt) {
+  clear_dirty_list(&pt->ll_dirty_head);
+
+  for (size_t i = 0; pt->shards != 0 && i < pt->shards->shard_count; i++) {
+    clear_dirty_list(&pt->shards->shard[i].ll_dirty_head);
+  }
+}
+
+// Empty a "dirty" list.
+static void clear_dirty_list(struct rk_node **head) {
+  struct rk_node *node = *head;
+  while (node != 0) {
+    struct rk_node *next = node->ctx.ll_dirty;
+    node->ctx.dirty = false;
+    node->ctx.ll_dirty = 0;
+    node = next;
+  }
+  *head = 0;
+}
+
+// Remove a node from the graph's "dirty" list, if it is part of it.
+static void unmark_dirty(struct rk_graph *pt, struct rk_node *node) {
+  if (!node->ctx.dirty) return;
+
+  struct rk_node **link = dirty_list(pt, node);
+  while (*link != node) {
+    link = &(*link)->ctx.ll_dirty;
+  }
+  *link = node->ctx.ll_dirty;
+  node->ctx.dirty = false;
+  node->ctx.ll_dirty = 0;
+}
+
+static int enable_node(struct rk_graph *pt, struct rk_node *node, struct rk_node **undo_log) {
+
+  // == STEP 1: Flood from node up to root to discover all nodes which require an update ==
+
+  // The flood stops at nodes that are already enabled, as all their parents are enabled as well:
+  start_traversal(pt);
+  mark_traversed(pt, node);
+  struct rk_node *trv_head = node;
+  int err = collect_traversal(pt, &trv_head, false, true);
+  if (err) return err;
+
+  // == STEP 2: Enable all nodes that were traversed in step 1 in topological order ==
+
+  while (trv_head != 0) {
+    err = enable_step(pt, trv_head, undo_log);
+    if (err) return err;
+
+    trv_head = trv_head->ctx.ll_trv;
+  }
+
+  return 0;
+}
+
+// Equivalent to calling enable_node() for every parent of a client, using the client's precomputed
+// enable plan.
+static int enable_plan(struct rk_graph *pt, struct rk_client *client, struct rk_node **undo_log) {
+  uint32_t start = 0;
+
+  for (size_t parent_idx = 0; parent_idx < client->parent_count; parent_idx++) {
+    struct rk_node *parent = client->parents[parent_idx];
+
+    // The plan of every parent ends with the parent itself:
+    uint32_t end = start;
+    while (end + 1 < client->plan_len && client->plan[end] != parent) {
+      end++;
+    }
+
+    // Walk the parent's plan backwards, marking all nodes that the flood of enable_node() reaches. As
+    // the flood, this stops at nodes that are already enabled:
+    start_traversal(pt);
+    mark_traversed(pt, parent);
+    for (uint32_t i = end + 1; i-- > start;) {
+      struct rk_node *node = client->plan[i];
+      if (!in_traversal(pt, node) || node->state) continue;
+      for (size_t j = 0; j < node->parent_count; j++) {
+        mark_traversed(pt, node->parents[j]);
+      }
+    }
+
+    for (uint32_t i = start; i <= end; i++) {
+      struct rk_node *node = client->plan[i];
+      if (!in_traversal(pt, node)) continue;
+
+      // Enabling a node that is already enabled and has no callback has no effect:
+      if (node->state && node->cb_update == 0) continue;
+
+      int err = enable_step(pt, node, undo_log);
+      if (err) return err;
+    }
+
+    start = end + 1;
+  }
+
+  return 0;
+}
+
+// Enable a single node while enabling a client.
+static int enable_step(struct rk_graph *pt, struct rk_node *node, struct rk_node **undo_log) {
+  RK_COUNT(pt, topo_visits, 1);
+  bool was_enabled = node->state;
+
+  int err = check_fault(node);
+  if (!err) err = update_node(pt, node, true);
+  if (err) return err;
+
+  // Record transition in undo log (if requested):
+  if (undo_log != 0 && !was_enabled) {
+    node->ctx.ll_undo = *undo_log;
+    *undo_log = node;
+  }
+
+  return 0;
+}
+
+// Check that a node may be enabled: A faulted node that is disabled remains disabled until it is recovered.
+static int check_fault(struct rk_node *node) {
+  if (!node->faulted || node->state) return 0;
+
+  RK_LOG_ERR("Cannot enable node '%s': Node has faulted.", node->name);
+  return RK_ERR;
+}
+
+// Disable all nodes in an undo log, reverting the transitions of a partially completed enable.
+static void rollback_enable(struct rk_graph *pt, struct rk_node *undo_log) {
+  // Nodes are reverted in reverse order, so all children that were enabled after a node are
+  // disabled before it. Should a child fail to disable, its parents keep an active dependant and
+  // are left enabled, keeping the graph in a legal (but non-optimal) state:
+  while (undo_log != 0) {
+    RK_LOG_INF("%s: Rolling back.", undo_log->name);
+    update_node(pt, undo_log, has_active_dependant(pt, undo_log));
+    undo_log = undo_log->ctx.ll_undo;
+  }
+}
+
+// Push a node onto a stack of nodes to be disabled, if it is enabled but no longer has any enabled
+// dependant. A node that is still required is never pushed, and neither are its parents through it.
+static void release_node(struct rk_graph *pt, struct rk_node **stack, struct rk_node *node) {
+  if (!node->state || node->ctx.active_dependants != 0 || in_traversal(pt, node)) return;
+  mark_traversed(pt, node);
+  node->ctx.ll_trv = *stack;
+  *stack = node;
+}
+
+// Disable all nodes on a stack of released nodes, and every parent that is released once its last enabled
+// dependant is disabled. As a parent is only released after all its dependants, nodes are disabled in
+// reverse-topological order without flooding or sorting, and the walk stops at nodes that are still required.
+static int disable_released(struct rk_graph *pt, struct rk_node *stack) {
+  while (stack != 0) {
+    struct rk_node *node = stack;
+    stack = node->ctx.ll_trv;
+
+    RK_COUNT(pt, topo_visits, 1);
+    int err = update_node(pt, node, false);
+    if (err) return err;
+
+    // Parents are pushed in reverse, so that they are disabled in order:
+    for (size_t i = node->parent_count; i > 0; i--) {
+      release_node(pt, &stack, node->parents[i - 1]);
+    }
+  }
+
+  return 0;
+}
+
+// Collect a node and all its (direct and indirect) children into the "traverse" list of a new
+// traversal, sorted in (reverse-)topological order. Sets trv_head to the head of the list.
+static int collect_descendants(struct rk_graph *pt, struct rk_node *node, bool reverse, struct rk_node **trv_head) {
+  size_t visits = 0;
+
+  start_traversal(pt);
+  mark_traversed(pt, node);
+  struct rk_node *trv_tail = node;
+  *trv_head = node;
+
+  for (struct rk_node *current = node; current != 0; current = current->ctx.ll_trv) {
+    visits++;
+
+
+    for (size_t i = 0; i < current->child_count; i++) {
+      append_traversed(pt, trv_head, &trv_tail, current->children[i]);
+      current->children[i]->ctx.trv_pending++;
+    }
+  }
+
+  RK_COUNT(pt, flood_visits, visits);
+  *trv_head = countdown_traversal(*trv_head, false, 0);
+  if (reverse) {
+    *trv_head = reverse_traversal(*trv_head);
+  }
+  return 0;
+}
+
+static int fault_node(struct rk_graph *pt, struct rk_node *node) {
+  // Every node depending on the faulted node is disabled from the leaves up, so that no node is
+  // ever enabled while one of its parents is not:
+  struct rk_node *trv_head = 0;
+  int err = collect_descendants(pt, node, true, &trv_head);
+  if (err) return err;
+
+  int first_err = 0;
+
+  for (struct rk_node *current = trv_head; current != 0; current = current->ctx.ll_trv) {
+    RK_COUNT(pt, topo_visits, 1);
+
+    for (size_t i = 0; i < current->client_count; i++) {
+      struct rk_client *client = current->clients[i];
+      if (!client->enabled) continue;
+      set_client_state(client, false);
+      client->unserved = true;
+    }
+
+    if (!current->state) continue;
+    current->ctx.fault_down = true;
+
+    if (current != node) {
+      err = update_node(pt, current, false);
+      if (!err) continue;
+      if (first_err == 0) first_err = err;
+    } else if (pt->trace != 0) {
+      // The faulted node is already off. Its callback is not called:
+      node->ctx.trace_start = pt->trace->cb_timestamp();
+    }
+
+    // Node lost its supply, and is off regardless of its callback:
+    set_node_state(current, false);
+    if (pt->bitset != 0) {
+      bitset_assign(pt->bitset->state, current->ctx.topo_rank, false);
+    }
+    if (current == node && pt->trace != 0) {
+      trace_update(pt, node, true, 0);
+    }
+  }
+
+  node->faulted = true;
+
+  // The node's parents may no longer be required:
+  for (size_t i = 0; i < node->parent_count; i++) {
+    mark_dirty(pt, node->parents[i]);
+  }
+
+  return first_err;
+}
+
+static int recover_node(struct rk_graph *pt, struct rk_node *node) {
+
+  // == STEP 1: Re-enable the node, and all its parents that have been disabled since it faulted ==
+
+  struct rk_node *trv_head = node;
+  int err;
+
+  if (node->ctx.fault_down) {
+    start_traversal(pt);
+    mark_traversed(pt, node);
+    err = collect_traversal(pt, &trv_head, false, true);
+    if (err) return err;
+
+    // Parents that are still enabled are not updated:
+    for (; trv_head != 0; trv_head = trv_head->ctx.ll_trv) {
+      RK_COUNT(pt, topo_visits, 1);
+      if (trv_head->state) continue;
+      err = update_node(pt, trv_head, true);
+      if (err) return err;
+    }
+    node->ctx.fault_down = false;
+  }
+
+  // == STEP 2: Re-enable all children that were disabled by the fault in topological order ==
+
+  err = collect_descendants(pt, node, false, &trv_head);
+  if (err) return err;
+
+  for (struct rk_node *current = trv_head; current != 0; current = current->ctx.ll_trv) {
+    if (!current->ctx.fault_down) continue;
+    RK_COUNT(pt, topo_visits, 1);
+
+    // Children that also depend on a node that is still disabled (for example because it faulted as
+    // well) remain disabled until that node is recovered:
+    bool parents_enabled = true;
+    for (size_t i = 0; i < current->parent_count; i++) {
+      parents_enabled &= current->parents[i]->state;
+    }
+    if (!parents_enabled) continue;
+
+    err = update_node(pt, current, true);
+    if (err) return err;
+    current->ctx.fault_down = false;
+  }
+
+  // == STEP 3: Re-enable all unserved clients once all their parents are enabled ==
+
+  for (struct rk_node *current = trv_head; current != 0; current = current->ctx.ll_trv) {
+    for (size_t i = 0; i < current->client_count; i++) {
+      struct rk_client *client = current->clients[i];
+      if (!client->unserved) continue;
+
+      bool parents_enabled = true;
+      for (size_t parent_idx = 0; parent_idx < client->parent_count; parent_idx++) {
+        parents_enabled &= client->parents[parent_idx]->state;
+      }
+      if (!parents_enabled) continue;
+
+      set_client_state(client, true);
+      client->unserved = false;
+    }
+  }
+
+  node->faulted = false;
+  return 0;
+}
+
+// Extend a "traverse" list of the current traversal by all (direct and indirect) parents of the
+// nodes already in it, and sort it in (reverse-)topological order. If prune is set, the parents of
+// nodes that are already enabled are not collected: A node is only ever enabled if all its parents
+// are. Updates trv_head to the new head.
+static int collect_traversal(struct rk_graph *pt, struct rk_node **trv_head, bool reverse, bool prune) {
+  if (pt->csr != 0) {
+    *trv_head = csr_collect_traversal(pt, *trv_head, reverse, prune);
+    return 0;
+  }
+
+  // Discovered nodes are kept in a frontier heap, ordered by topological rank. Every node is discovered
+  // by one of its children, so always taking the node with the highest rank visits all nodes in
+  // reverse-topological order. Visited nodes are appended to (or prepended to, for topological order)
+  // the "traverse" list:
+  struct rk_node *heap = 0;
+  for (struct rk_node *node = *trv_head; node != 0;) {
+    struct rk_node *next = node->ctx.ll_trv;
+    heap = heap_meld(heap, node);
+    node = next;
+  }
+
+  size_t visits = 0;
+  struct rk_node *trv_tail = 0;
+  *trv_head = 0;
+
+  while (heap != 0) {
+    struct rk_node *current = heap_pop(&heap);
+    visits++;
+
+    if (reverse) {
+      current->ctx.ll_trv = 0;
+      if (trv_tail == 0) {
+        *trv_head = current;
+      } else {
+        trv_tail->ctx.ll_trv = current;
+      }
+      trv_tail = current;
+    } else {
+      current->ctx.ll_trv = *trv_head;
+      *trv_head = current;
+    }
+
+    if (prune && current->state) continue;
+
+    for (size_t i = 0; i < current->parent_count; i++) {
+      struct rk_node *parent = current->parents[i];
+      if (parent == 0) {
+        RK_LOG_ERR("Node '%s's parent %zd is a null pointer.", current->name, i);
+        return RK_ERR;
+      }
+
+      if (!in_traversal(pt, parent)) {
+        mark_traversed(pt, parent);
+        heap = heap_meld(heap, parent);
+      }
+    }
+  }
+
+  RK_COUNT(pt, flood_visits, visits);
+  return 0;
+}
+
+// Extend a "traverse" list of the current traversal by all (direct and indirect) parents of
+// the nodes already in it. Counts the children inside the list of every node in its trv_pending.
+static int flood_ancestors(struct rk_graph *pt, struct rk_node *trv_head, struct rk_node *trv_tail) {
+  size_t visits = 0;
+
+  while (trv_head != 0) {
+    visits++;
+
+    for (size_t i = 0; i < trv_head->parent_count; i++) {
+      struct rk_node *parent = trv_head->parents[i];
+      if (parent == 0) {
+        RK_LOG_ERR("Node '%s's parent %zd is a null pointer.", trv_head->name, i);
+        return RK_ERR;
+      }
+
+      // Check if parent is already in "traverse" linked list:
+      if (!in_traversal(pt, parent)) {
+        // Parent not already in list. Append:
+        mark_traversed(pt, parent);
+        trv_tail->ctx.ll_trv = parent;
+        trv_tail = parent;
+      }
+
+      parent->ctx.trv_pending++;
+    }
+
+    trv_head = trv_head->ctx.ll_trv;
+  }
+
+  RK_COUNT(pt, flood_visits, visits);
+  return 0;
+}
+
+// Sort a "traverse" list by counting down the number of nodes every node has to be visited after.
+// If upward is set, every node's trv_pending must be the number of its children inside the list, and
+// the list is sorted in reverse-topological order. Otherwise, it must be the number of its parents
+// inside the list, and the list is sorted in topological order. Edges to skip are ignored.
+// Returns the new head of the list.
+static struct rk_node *countdown_traversal(struct rk_node *list, bool upward, struct rk_node *skip) {
+  // The "traverse" list is re-used as a queue of nodes that no longer wait for any other node, starting
+  // with the nodes that never did. Nodes are only ever appended behind the node that is being visited:
+  struct rk_node *ready_head = 0;
+  struct rk_node *ready_tail = 0;
+
+  while (list != 0) {
+    struct rk_node *next = list->ctx.ll_trv;
+    if (list->ctx.trv_pending == 0) {
+      list->ctx.ll_trv = 0;
+      if (ready_tail == 0) {
+        ready_head = list;
+      } else {
+        ready_tail->ctx.ll_trv = list;
+      }
+      ready_tail = list;
+    }
+    list = next;
+  }
+
+  for (struct rk_node *node = ready_head; node != 0; node = node->ctx.ll_trv) {
+    uint32_t count = upward ? node->parent_count : node->child_count;
+
+    for (uint32_t i = 0; i < count; i++) {
+      struct rk_node *other = upward ? node->parents[i] : node->children[i];
+      if (other == skip) continue;
+
+      other->ctx.trv_pending--;
+      if (other->ctx.trv_pending == 0) {
+        other->ctx.ll_trv = 0;
+        ready_tail->ctx.ll_trv = other;
+        ready_tail = other;
+      }
+    }
+  }
+
+  return ready_head;
+}
+
+// Reverse a "traverse" list. Returns the new head of the list.
+static struct rk_node *reverse_traversal(struct rk_node *list) {
+  struct rk_node *head = 0;
+  while (list != 0) {
+    struct rk_node *next = list->ctx.ll_trv;
+    list->ctx.ll_trv = head;
+    head = list;
+    list = next;
+  }
+  return head;
+}
+
+// Merge two frontier heaps of nodes, ordered by topological rank (highest rank first). Heaps are pairing
+// heaps, linked through the ll_heap (first child) and ll_trv (next sibling) pointers of their nodes.
+// Returns the merged heap.
+static struct rk_node *heap_meld(struct rk_node *a, struct rk_node *b) {
+  if (a == 0) return b;
+  if (b == 0) return a;
+
+  if (b->ctx.topo_rank > a->ctx.topo_rank) {
+    struct rk_node *tmp = a;
+    a = b;
+    b = tmp;
+  }
+
+  b->ctx.ll_trv = a->ctx.ll_heap;
+  a->ctx.ll_heap = b;
+  return a;
+}
+
+// Remove the node with the highest topological rank from a frontier heap. Returns the node.
+static struct rk_node *heap_pop(struct rk_node **heap) {
+  struct rk_node *top = *heap;
+  struct rk_node *child = top->ctx.ll_heap;
+
+  // Merge the children of the removed node in pairs from first to last, and then all pairs from last
+  // to first:
+  struct rk_node *pairs = 0;
+  while (child != 0) {
+    struct rk_node *first = child;
+    struct rk_node *second = first->ctx.ll_trv;
+    child = second != 0 ? second->ctx.ll_trv : 0;
+
+    struct rk_node *pair = heap_meld(first, second);
+    pair->ctx.ll_trv = pairs;
+    pairs = pair;
+  }
+
+  *heap = 0;
+  while (pairs != 0) {
+    struct rk_node *next = pairs->ctx.ll_trv;
+    *heap = heap_meld(*heap, pairs);
+    pairs = next;
+  }
+
+  return top;
+}
+
+// Sort a "traverse" list by topological rank (bottom-up merge sort), so that it only has
+// to be walked once to visit its nodes in (reverse-)topological order.
+// Returns the new head of the list.
+static struct rk_node *sort_traversal(struct rk_node *list, bool reverse) {
+  if (list == 0) return 0;
+
+  // Merge runs of length 1, 2, 4, ... until the whole list has been merged into a single run:
+  for (size_t run_len = 1;; run_len *= 2) {
+    struct rk_node *p = list;
+    struct rk_node *tail = 0;
+    size_t merge_count = 0;
+    list = 0;
+
+    while (p != 0) {
+      merge_count++;
+
+      // Run 'p' is up to run_len nodes long and followed by run 'q':
+      struct rk_node *q = p;
+      size_t p_len = 0;
+      while (p_len < run_len && q != 0) {
+        p_len++;
+        q = q->ctx.ll_trv;
+      }
+      size_t q_len = run_len;
+
+      // Merge both runs:
+      while (p_len > 0 || (q_len > 0 && q != 0)) {
+        bool take_p;
+        if (p_len == 0) {
+          take_p = false;
+        } else if (q_len == 0 || q == 0) {
+          take_p = true;
+        } else if (reverse) {
+          take_p = p->ctx.topo_rank > q->ctx.topo_rank;
+        } else {
+          take_p = p->ctx.topo_rank < q->ctx.topo_rank;
+        }
+
+        struct rk_node *next;
+        if (take_p) {
+          next = p;
+          p = p->ctx.ll_trv;
+          p_len--;
+        } else {
+          next = q;
+          q = q->ctx.ll_trv;
+          q_len--;
+        }
+
+        if (tail == 0) {
+          list = next;
+        } else {
+          tail->ctx.ll_trv = next;
+        }
+        tail = next;
+      }
+
+      p = q;
+    }
+
+    tail->ctx.ll_trv = 0;
+
+    if (merge_count <= 1) return list;
+  }
+}
+
+// Extend a "traverse" list of the current traversal by all (direct and indirect) parents of the nodes
+// already in it, and sort it in (reverse-)topological order, using the compiled graph. If prune is set,
+// the parents of nodes that are already enabled are not collected. Returns the new head of the list.
+static struct rk_node *csr_collect_traversal(struct rk_graph *pt, struct rk_node *trv_head, bool reverse, bool prune) {
+  struct rk_csr *csr = pt->csr;
+
+  // Parents always have a lower index than their children. Repeatedly taking the discovered node with
+  // the highest index therefor visits all nodes in reverse-topological order. The visited nodes are
+  // stored at the end of the heap array, which never overlaps with the heap itself:
+  size_t heap_len = 0;
+  size_t sorted_start = pt->node_count;
+
+  for (struct rk_node *node = trv_head; node != 0; node = node->ctx.ll_trv) {
+    if (csr->trv_epoch[node->ctx.topo_rank] == pt->trv_epoch) continue;
+    csr->trv_epoch[node->ctx.topo_rank] = pt->trv_epoch;
+    csr_heap_push(csr, &heap_len, node->ctx.topo_rank);
+  }
+
+  while (heap_len != 0) {
+    uint32_t idx = csr_heap_pop(csr, &heap_len);
+    sorted_start--;
+    csr_store(csr, csr->trv_heap, sorted_start, idx);
+    if (prune && csr->order[idx]->state) continue;
+
+    uint32_t edge_end = csr_load(csr, csr->parent_offsets, idx + 1);
+    for (uint32_t edge = csr_load(csr, csr->parent_offsets, idx); edge < edge_end; edge++) {
+      uint32_t parent_idx = csr_load(csr, csr->parents, edge);
+      if (csr->trv_epoch[parent_idx] == pt->trv_epoch) continue;
+      csr->trv_epoch[parent_idx] = pt->trv_epoch;
+      csr_heap_push(csr, &heap_len, parent_idx);
+    }
+  }
+
+  RK_COUNT(pt, flood_visits, pt->node_count - sorted_start);
+
+  // Link all visited nodes into the "traverse" list in the requested order:
+  struct rk_node *head = 0;
+  struct rk_node *tail = 0;
+
+  for (size_t i = sorted_start; i < pt->node_count; i++) {
+    size_t pos = reverse ? (pt->node_count - 1 - (i - sorted_start)) : i;
+    struct rk_node *node = csr->order[csr_load(csr, csr->trv_heap, pos)];
+    mark_traversed(pt, node);
+
+    if (tail == 0) {
+      head = node;
+    } else {
+      tail->ctx.ll_trv = node;
+    }
+    tail = node;
+  }
+
+  return head;
+}
+
+// Push a node index onto the (max-)heap of a compiled graph.
+static void csr_heap_push(struct rk_csr *csr, size_t *heap_len, uint32_t idx) {
+  size_t pos = (*heap_len)++;
+
+  while (pos > 0) {
+    size_t parent_pos = (pos - 1) / 2;
+    uint32_t parent = csr_load(csr, csr->trv_heap, parent_pos);
+    if (parent >= idx) break;
+    csr_store(csr, csr->trv_heap, pos, parent);
+    pos = parent_pos;
+  }
+
+  csr_store(csr, csr->trv_heap, pos, idx);
+}
+
+// Remove the highest node index from the (max-)heap of a compiled graph.
+static uint32_t csr_heap_pop(struct rk_csr *csr, size_t *heap_len) {
+  uint32_t top = csr_load(csr, csr->trv_heap, 0);
+  uint32_t last = csr_load(csr, csr->trv_heap, --(*heap_len));
+  size_t pos = 0;
+
+  while (true) {
+    size_t child_pos = 2 * pos + 1;
+    if (child_pos >= *heap_len) break;
+
+    uint32_t child = csr_load(csr, csr->trv_heap, child_pos);
+    if (child_pos + 1 < *heap_len) {
+      uint32_t sibling = csr_load(csr, csr->trv_heap, child_pos + 1);
+      if (sibling > child) {
+        child = sibling;
+        child_pos++;
+      }
+    }
+
+    if (last >= child) break;
+    csr_store(csr, csr->trv_heap, pos, child);
+    pos = child_pos;
+  }
+
+  if (*heap_len != 0) {
+    csr_store(csr, csr->trv_heap, pos, last);
+  }
+
+  return top;
+}
+
+// Calculate the layout of a compiled graph inside its buffer. If buf is given, the array pointers
+// of the compiled graph are set accordingly.
+// Returns the required size of the buffer.
+static size_t csr_layout(struct rk_graph *pt, struct rk_csr *csr, uint8_t *buf) {
+  size_t edge_count = 0;
+  for (size_t i = 0; i < pt->node_count; i++) {
+    edge_count += pt->nodes[i]->parent_count;
+  }
+
+  csr->wide = pt->node_count > UINT16_MAX || edge_count > UINT16_MAX;
+  size_t idx_size = csr->wide ? sizeof(uint32_t) : sizeof(uint16_t);
+
+  size_t order_offset = 0;
+  size_t trv_epoch_offset = order_offset + pt->node_count * sizeof(struct rk_node *);
+  size_t parent_offsets_offset = trv_epoch_offset + pt->node_count * sizeof(uint32_t);
+  size_t parents_offset = parent_offsets_offset + (pt->node_count + 1) * idx_size;
+  size_t trv_heap_offset = parents_offset + edge_count * idx_size;
+  size_t size = trv_heap_offset + pt->node_count * idx_size;
+
+  if (buf != 0) {
+    csr->order = (struct rk_node **)(buf + order_offset);
+    csr->trv_epoch = (uint32_t *)(buf + trv_epoch_offset);
+    csr->parent_offsets = buf + parent_offsets_offset;
+    csr->parents = buf + parents_offset;
+    csr->trv_heap = buf + trv_heap_offset;
+  }
+
+  return size;
+}
+
+// Compile the graph into its compressed sparse row layout. The nodes must already be ranked in
+// topological order.
+static int compile_csr(struct rk_graph *pt) {
+  struct rk_csr *csr = pt->csr;
+
+  size_t size = csr_layout(pt, csr, 0);
+  if (csr->buf == 0 || csr->buf_size < size) {
+    RK_LOG_ERR("Cannot compile graph: Buffer is %zd bytes, but %zd bytes are required.", csr->buf_size, size);
+    return RK_ERR;
+  }
+  csr_layout(pt, csr, csr->buf);
+
+  for (struct rk_node *node = pt->root; node != 0; node = node->ctx.ll_topo_next) {
+    csr->order[node->ctx.topo_rank] = node;
+  }
+
+  uint32_t edge = 0;
+  for (size_t idx = 0; idx < pt->node_count; idx++) {
+    struct rk_node *node = csr->order[idx];
+    csr->trv_epoch[idx] = 0;
+    csr_store(csr, csr->parent_offsets, idx, edge);
+
+    for (size_t i = 0; i < node->parent_count; i++) {
+      csr_store(csr, csr->parents, edge, node->parents[i]->ctx.topo_rank);
+      edge++;
+    }
+  }
+  csr_store(csr, csr->parent_offsets, pt->node_count, edge);
+
+  return 0;
+}
+
+// Calculate the enable plans of all clients of the graph, and store them in buf (if given). Sets
+// entry_count to the total length of all plans. Without buf, only counts the entries of every plan,
+// without modifying any plan or traversal data.
+//
+// Every plan contains, for every parent of the client, the parent and all its direct and indirect
+// parents. Ancestors shared by multiple parents or clients are stored once per parent, so that
+// the total length is at most the number of client edges times the number of nodes.
+static int plans_layout(struct rk_graph *pt, struct rk_node **buf, size_t *entry_count) {
+  size_t count = 0;
+
+  for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+    struct rk_node *node = pt->nodes[node_idx];
+
+    for (size_t i = 0; i < node->client_count; i++) {
+      struct rk_client *client = node->clients[i];
+
+      // Clients are only reachable through their parents. Every client is handled through the first edge to
+      // its first parent:
+      if (client->parent_count == 0 || client->parents[0] != node) continue;
+      bool is_duplicate = false;
+      for (size_t j = 0; j < i; j++) {
+        is_duplicate |= node->clients[j] == client;
+      }
+      if (is_duplicate) continue;
+
+      size_t plan_start = count;
+
+      // Same nodes, in the same order, as visited by enable_node() for every parent:
+      for (size_t parent_idx = 0; parent_idx < client->parent_count; parent_idx++) {
+        struct rk_node *parent = client->parents[parent_idx];
+
+        if (buf == 0) {
+          count += count_ancestors(pt, parent);
+          continue;
+        }
+
+        start_traversal(pt);
+        mark_traversed(pt, parent);
+        struct rk_node *trv_head = parent;
+        int err = collect_traversal(pt, &trv_head, false, false);
+        if (err) return err;
+
+        for (; trv_head != 0; trv_head = trv_head->ctx.ll_trv) {
+          buf[count] = trv_head;
+          count++;
+        }
+      }
+
+      if (buf != 0) {
+        client->plan_len = (uint32_t)(count - plan_start);
+        client->plan = &buf[plan_start];
+      }
+    }
+  }
+
+  *entry_count = count;
+  return 0;
+}
+
+// Count a node and all its direct and indirect parents. Only uses the size calculation scratch
+// data, so that it can be used while the graph is initialized.
+static size_t count_ancestors(struct rk_graph *pt, struct rk_node *node) {
+  pt->size_epoch++;
+  if (pt->size_epoch == 0) {
+    // Epoch wrapped around. Clear all stamps so that no node appears to be counted already:
+    for (size_t i = 0; i < pt->node_count; i++) {
+      pt->nodes[i]->ctx.size_epoch = 0;
+    }
+    pt->size_epoch = 1;
+  }
+
+  // Nodes to visit are kept on a stack linked via ll_size:
+  size_t count = 1;
+  node->ctx.size_epoch = pt->size_epoch;
+  node->ctx.ll_size = 0;
+
+  while (node != 0) {
+    struct rk_node *next = node->ctx.ll_size;
+    for (size_t i = 0; i < node->parent_count; i++) {
+      struct rk_node *parent = node->parents[i];
+      if (parent->ctx.size_epoch == pt->size_epoch) continue;
+      parent->ctx.size_epoch = pt->size_epoch;
+      parent->ctx.ll_size = next;
+      next = parent;
+      count++;
+    }
+    node = next;
+  }
+
+  return count;
+}
+
+// Clear the enable plans of all clients.
+static void reset_plans(struct rk_graph *pt) {
+  for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+    struct rk_node *node = pt->nodes[node_idx];
+    for (size_t i = 0; i < node->client_count; i++) {
+      node->clients[i]->plan = 0;
+      node->clients[i]->plan_len = 0;
+    }
+  }
+}
+
+// Precompute the enable plans of all clients, if the graph has a plans buffer. Otherwise, clears
+// all plans. The nodes must already be ranked in topological order.
+static int build_plans(struct rk_graph *pt) {
+  reset_plans(pt);
+  if (pt->plans == 0) return 0;
+
+  size_t entry_count = 0;
+  int err = plans_layout(pt, 0, &entry_count);
+  if (err) return err;
+
+  size_t size = entry_count * sizeof(struct rk_node *);
+  if (pt->plans->buf == 0 || pt->plans->buf_size < size) {
+    RK_LOG_ERR("Cannot build enable plans: Buffer is %zd bytes, but %zd bytes are required.", pt->plans->buf_size,
+               size);
+    return RK_ERR;
+  }
+
+  return plans_layout(pt, pt->plans->buf, &entry_count);
+}
+
+// Calculate the impact lists of all nodes of the graph, and store them in buf (if given). Every client
+// is added to the list of every node in its closure (all its parents, and their direct and indirect
+// parents). Without buf, only counts the entries of every list. Sets entry_count to the total
+// length of all lists.
+static int impact_layout(struct rk_graph *pt, struct rk_client **buf, size_t *entry_count) {
+  if (buf != 0) {
+    // Lists are stored consecutively, in the order of the graph's node array:
+    size_t offset = 0;
+    for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+      struct rk_node *node = pt->nodes[node_idx];
+      node->ctx.impact = &buf[offset];
+      offset += node->ctx.impact_len;
+      node->ctx.impact_len = 0;
+    }
+  } else {
+    for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+      pt->nodes[node_idx]->ctx.impact = 0;
+      pt->nodes[node_idx]->ctx.impact_len = 0;
+    }
+  }
+
+  size_t count = 0;
+
+  for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+    struct rk_node *node = pt->nodes[node_idx];
+
+    for (size_t i = 0; i < node->client_count; i++) {
+      struct rk_client *client = node->clients[i];
+
+      // Clients are only reachable through their parents. Only visit every client through the first
+      // edge to its first parent:
+      if (client->parent_count == 0 || client->parents[0] != node) continue;
+      bool is_duplicate = false;
+      for (size_t j = 0; j < i; j++) {
+        is_duplicate |= node->clients[j] == client;
+      }
+      if (is_duplicate) continue;
+
+      start_traversal(pt);
+      struct rk_node *trv_head = 0;
+      struct rk_node *trv_tail = 0;
+      for (size_t parent_idx = 0; parent_idx < client->parent_count; parent_idx++) {
+        append_traversed(pt, &trv_head, &trv_tail, client->parents[parent_idx]);
+      }
+
+      int err = flood_ancestors(pt, trv_head, trv_tail);
+      if (err) return err;
+
+      for (; trv_head != 0; trv_head = trv_head->ctx.ll_trv) {
+        if (buf != 0) {
+          trv_head->ctx.impact[trv_head->ctx.impact_len] = client;
+        }
+        trv_head->ctx.impact_len++;
+        count++;
+      }
+    }
+  }
+
+  *entry_count = count;
+  return 0;
+}
+
+// Build the impact index of the graph.
+static int build_impact(struct rk_graph *pt) {
+  size_t entry_count = 0;
+  int err = impact_layout(pt, 0, &entry_count);
+  if (err) return err;
+
+  size_t size = entry_count * sizeof(struct rk_client *);
+  if (pt->impact->buf == 0 || pt->impact->buf_size < size) {
+    RK_LOG_ERR("Cannot build impact index: Buffer is %zd bytes, but %zd bytes are required.", pt->impact->buf_size,
+               size);
+    return RK_ERR;
+  }
+
+  return impact_layout(pt, pt->impact->buf, &entry_count);
+}
+
+// Calculate the layout of a graph's bitsets inside their buffer. If buf is given, the array pointers of
+// the bitsets are set accordingly, and all clients are collected into the clients array.
+// Returns the required size of the buffer.
+static size_t bitset_layout(struct rk_graph *pt, struct rk_bitset *bs, uint8_t *buf) {
+  // Clients are only reachable through their parents. Stamp every client when it is first found:
+  start_traversal(pt);
+  size_t client_count = 0;
+  for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+    struct rk_node *node = pt->nodes[node_idx];
+    for (size_t i = 0; i < node->client_count; i++) {
+      if (node->clients[i]->trv_epoch == pt->trv_epoch) continue;
+      node->clients[i]->trv_epoch = pt->trv_epoch;
+      client_count++;
+    }
+  }
+
+  bs->word_count = (pt->node_count + 63) / 64;
+  bs->client_count = client_count;
+
+  size_t words_size = bs->word_count * sizeof(uint64_t);
+  size_t state_offset = 0;
+  size_t required_offset = state_offset + words_size;
+  size_t closures_offset = required_offset + words_size;
+  size_t order_offset = closures_offset + client_count * words_size;
+  size_t clients_offset = order_offset + pt->node_count * sizeof(struct rk_node *);
+  size_t size = clients_offset + client_count * sizeof(struct rk_client *);
+
+  if (buf != 0) {
+    bs->state = (uint64_t *)(buf + state_offset);
+    bs->required = (uint64_t *)(buf + required_offset);
+    bs->closures = (uint64_t *)(buf + closures_offset);
+    bs->order = (struct rk_node **)(buf + order_offset);
+    bs->clients = (struct rk_client **)(buf + clients_offset);
+
+    size_t client_idx = 0;
+    for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+      struct rk_node *node = pt->nodes[node_idx];
+      for (size_t i = 0; i < node->client_count; i++) {
+        if (node->clients[i]->trv_epoch != pt->trv_epoch) continue;
+        node->clients[i]->trv_epoch = 0;
+        bs->clients[client_idx++] = node->clients[i];
+      }
+    }
+  }
+
+  return size;
+}
+
+// Build the bitsets of the graph. The nodes must already be ranked in topological order.
+static int build_bitset(struct rk_graph *pt) {
+  struct rk_bitset *bs = pt->bitset;
+
+  size_t size = bitset_layout(pt, bs, 0);
+  if (bs->buf == 0 || bs->buf_size < size) {
+    RK_LOG_ERR("Cannot build bitsets: Buffer is %zd bytes, but %zd bytes are required.", bs->buf_size, size);
+    return RK_ERR;
+  }
+  memset(bs->buf, 0, size);
+  bitset_layout(pt, bs, bs->buf);
+
+  for (struct rk_node *node = pt->root; node != 0; node = node->ctx.ll_topo_next) {
+    bs->order[node->ctx.topo_rank] = node;
+    bitset_assign(bs->state, node->ctx.topo_rank, node->state);
+  }
+
+  for (size_t client_idx = 0; client_idx < bs->client_count; client_idx++) {
+    struct rk_client *client = bs->clients[client_idx];
+    if (client_contains_nullptr(client)) {
+      RK_LOG_ERR("Client '%s' contains a null pointer.", client->name);
+      return RK_ERR;
+    }
+
+    start_traversal(pt);
+    struct rk_node *trv_head = 0;
+    struct rk_node *trv_tail = 0;
+    for (size_t i = 0; i < client->parent_count; i++) {
+      append_traversed(pt, &trv_head, &trv_tail, client->parents[i]);
+    }
+
+    int err = flood_ancestors(pt, trv_head, trv_tail);
+    if (err) return err;
+
+    uint64_t *closure = &bs->closures[client_idx * bs->word_count];
+    for (; trv_head != 0; trv_head = trv_head->ctx.ll_trv) {
+      bitset_assign(closure, trv_head->ctx.topo_rank, true);
+    }
+  }
+
+  return 0;
+}
+
+// Add a node to a shard and append it to the "traverse" list, unless it is the root or already part of
+// a shard.
+static inline void join_shard(struct rk_graph *pt, struct rk_node **trv_tail, struct rk_node *node, uint32_t shard) {
+  if (node == pt->root || node->ctx.shard != RK_SHARD_ROOT) return;
+  node->ctx.shard = shard;
+  node->ctx.ll_trv = 0;
+  (*trv_tail)->ctx.ll_trv = node;
+  *trv_tail = node;
+}
+
+// Assign every node except the root to a shard: A connected component of the graph without its root, in
+// which nodes are connected to their parents, their children, and the other parents of their clients.
+// If shards is given, the nodes of every shard are linked in topological order.
+// Sets shard_count to the number of shards.
+static int shards_layout(struct rk_graph *pt, struct rk_shard *shards, size_t *shard_count) {
+  for (size_t i = 0; i < pt->node_count; i++) {
+    pt->nodes[i]->ctx.shard = RK_SHARD_ROOT;
+  }
+
+  // Flood every shard from the first node that is not yet part of a shard, using the "traverse"
+  // list as a queue:
+  *shard_count = 0;
+  for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+    struct rk_node *node = pt->nodes[node_idx];
+    if (node == pt->root || node->ctx.shard != RK_SHARD_ROOT) continue;
+
+    uint32_t shard = (uint32_t)*shard_count;
+    (*shard_count)++;
+    node->ctx.shard = shard;
+    node->ctx.ll_trv = 0;
+    struct rk_node *trv_tail = node;
+
+    for (struct rk_node *current = node; current != 0; current = current->ctx.ll_trv) {
+      for (size_t i = 0; i < current->parent_count; i++) {
+        join_shard(pt, &trv_tail, current->parents[i], shard);
+      }
+      for (size_t i = 0; i < current->child_count; i++) {
+        join_shard(pt, &trv_tail, current->children[i], shard);
+      }
+      for (size_t i = 0; i < current->client_count; i++) {
+        struct rk_client *client = current->clients[i];
+        if (client_contains_nullptr(client)) {
+          RK_LOG_ERR("Client '%s' contains a null pointer.", client->name);
+          return RK_ERR;
+        }
+        for (size_t j = 0; j < client->parent_count; j++) {
+          join_shard(pt, &trv_tail, client->parents[j], shard);
+        }
+      }
+    }
+  }
+
+  if (shards == 0) return 0;
+
+  // Link the nodes of every shard by walking the topological order backwards, prepending every node:
+  memset(shards, 0, *shard_count * sizeof(struct rk_shard));
+  for (struct rk_node *node = pt->ll_topo_tail; node != pt->root; node = node->ctx.ll_topo_prev) {
+    struct rk_shard *shard = &shards[node->ctx.shard];
+    node->ctx.ll_shard = shard->ll_topo_head;
+    shard->ll_topo_head = node;
+    shard->node_count++;
+  }
+
+  return 0;
+}
+
+static int build_shards(struct rk_graph *pt) {
+  struct rk_shards *shards = pt->shards;
+
+  if (shards->cb_lock == 0 || shards->cb_unlock == 0) {
+    RK_LOG_ERR("Cannot build shards: Missing %s callback.", shards->cb_lock == 0 ? "lock" : "unlock");
+    return RK_ERR;
+  }
+
+  // Trace buffers only support a single producer, and bitset words are shared by nodes of different shards:
+  if (pt->trace != 0 || pt->bitset != 0) {
+    RK_LOG_ERR("Cannot build shards: Graph has %s, which sharded graphs do not support.",
+               pt->trace != 0 ? "a trace buffer" : "bitsets");
+    return RK_ERR;
+  }
+
+  size_t shard_count = 0;
+  int err = shards_layout(pt, 0, &shard_count);
+  if (err) return err;
+
+  size_t size = shard_count * sizeof(struct rk_shard);
+  if (shards->buf == 0 || shards->buf_size < size) {
+    RK_LOG_ERR("Cannot build shards: Buffer is %zd bytes, but %zd bytes are required.", shards->buf_size, size);
+    return RK_ERR;
+  }
+
+  err = shards_layout(pt, shards->buf, &shard_count);
+  if (err) return err;
+
+  shards->shard = shards->buf;
+  shards->shard_count = shard_count;
+  return 0;
+}
+
+static int update_node(struct rk_graph *pt, struct rk_node *node, bool new_state) {
+  return finish_update(pt, node, call_update(pt, node, new_state));
+}
+
+// Start updating a node outside of rk_apply(), where callbacks cannot complete asynchronously.
+static int call_update(struct rk_graph *pt, struct rk_node *node, bool new_state) {
+  int err = start_update(pt, node, new_state, false);
+
+  if (err == RK_PENDING) {
+    RK_LOG_ERR("Node '%s': Callback returned RK_PENDING, which is only supported during rk_apply().", node->name);
+    err = RK_ERR;
+  }
+
+  return err;
+}
+
+// Start updating a node, calling its callback if it has one. If dispatch is set and the graph has
+// a dispatch callback, the node's callback is invoked through it.
+// Returns the callback's return value (which may be RK_PENDING), or 0 if there is no callback or
+// the call was elided.
+static int start_update(struct rk_graph *pt, struct rk_node *node, bool new_state, bool dispatch) {
+  node->desired_state = new_state;
+
+  if (pt->trace != 0) {
+    node->ctx.trace_start = pt->trace->cb_timestamp();
+  } else if (node->desired_state != node->state) {
+    RK_LOG_INF("%s: %s -> %s", node->name, RK_ON_OFF(node->state), RK_ON_OFF(node->desired_state));
+  }
+
+  if (cb_elided(pt, node)) {
+    node->cb_elided++;
+    atomic_fetch_add_explicit(&pt->cb_elided, 1, memory_order_relaxed);
+    return 0;
+  }
+
+  if (node->cb_update != 0) {
+    node->ctx.cb_start = latency_now(pt, node->cb_latency);
+    if (dispatch && pt->cb_dispatch != 0) {
+      return pt->cb_dispatch(pt, node);
+    }
     // Attempt to update node using callback:
-    int err = node->cb_update(node);
+    return node->cb_update(node);
+  } else {
+    // Update cannot fail if there is no update.
+    return 0;
+  }
+}
+
+// Finish updating a node, given the return value of its callback.
+static int finish_update(struct rk_graph *pt, struct rk_node *node, int err) {
+  bool cb_called = node->cb_update != 0 && !cb_elided(pt, node);
+  bool old_state = node->state;
+
+  if (!err) {
+    set_node_state(node, node->desired_state);
+    if (pt->bitset != 0) {
+      bitset_assign(pt->bitset->state, node->ctx.topo_rank, node->state);
+    }
+  }
+
+  if (cb_called) {
+    record_latency(pt, node->cb_latency, node->ctx.cb_start);
     node->previous_cb_return = err;
-    if (err) {
-      RK_LOG_ERR("Node '%s': Callback returned error %i! Graph in non-optimal state. Node left %s.", node->name, err,
-                 RK_ON_OFF(node->state));
-      return err;
+    RK_COUNT(pt, cb_calls, 1);
+    if (node->state != old_state) RK_COUNT(pt, cb_transitions, 1);
+    if (err) RK_COUNT(pt, cb_failures, 1);
+  }
+
+  if (pt->trace != 0 && (cb_called || node->state != old_state)) {
+    trace_update(pt, node, old_state, err);
+  }
+
+  if (err) {
+    RK_LOG_ERR("Node '%s': Callback returned error %i! Graph in non-optimal state. Node left %s.", node->name, err,
+               RK_ON_OFF(node->state));
+    mark_dirty(pt, node);
+    return err;
+  }
+
+  return 0;
+}
+
+// Append a record of a node update to the graph's trace buffer.
+static void trace_update(struct rk_graph *pt, struct rk_node *node, bool old_state, int err) {
+  struct rk_trace_record record = {
+      .timestamp = node->ctx.trace_start,
+      .duration = pt->trace->cb_timestamp() - node->ctx.trace_start,
+      .node = node->ctx.node_idx,
+      .cb_return = err,
+      .old_state = old_state,
+      .new_state = node->state,
+      .type = RK_TRACE_UPDATE,
+  };
+  trace_push(pt->trace, &record);
+}
+
+// Append a record of a completed request to the graph's trace buffer (if it has one).
+static void trace_request(struct rk_graph *pt, uint32_t request, uint32_t start, int err) {
+  if (pt->trace == 0) return;
+
+  struct rk_trace_record record = {
+      .timestamp = start,
+      .duration = pt->trace->cb_timestamp() - start,
+      .node = request,
+      .cb_return = err,
+      .type = RK_TRACE_REQUEST,
+  };
+  trace_push(pt->trace, &record);
+}
+
+static void trace_push(struct rk_trace *trace, const struct rk_trace_record *record) {
+  uint32_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+  uint32_t tail = atomic_load_explicit(&trace->tail, memory_order_acquire);
+
+  if (head - tail >= trace->record_count) {
+    trace->dropped++;
+    return;
+  }
+
+  trace->records[head & (trace->record_count - 1)] = *record;
+
+  // Publish record:
+  atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+static void ready_push(struct rk_ready_queue *q, struct rk_node *node) {
+  node->ctx.ll_ready = 0;
+  if (q->tail == 0) {
+    q->head = node;
+  } else {
+    q->tail->ctx.ll_ready = node;
+  }
+  q->tail = node;
+}
+
+static struct rk_node *ready_pop(struct rk_ready_queue *q) {
+  struct rk_node *node = q->head;
+  if (node != 0) {
+    q->head = node->ctx.ll_ready;
+    if (q->head == 0) q->tail = 0;
+  }
+  return node;
+}
+
+// Check if 'dependant' is part of the current request and has to wait for 'node' to settle.
+static inline bool waits_for(struct rk_graph *pt, struct rk_node *node, struct rk_node *dependant) {
+  return in_traversal(pt, dependant) && dependant->desired_state == node->desired_state;
+}
+
+// Mark a node of the current request as settled, and release or cancel all nodes waiting for it.
+static void settle_node(struct rk_graph *pt, struct rk_ready_queue *q, struct rk_node *node, int err) {
+  pt->req_remaining--;
+
+  // Nodes waiting for an enabled node are its children, nodes waiting for a disabled node its parents:
+  struct rk_node **dependants = node->desired_state ? node->children : node->parents;
+  size_t dependant_count = node->desired_state ? node->child_count : node->parent_count;
+
+  if (!err) {
+    for (size_t i = 0; i < dependant_count; i++) {
+      struct rk_node *dependant = dependants[i];
+      if (!waits_for(pt, node, dependant)) continue;
+
+      dependant->ctx.trv_pending--;
+      if (dependant->ctx.trv_pending == 0 && !dependant->ctx.trv_cancelled) {
+        ready_push(q, dependant);
+      }
+    }
+    return;
+  }
+
+  if (pt->req_err == 0) {
+    pt->req_err = err;
+  }
+
+  // Cancel all nodes (transitively) waiting for the failed node. The ready link is used
+  // as a stack of cancelled nodes whose dependants have not yet been cancelled:
+  struct rk_node *stack = node;
+  node->ctx.ll_ready = 0;
+
+  while (stack != 0) {
+    struct rk_node *current = stack;
+    stack = current->ctx.ll_ready;
+
+    dependants = current->desired_state ? current->children : current->parents;
+    dependant_count = current->desired_state ? current->child_count : current->parent_count;
+
+    for (size_t i = 0; i < dependant_count; i++) {
+      struct rk_node *dependant = dependants[i];
+      if (!waits_for(pt, current, dependant) || dependant->ctx.trv_cancelled) continue;
+
+      RK_LOG_INF("%s: Update cancelled.", dependant->name);
+      dependant->ctx.trv_cancelled = true;
+      pt->req_remaining--;
+      dependant->ctx.ll_ready = stack;
+      stack = dependant;
+    }
+  }
+}
+
+// Start the updates of all ready nodes of the current request.
+// Returns RK_PENDING if the request has not completed, 0 if it completed successfully, or
+// the first error encountered.
+static int run_request(struct rk_graph *pt, struct rk_ready_queue *q) {
+  struct rk_node *node;
+
+  while ((node = ready_pop(q)) != 0) {
+    // A faulted node fails without calling its callback:
+    if (node->desired_state && check_fault(node) != 0) {
+      settle_node(pt, q, node, RK_ERR);
+      continue;
+    }
+
+    int err = start_update(pt, node, node->desired_state, true);
+
+    if (err == RK_PENDING) {
+      node->ctx.trv_inflight = true;
     } else {
-      node->state = new_state;
+      settle_node(pt, q, node, finish_update(pt, node, err));
+    }
+  }
+
+  if (pt->req_remaining != 0) return RK_PENDING;
+
+  // Request completed. Enable all clients (unless they are also being disabled):
+  for (size_t i = 0; i < pt->req_enable_count; i++) {
+    struct rk_client *client = pt->req_enable_list[i];
+    if (client->trv_epoch == pt->trv_epoch) continue;
+    if (pt->req_err == 0) {
+      set_client_state(client, true);
+    } else {
+      // Nodes enabled for this client may be left enabled without an active dependant:
+      mark_client_dirty(pt, client);
+    }
+  }
+
+  trace_request(pt, RK_TRACE_APPLY, pt->req_trace_start, pt->req_err);
+
+  pt->req_enable_list = 0;
+  pt->req_enable_count = 0;
+
+  return pt->req_err;
+}
+
+// Change the state of a node, keeping the dependant counters of its parents up to date.
+static void set_node_state(struct rk_node *node, bool state) {
+  if (node->state == state) return;
+  node->state = state;
+
+  for (size_t i = 0; i < node->parent_count; i++) {
+    if (state) {
+      node->parents[i]->ctx.active_dependants++;
+    } else {
+      node->parents[i]->ctx.active_dependants--;
+    }
+  }
+}
+
+// Change the state of a client, keeping the dependant counters of its parents up to date.
+static void set_client_state(struct rk_client *client, bool enabled) {
+  if (client->enabled == enabled) return;
+  client->enabled = enabled;
+
+  for (size_t i = 0; i < client->parent_count; i++) {
+    if (enabled) {
+      client->parents[i]->ctx.active_dependants++;
+    } else {
+      client->parents[i]->ctx.active_dependants--;
     }
-  } else {
-    // Update cannot fail if there is no update.
-    node->state = new_state;
   }
+}
+
+// (Re-)calculate the dependant counters of all nodes from the current node and client states.
+static int count_active_dependants(struct rk_graph *pt) {
+  for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+    struct rk_node *node = pt->nodes[node_idx];
+
+    if (node_contains_nullptr(node)) {
+      RK_LOG_ERR("Node %zd contains a null pointer.", node_idx);
+      return RK_ERR;
+    }
 
+    node->ctx.active_dependants = 0;
+    for (size_t i = 0; i < node->child_count; i++) {
+      if (node->children[i]->state) {
+        node->ctx.active_dependants++;
+      }
+    }
+    for (size_t i = 0; i < node->client_count; i++) {
+      if (node->clients[i]->enabled) {
+        node->ctx.active_dependants++;
+      }
+    }
+  }
   return 0;
 }
 
 // Check if a given node has any direct children or clients that are active.
-static bool has_active_dependant(struct rk_node *node) {
-  for (size_t i = 0; i < node->child_count; i++) {
-    if (node->children[i]->state) {
-      return true;
+static bool has_active_dependant(struct rk_graph *pt, struct rk_node *node) {
+  RK_COUNT(pt, dependant_evals, 1);
+  return node->ctx.active_dependants != 0;
+}
+
+// Check if the edges of a node of a graph can be modified without calling rk_init() again.
+static bool graph_is_modifiable(struct rk_graph *pt, struct rk_node *node) {
+  if (node == 0) return false;
+  if (graph_is_busy(pt)) return false;
+
+  if (pt->ll_topo_tail == 0) {
+    RK_LOG_ERR("Cannot modify edges of node '%s': Graph has not been initialized.", node->name);
+    return false;
+  }
+
+  if (node != pt->root && node->parent_count == 0) {
+    RK_LOG_ERR("Cannot modify edges of node '%s': Node is not part of the graph.", node->name);
+    return false;
+  }
+
+  return true;
+}
+
+// Mark the derived indices of a graph (compiled layout, enable plans, impact index, bitsets and shards) as out of
+// date after its edges were modified. They are rebuilt by the next request, except for shards: Requests of a
+// sharded graph may run concurrently, so its indices are rebuilt before the modification returns.
+static int invalidate_indices(struct rk_graph *pt) {
+  if (pt->csr == 0 && pt->plans == 0 && pt->impact == 0 && pt->bitset == 0 && pt->shards == 0) return 0;
+
+  pt->indices_stale = true;
+  return pt->shards != 0 ? rebuild_indices(pt) : 0;
+}
+
+// Rebuild the derived indices of a graph before a request, if its edges were modified since they were built.
+static int refresh_indices(struct rk_graph *pt) {
+  if (!pt->indices_stale) return 0;
+
+  if (pt->shards != 0) {
+    RK_LOG_ERR("Cannot process request: Shards could not be rebuilt after a modification (%zd nodes). Must call "
+               "rk_init().",
+               pt->node_count);
+    return RK_ERR;
+  }
+
+  return rebuild_indices(pt);
+}
+
+// Rebuild all derived indices of a graph, as rk_init() does, without changing its topological order or any
+// node or client state. Indices are addressed by rank, so all nodes are ranked consecutively first.
+static int rebuild_indices(struct rk_graph *pt) {
+  uint32_t rank = 0;
+  for (struct rk_node *node = pt->root; node != 0; node = node->ctx.ll_topo_next) {
+    node->ctx.topo_rank = rank;
+    rank++;
+  }
+
+  // Nodes may move to a different shard, and with it to a different "dirty" list:
+  struct rk_node *dirty = take_dirty(pt);
+  if (pt->shards != 0) {
+    pt->shards->shard_count = 0;
+    pt->shards->shard = 0;
+  }
+
+  int err = pt->csr != 0 ? compile_csr(pt) : 0;
+  if (!err) err = build_plans(pt);
+  if (!err && pt->impact != 0) err = build_impact(pt);
+  if (!err && pt->bitset != 0) err = build_bitset(pt);
+  if (!err && pt->shards != 0) err = build_shards(pt);
+
+  while (dirty != 0) {
+    struct rk_node *node = dirty;
+    dirty = node->ctx.ll_dirty;
+    node->ctx.dirty = false;
+    mark_dirty(pt, node);
+  }
+
+  if (err) return err;
+
+  pt->indices_stale = false;
+  return 0;
+}
+
+// Remove all nodes from the "dirty" lists of a graph and all its shards, and return them as a single list. The
+// nodes remain marked as dirty.
+static struct rk_node *take_dirty(struct rk_graph *pt) {
+  struct rk_node *list = pt->ll_dirty_head;
+  pt->ll_dirty_head = 0;
+
+  for (size_t i = 0; pt->shards != 0 && i < pt->shards->shard_count; i++) {
+    struct rk_shard *shard = &pt->shards->shard[i];
+    while (shard->ll_dirty_head != 0) {
+      struct rk_node *node = shard->ll_dirty_head;
+      shard->ll_dirty_head = node->ctx.ll_dirty;
+      node->ctx.ll_dirty = list;
+      list = node;
     }
   }
-  for (size_t i = 0; i < node->client_count; i++) {
-    if (node->clients[i]->enabled) {
-      return true;
+
+  return list;
+}
+
+// Check that adding an edge from node to child, where child is ranked before node, does not create a
+// cycle. Collects all nodes reachable from child that are ranked before node into the "traverse" list
+// of a new traversal, each pointing to the node it was reached from.
+static int check_new_edge(struct rk_graph *pt, struct rk_node *node, struct rk_node *child) {
+  start_traversal(pt);
+  mark_traversed(pt, child);
+  child->ctx.ll_reorder = 0;
+  struct rk_node *trv_tail = child;
+  size_t visits = 0;
+
+  for (struct rk_node *current = child; current != 0; current = current->ctx.ll_trv) {
+    visits++;
+
+    if (current == node) {
+      RK_COUNT(pt, flood_visits, visits);
+
+      // Reverse the path from node back to child, so that every node points to its successor:
+      struct rk_node *successor = 0;
+      for (struct rk_node *hop = node; hop != 0;) {
+        struct rk_node *predecessor = hop->ctx.ll_reorder;
+        hop->ctx.ll_reorder = successor;
+        successor = hop;
+        hop = predecessor;
+      }
+
+      RK_LOG_ERR("Cannot add node '%s' as a child of node '%s': Graph would contain a cycle:", child->name,
+                 node->name);
+      RK_LOG_ERR("  '%s' -> '%s'", node->name, child->name);
+      for (struct rk_node *hop = child; hop != node; hop = hop->ctx.ll_reorder) {
+        RK_LOG_ERR("  '%s' -> '%s'", hop->name, hop->ctx.ll_reorder->name);
+      }
+      return RK_ERR;
+    }
+
+    for (size_t i = 0; i < current->child_count; i++) {
+      struct rk_node *next = current->children[i];
+      if (next == 0) return RK_ERR;
+      if (next->ctx.topo_rank > node->ctx.topo_rank || in_traversal(pt, next)) continue;
+      mark_traversed(pt, next);
+      next->ctx.ll_reorder = current;
+      trv_tail->ctx.ll_trv = next;
+      trv_tail = next;
+    }
+  }
+
+  RK_COUNT(pt, flood_visits, visits);
+  return 0;
+}
+
+// Restore the topological order after adding an edge from node to child, where child was ranked
+// before node (Pearce-Kelly): All nodes that node depends on and that are ranked after child (the
+// "backward" set) are moved in front of all nodes that depend on child and are ranked before node (the
+// "forward" set, as collected by check_new_edge()). Both sets take over the ranks previously occupied
+// by either, keeping their relative order. All other nodes are not touched.
+static void reorder_topo(struct rk_graph *pt, struct rk_node *node, struct rk_node *child) {
+  // The forward set was collected by check_new_edge(), and its epoch distinguishes it from the backward set:
+  struct rk_node *fwd_head = child;
+  struct rk_node *fwd_tail = child;
+  while (fwd_tail->ctx.ll_trv != 0) {
+    fwd_tail = fwd_tail->ctx.ll_trv;
+  }
+
+  start_traversal(pt);
+  mark_traversed(pt, node);
+  struct rk_node *bwd_tail = node;
+  size_t visits = 0;
+
+  for (struct rk_node *current = node; current != 0; current = current->ctx.ll_trv) {
+    visits++;
+    for (size_t i = 0; i < current->parent_count; i++) {
+      struct rk_node *parent = current->parents[i];
+      if (parent->ctx.topo_rank < child->ctx.topo_rank || in_traversal(pt, parent)) continue;
+      mark_traversed(pt, parent);
+      bwd_tail->ctx.ll_trv = parent;
+      bwd_tail = parent;
+    }
+  }
+  RK_COUNT(pt, flood_visits, visits);
+
+  // Merge both sets into a single list of all affected ranks ("slots"):
+  fwd_tail->ctx.ll_trv = node;
+  struct rk_node *slots = sort_traversal(fwd_head, false);
+
+  // Remember the node in front of every slot, and remove all nodes from the topological list:
+  for (struct rk_node *slot = slots; slot != 0; slot = slot->ctx.ll_trv) {
+    slot->ctx.ll_reorder = slot->ctx.ll_topo_prev;
+  }
+  for (struct rk_node *slot = slots; slot != 0; slot = slot->ctx.ll_trv) {
+    unlink_topo(pt, slot);
+  }
+
+  // Fill all slots in order, first with the backward and then with the forward set. Every slot directly
+  // follows the previous slot, or a node that was not moved:
+  struct rk_node *prev_slot = 0;
+  struct rk_node *prev_node = 0;
+  bool backward = true;
+  struct rk_node *next = next_in_group(pt, slots, backward);
+
+  for (struct rk_node *slot = slots; slot != 0; slot = slot->ctx.ll_trv) {
+    if (next == 0) {
+      backward = false;
+      next = next_in_group(pt, slots, backward);
+    }
+
+    struct rk_node *after = slot->ctx.ll_reorder == prev_slot ? prev_node : slot->ctx.ll_reorder;
+    struct rk_node *moved = next;
+    next = next_in_group(pt, next->ctx.ll_trv, backward);
+
+    moved->ctx.ll_topo_prev = after;
+    moved->ctx.ll_topo_next = after->ctx.ll_topo_next;
+    if (after->ctx.ll_topo_next != 0) {
+      after->ctx.ll_topo_next->ctx.ll_topo_prev = moved;
+    } else {
+      pt->ll_topo_tail = moved;
     }
+    after->ctx.ll_topo_next = moved;
+    moved->ctx.topo_rank = after->ctx.topo_rank + 1;
+
+    prev_slot = slot;
+    prev_node = moved;
+  }
+}
+
+// Check if a node has a given child.
+static bool has_child_edge(struct rk_node *node, struct rk_node *child) {
+  for (size_t i = 0; i < node->child_count; i++) {
+    if (node->children[i] == child) return true;
+  }
+  return false;
+}
+
+// Check if a node has a given client.
+static bool has_client_edge(struct rk_node *node, struct rk_client *client) {
+  for (size_t i = 0; i < node->client_count; i++) {
+    if (node->clients[i] == client) return true;
   }
   return false;
 }
+
+// Find the first node of the backward or forward set of a reordering, starting at the given node.
+static struct rk_node *next_in_group(struct rk_graph *pt, struct rk_node *node, bool backward) {
+  while (node != 0 && in_traversal(pt, node) != backward) {
+    node = node->ctx.ll_trv;
+  }
+  return node;
+}
+
+// Append a node to the end of the topological list.
+static void append_topo(struct rk_graph *pt, struct rk_node *node) {
+  node->ctx.ll_topo_prev = pt->ll_topo_tail;
+  node->ctx.ll_topo_next = 0;
+  pt->ll_topo_tail->ctx.ll_topo_next = node;
+  node->ctx.topo_rank = pt->ll_topo_tail->ctx.topo_rank + 1;
+  pt->ll_topo_tail = node;
+}
+
+// Remove a node from the topological list. The root is never removed.
+static void unlink_topo(struct rk_graph *pt, struct rk_node *node) {
+  node->ctx.ll_topo_prev->ctx.ll_topo_next = node->ctx.ll_topo_next;
+  if (node->ctx.ll_topo_next != 0) {
+    node->ctx.ll_topo_next->ctx.ll_topo_prev = node->ctx.ll_topo_prev;
+  } else {
+    pt->ll_topo_tail = node->ctx.ll_topo_prev;
+  }
+  node->ctx.ll_topo_prev = 0;
+  node->ctx.ll_topo_next = 0;
+}
+
+// Remove all parallel edges, and all edges to a node or client from a parent that is also a (direct
+// or indirect) parent of one of its other parents. The graph must be acyclic.
+static int simplify_graph(struct rk_graph *pt) {
+  for (size_t node_idx = 0; node_idx < pt->node_count; node_idx++) {
+    struct rk_node *node = pt->nodes[node_idx];
+
+    int err = mark_redundant_parents(pt, node->parents, node->parent_count);
+    if (err) return err;
+
+    // Duplicates of a parent are marked once the parent itself has been kept:
+    for (uint32_t i = 0; i < node->parent_count;) {
+      struct rk_node *parent = node->parents[i];
+      if (in_traversal(pt, parent)) {
+        remove_child_edge(parent, node);
+        pt->edges_removed++;
+      } else {
+        mark_traversed(pt, parent);
+        i++;
+      }
+    }
+
+    for (size_t client_idx = 0; client_idx < node->client_count;) {
+      struct rk_client *client = node->clients[client_idx];
+
+      // Clients are only reachable through their parents. Only simplify every client through its first parent:
+      if (client->parents[0] != node) {
+        client_idx++;
+        continue;
+      }
+
+      err = mark_redundant_parents(pt, client->parents, client->parent_count);
+      if (err) return err;
+
+      bool shifted = false;
+      for (uint32_t i = 0; i < client->parent_count;) {
+        struct rk_node *parent = client->parents[i];
+        if (in_traversal(pt, parent)) {
+          shifted |= parent == node;
+          remove_client_edge(parent, client);
+          pt->edges_removed++;
+        } else {
+          mark_traversed(pt, parent);
+          i++;
+        }
+      }
+
+      // Removing the client from this node shifts the node's client list. The current entry is then revisited:
+      if (!shifted) client_idx++;
+    }
+  }
+
+  if (pt->edges_removed != 0) {
+    RK_LOG_INF("Removed %u redundant edges.", (unsigned int)pt->edges_removed);
+  }
+
+  return 0;
+}
+
+// Start a new traversal containing all (direct and indirect) parents of the given parents, but not the
+// parents themselves, unless they are parents of one of the other parents.
+static int mark_redundant_parents(struct rk_graph *pt, struct rk_node **parents, uint32_t parent_count) {
+  start_traversal(pt);
+  struct rk_node *trv_head = 0;
+  struct rk_node *trv_tail = 0;
+
+  for (uint32_t i = 0; i < parent_count; i++) {
+    struct rk_node *parent = parents[i];
+    if (parent == 0) return RK_ERR;
+    for (uint32_t j = 0; j < parent->parent_count; j++) {
+      if (parent->parents[j] == 0) return RK_ERR;
+      append_traversed(pt, &trv_head, &trv_tail, parent->parents[j]);
+    }
+  }
+
+  if (trv_head == 0) return 0;
+  return flood_ancestors(pt, trv_head, trv_tail);
+}
+
+// Remove one edge between a node and one of its children, preserving the order of all other edges.
+static void remove_child_edge(struct rk_node *node, struct rk_node *child) {
+  for (uint32_t i = 0; i < node->child_count; i++) {
+    if (node->children[i] != child) continue;
+    memmove(&node->children[i], &node->children[i + 1], (node->child_count - i - 1) * sizeof(node->children[0]));
+    node->child_count--;
+    break;
+  }
+
+  for (uint32_t i = 0; i < child->parent_count; i++) {
+    if (child->parents[i] != node) continue;
+    memmove(&child->parents[i], &child->parents[i + 1], (child->parent_count - i - 1) * sizeof(child->parents[0]));
+    child->parent_count--;
+    break;
+  }
+}
+
+// Remove one edge between a node and one of its clients, preserving the order of all other edges.
+static void remove_client_edge(struct rk_node *node, struct rk_client *client) {
+  for (uint32_t i = 0; i < node->client_count; i++) {
+    if (node->clients[i] != client) continue;
+    memmove(&node->clients[i], &node->clients[i + 1], (node->client_count - i - 1) * sizeof(node->clients[0]));
+    node->client_count--;
+    break;
+  }
+
+  for (uint32_t i = 0; i < client->parent_count; i++) {
+    if (client->parents[i] != node) continue;
+    memmove(&client->parents[i], &client->parents[i + 1],
+            (client->parent_count - i - 1) * sizeof(client->parents[0]));
+    client->parent_count--;
+    break;
+  }
+}
+
+// Ensure that an adjacency array has room for at least one more element, growing it using the
+// arena if required. Growing an array doubles its length. If the array is the most recent
+// allocation of the arena, it is extended in place, otherwise it is copied. Arrays provided by
+// the user have a capacity of zero, and are always copied.
+// Returns the (possibly moved) array, or 0 if it cannot be grown.
+static void *grow_array(struct rk_arena *arena, void *array, uint32_t count, uint32_t *capacity, size_t elem_size) {
+  if (count < *capacity) return array;
+  if (arena->buf == 0) return 0;
+
+  uint32_t new_capacity = count == 0 ? 1 : count * 2;
+  uintptr_t arena_start = (uintptr_t)arena->buf;
+  uintptr_t arena_top = arena_start + arena->used;
+  size_t remaining = arena->size - arena->used;
+
+  // Extend in place:
+  uintptr_t array_start = (uintptr_t)array;
+  if (*capacity != 0 && array_start >= arena_start && array_start + (size_t)*capacity * elem_size == arena_top) {
+    size_t extension = (size_t)(new_capacity - *capacity) * elem_size;
+    if (extension <= remaining) {
+      arena->used += extension;
+      *capacity = new_capacity;
+      return array;
+    }
+  }
+
+  // Allocate new array:
+  size_t size = (size_t)new_capacity * elem_size;
+  if (size > remaining) return 0;
+
+  uint8_t *new_array = (uint8_t *)arena->buf + arena->used;
+  arena->used += size;
+  if (count != 0) {
+    memcpy(new_array, array, (size_t)count * elem_size);
+  }
+  *capacity = new_capacity;
+
+  return new_array;
+}
+
+// Get the index of the histogram bucket a value is recorded in. Values below 2^(RK_HIST_SUB_BITS+1) each
+// have their own bucket. Larger values are shifted right until they are in that range, and every shift
+// selects the next set of 2^RK_HIST_SUB_BITS buckets.
+static uint32_t hist_bucket(uint32_t value) {
+  uint32_t shift = 0;
+  while ((value >> shift) >= (2u << RK_HIST_SUB_BITS)) {
+    shift++;
+  }
+  return (shift << RK_HIST_SUB_BITS) + (value >> shift);
+}
+
+// Get the largest value that is recorded in a histogram bucket.
+static uint32_t hist_bucket_max(uint32_t bucket) {
+  if (bucket < (2u << RK_HIST_SUB_BITS)) return bucket;
+
+  uint32_t shift = (bucket >> RK_HIST_SUB_BITS) - 1;
+  uint64_t min = (uint64_t)(bucket & ((1u << RK_HIST_SUB_BITS) - 1)) | (1u << RK_HIST_SUB_BITS);
+  return (uint32_t)(((min + 1) << shift) - 1);
+}
@@ -7,6 +7,8 @@
 #ifndef RESOURCE_KHAN_H_
 #define RESOURCE_KHAN_H_
 
+#include <limits.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -20,12 +22,6 @@
 /** @brief Maximum length of node/client name  */
 #define RK_MAX_NAME_LEN 15
 
-/** @brief Maximum number of parent nodes per node or client */
-#define RK_MAX_PARENTS  4
-
-/** @brief Maximum number of children nodes and clients per node */
-#define RK_MAX_CHILDREN 4
-
 /**
  * @brief Return value indicating a function did not complete succesfully
  * @note Must be an 'int' value that is not '0'
@@ -50,6 +46,333 @@
 
 #endif /* RK_USE_CUSTOM_CONF */
 
+#ifndef RK_PENDING
+/**
+ * @brief Callback return value indicating that an update was started, but completes asynchronously.
+ * @note Must be an 'int' value that is neither '0' nor RK_ERR, and that is never used as an error code
+ *       by any node callback. Defaults to INT_MIN, which is outside the range of both positive and
+ *       negative errno-style codes.
+ */
+#define RK_PENDING INT_MIN
+#endif /* RK_PENDING */
+
+_Static_assert(RK_PENDING != 0 && RK_PENDING != RK_ERR, "RK_PENDING must differ from both 0 and RK_ERR");
+
+#ifndef RK_DEFAULT_ARENA_SIZE
+/**
+ * @brief Size of the default arena in bytes.
+ * Adjacency arrays of edges added by rk_node_add_child() and rk_node_add_client() (or any function
+ * that is passed a null arena) are allocated from this statically allocated arena. May be 0, in which
+ * case an arena must be provided to add edges at runtime. See rk_arena.
+ * @warning The default arena is a single global arena, shared by all graphs for the lifetime of the program,
+ *          and is not thread-safe: Edges must not be added to different graphs concurrently while using it.
+ *          Its memory is only returned by rk_default_arena_reset(). Use rk_graph.arena or an explicit arena
+ *          to give every graph its own memory.
+ */
+#define RK_DEFAULT_ARENA_SIZE 8192
+#endif /* RK_DEFAULT_ARENA_SIZE */
+
+#ifndef RK_HIST_SUB_BITS
+/**
+ * @brief Resolution of latency histograms.
+ * Every power-of-two range of values is split into 2^RK_HIST_SUB_BITS buckets, bounding the relative
+ * error of percentiles to 2^-RK_HIST_SUB_BITS.
+ */
+#define RK_HIST_SUB_BITS 3
+#endif /* RK_HIST_SUB_BITS */
+
+/** @brief Number of buckets per latency histogram. */
+#define RK_HIST_BUCKETS ((33 - RK_HIST_SUB_BITS) << RK_HIST_SUB_BITS)
+
+/**
+ * @brief Memory arena for adjacency arrays.
+ * Nodes and clients do not store their parents, children and clients inline. Instead, adjacency arrays
+ * are allocated from an arena as edges are added, so that memory only scales with the number of edges that
+ * actually exist. An arena may be passed to rk_node_add_child_arena() or rk_node_add_client_arena(), while
+ * rk_node_add_child() and rk_node_add_client() use a default arena of RK_DEFAULT_ARENA_SIZE bytes.
+ * Memory is never returned to an arena, unless it is reset by the user (see rk_default_arena_reset()).
+ * An arena is not thread-safe.
+ *
+ * Alternatively, the adjacency arrays of a node or client may be statically initialized to arrays provided
+ * by the user. These are treated as full, and are copied into an arena if more edges are added.
+ */
+struct rk_arena {
+  /** @brief Memory of the arena. Must be suitably aligned to store pointers. */
+  void *buf;
+
+  /** @brief Size of buf in bytes. */
+  size_t size;
+
+  /** @brief Number of bytes of buf that are in use. Initialize to zero. */
+  size_t used;
+};
+
+/**
+ * @brief Compiled graph layout.
+ * If provided, rk_init() compiles the graph into a compressed sparse row layout stored in a user-provided
+ * buffer: All nodes are numbered in topological order, and the parents of every node are stored as a
+ * contiguous range of node indices (16-bit indices, or 32-bit indices for graphs with more than 65535
+ * nodes or edges). All traversals then operate on these compact arrays instead of following the parent
+ * pointers scattered across all nodes.
+ * @note Requests for clients of a shard do not use the compiled layout (see rk_shards).
+ */
+struct rk_csr {
+  /** @brief Buffer to store the compiled graph in. Must be suitably aligned to store pointers. */
+  void *buf;
+
+  /** @brief Size of buf in bytes. See rk_csr_size(). */
+  size_t buf_size;
+
+  // Compiled graph. Written by rk_init().
+  bool wide;              // Indices are 32 bits wide (16 bits otherwise).
+  struct rk_node **order; // All nodes, by index (= topological rank).
+  uint32_t *trv_epoch;    // Node is part of the current traversal if this matches the graph's trv_epoch.
+  void *parent_offsets;   // parents[parent_offsets[i]] to parents[parent_offsets[i+1]-1] are node i's parents.
+  void *parents;          // Indices of the parents of all nodes.
+  void *trv_heap;         // Heap of nodes discovered during a traversal.
+};
+
+/** @brief Trace record types. */
+enum rk_trace_type {
+  RK_TRACE_UPDATE = 0,  //!< Update of a single node.
+  RK_TRACE_REQUEST = 1, //!< Request, such as a call to rk_enable_client().
+};
+
+/** @brief Request kinds, as recorded in trace records of type RK_TRACE_REQUEST. */
+enum rk_trace_request {
+  RK_TRACE_ENABLE = 0,         //!< rk_enable_client()
+  RK_TRACE_ENABLE_ATOMIC = 1,  //!< rk_enable_client_atomic()
+  RK_TRACE_DISABLE = 2,        //!< rk_disable_client()
+  RK_TRACE_APPLY = 3,          //!< rk_apply()
+  RK_TRACE_OPTIMIZE = 4,       //!< rk_optimize()
+  RK_TRACE_OPTIMIZE_DIRTY = 5, //!< rk_optimize_dirty()
+  RK_TRACE_FAULT = 6,          //!< rk_node_fault()
+  RK_TRACE_RECOVER = 7,        //!< rk_node_recover()
+};
+
+/**
+ * @brief A trace record, describing a single node update or request.
+ * Records are 20 bytes long and contain no padding, so that they can be copied out of the trace
+ * buffer verbatim and decoded later (see scripts/decode_trace.py and rk_exporttrace_cb()).
+ */
+struct rk_trace_record {
+  uint32_t timestamp; //!< Time at which the update/request started.
+  uint32_t duration;  //!< Time between the start and end (including asynchronous completion).
+  uint32_t node;      //!< Index of the node in the graph's node array, or request kind (enum rk_trace_request).
+  int32_t cb_return;  //!< Return value of the node's callback (0 if it has none), or of the request.
+  uint8_t old_state;  //!< State of the node before the update. 0 for requests.
+  uint8_t new_state;  //!< State of the node after the update. 0 for requests.
+  uint16_t type;      //!< Record type (enum rk_trace_type).
+};
+
+/**
+ * @brief Precomputed enable plans.
+ * If provided, rk_init() precomputes the "enable plan" of every client: The nodes that have to be updated to enable
+ * the client, in the order they are updated (for every parent of the client, the parent and all its direct and
+ * indirect parents in topological order). rk_enable_client() and rk_enable_client_atomic() then walk this
+ * array instead of discovering these nodes by flooding the graph from the client's parents.
+ * @note Requests for clients of a shard do not use enable plans (see rk_shards).
+ */
+struct rk_plans {
+  /** @brief Buffer to store the plans in. Must be suitably aligned to store pointers. */
+  void *buf;
+
+  /** @brief Size of buf in bytes. See rk_plans_size(). */
+  size_t buf_size;
+};
+
+/**
+ * @brief Impact index.
+ * If provided, rk_init() precomputes the "impact" of every node: All clients that depend on the node, directly or
+ * through any of its (direct and indirect) children. rk_node_impact() then returns this list without traversing
+ * the graph, for example to determine which clients lose service when a node faults.
+ */
+struct rk_impact {
+  /** @brief Buffer to store the impact lists in. Must be suitably aligned to store pointers. */
+  void *buf;
+
+  /** @brief Size of buf in bytes. See rk_impact_size(). */
+  size_t buf_size;
+};
+
+/** @brief Index of the root lock of a sharded graph. See rk_shards. */
+#define RK_SHARD_ROOT UINT32_MAX
+
+struct rk_graph;
+
+/** @brief A connected component of a sharded graph. See rk_shards. */
+struct rk_shard {
+  struct rk_node *ll_topo_head;  // First node of this shard in topological order.
+  uint32_t node_count;           // Number of nodes in this shard.
+  uint32_t trv_epoch;            // Epoch of the current traversal of this shard.
+  struct rk_node *ll_dirty_head; // Nodes of this shard that may be in a non-optimal state.
+};
+
+/**
+ * @brief Independent components.
+ * If provided, rk_init() splits the graph without its root into connected components ("shards"), which share no
+ * nodes and no clients, and links the nodes of every shard into a separate topological list. Every shard is
+ * protected by its own lock, and the root by a separate root lock (RK_SHARD_ROOT). rk_enable_client(),
+ * rk_enable_client_atomic() and rk_disable_client() then only take the lock of the client's shard (see
+ * rk_client_shard()), and may be called concurrently for clients of different shards. The root lock is only taken
+ * while the root is updated, or while the state of a node or client that depends on the root changes. Callbacks of
+ * all other nodes are called while only holding the lock of their shard. Clients that only depend on the root are
+ * not part of any shard, and their requests are serialized by the root lock.
+ *
+ * All other functions operating on the graph are not sharded, and must not be called concurrently to any other
+ * function operating on the graph. Sharded graphs cannot be traced and do not support bitsets.
+ * @note Requests for clients of a shard always traverse the shard's topological list: The compiled layout (rk_csr)
+ * and enable plans (rk_plans) are shared by all shards, and are only used for clients that only depend on the root.
+ */
+struct rk_shards {
+  /** @brief Buffer to store the shards in. Must be suitably aligned to store pointers. */
+  void *buf;
+
+  /** @brief Size of buf in bytes. See rk_shards_size(). */
+  size_t buf_size;
+
+  /**
+   * @brief Lock callback. Provided by user.
+   * @param graph this graph.
+   * @param shard index of the shard to lock, or RK_SHARD_ROOT to lock the root.
+   */
+  void (*cb_lock)(struct rk_graph *graph, uint32_t shard);
+
+  /**
+   * @brief Unlock callback. Provided by user.
+   * @param graph this graph.
+   * @param shard index of the shard to unlock, or RK_SHARD_ROOT to unlock the root.
+   */
+  void (*cb_unlock)(struct rk_graph *graph, uint32_t shard);
+
+  /** @brief User data for use by the lock callbacks. */
+  void *lock_ctx;
+
+  // Shards. Written by rk_init().
+  size_t shard_count;     // Number of shards.
+  struct rk_shard *shard; // All shards.
+};
+
+/**
+ * @brief Bitset graph state.
+ * If provided, rk_init() represents the state of all nodes, and the set of (direct and indirect) parents of every
+ * client, as bitsets stored in a user-provided buffer, with one bit per node in topological order. rk_optimize() then
+ * determines the nodes required by all enabled clients by OR-ing their bitsets, and finds all nodes that may have
+ * to change state by XOR-ing the result with the current node states, instead of visiting every node.
+ */
+struct rk_bitset {
+  /** @brief Buffer to store the bitsets in. Must be suitably aligned to store 64-bit words and pointers. */
+  void *buf;
+
+  /** @brief Size of buf in bytes. See rk_bitset_size(). */
+  size_t buf_size;
+
+  // Bitsets. Written by rk_init().
+  size_t word_count;          // Number of 64-bit words per bitset.
+  size_t client_count;        // Number of clients in the graph.
+  uint64_t *state;            // State of every node, by topological rank.
+  uint64_t *required;         // Nodes required by all enabled clients.
+  uint64_t *closures;         // All parents of every client (word_count words per client).
+  struct rk_node **order;     // All nodes, by topological rank.
+  struct rk_client **clients; // All clients.
+};
+
+/**
+ * @brief Event trace buffer.
+ * If provided, every node update that calls a node's callback or changes the node's state is recorded into this
+ * ring buffer, instead of logging the transition using RK_LOG_INF. Every request (enable, disable, apply or
+ * optimize) that passed argument validation is recorded once it has completed.
+ *
+ * The buffer is single-producer/single-consumer and lock-free: Records can be read using rk_trace_read() while
+ * the graph is being updated, for example from a different thread. If the buffer is full, new records are dropped.
+ */
+struct rk_trace {
+  /** @brief Buffer to store records in. Provided by user. */
+  struct rk_trace_record *records;
+
+  /** @brief Length of the records buffer. Must be a power of two. */
+  uint32_t record_count;
+
+  /** @brief Timestamp source. Provided by user. Timestamps may wrap around. */
+  uint32_t (*cb_timestamp)(void);
+
+  /** @brief Number of records that were dropped because the buffer was full. */
+  uint32_t dropped;
+
+  /** @brief Scratch data used by implementation. Initialize to zero. */
+  atomic_uint_least32_t head;
+
+  /** @brief Scratch data used by implementation. Initialize to zero. */
+  atomic_uint_least32_t tail;
+};
+
+/**
+ * @brief Work counters.
+ * If provided, counts the work performed by all requests, to compare the number of nodes traversed and callbacks
+ * invoked to the number of transitions they caused.
+ *
+ * All counters are updated atomically, and may be read (see rk_stats_read()) and reset (see rk_stats_reset()) while
+ * the graph is being updated, for example from a different thread. Counters wrap around.
+ */
+struct rk_stats {
+  /** @brief Number of requests (enable, disable, apply or optimize) that passed argument validation. */
+  atomic_uint_least32_t requests;
+
+  /** @brief Number of nodes visited while flooding from a node/client to the root. */
+  atomic_uint_least32_t flood_visits;
+
+  /** @brief Number of nodes visited while walking the graph in (reverse-)topological order. */
+  atomic_uint_least32_t topo_visits;
+
+  /** @brief Number of evaluations of whether a node has an active dependant. */
+  atomic_uint_least32_t dependant_evals;
+
+  /** @brief Number of node callbacks invoked. */
+  atomic_uint_least32_t cb_calls;
+
+  /** @brief Number of node callbacks invoked that changed the node's state. */
+  atomic_uint_least32_t cb_transitions;
+
+  /** @brief Number of node callbacks invoked that failed. */
+  atomic_uint_least32_t cb_failures;
+};
+
+/** @brief A snapshot of a graph's work counters. See struct rk_stats. */
+struct rk_stats_snapshot {
+  uint32_t requests;
+  uint32_t flood_visits;
+  uint32_t topo_visits;
+  uint32_t dependant_evals;
+  uint32_t cb_calls;
+  uint32_t cb_transitions;
+  uint32_t cb_failures;
+};
+
+/**
+ * @brief Latency histogram.
+ * Records durations (in ticks of the graph's timestamp source) in fixed memory: Values are sorted into log-linear
+ * buckets, which are exact for small values and have a constant relative width for larger ones.
+ * Initialize to zero.
+ */
+struct rk_histogram {
+  /** @brief Number of recorded values. */
+  uint32_t count;
+
+  /** @brief Largest recorded value. */
+  uint32_t max;
+
+  /** @brief Number of recorded values per bucket. */
+  uint32_t buckets[RK_HIST_BUCKETS];
+};
+
+/** @brief Summary of a latency histogram. See rk_histogram_summarize(). */
+struct rk_histogram_summary {
+  uint32_t count;
+  uint32_t p50;
+  uint32_t p99;
+  uint32_t max;
+};
+
 /**
  * @brief A resource graph.
  * Must be initialized with a pointer to an array containing pointers to all nodes,
@@ -62,11 +385,144 @@ struct rk_graph {
   /** @brief Number of nodes in this graph. */
   size_t node_count;
 
+  /**
+   * @brief Length of the nodes array.
+   * @note Optional. If larger than node_count, rk_graph_add_child() may add new nodes to the graph.
+   */
+  size_t node_capacity;
+
+  /**
+   * @brief Arena of the graph.
+   * @note Optional. If set, rk_graph_add_child() and rk_graph_add_client() allocate from this arena instead
+   * of the default arena when passed a null arena.
+   */
+  struct rk_arena *arena;
+
   /** @brief Root of the graph. */
   struct rk_node *root;
 
+  /**
+   * @brief Compiled graph layout.
+   * @note Optional. Must be set before calling rk_init().
+   * If set, rk_init() compiles the graph into this layout, which is then used by all traversals.
+   */
+  struct rk_csr *csr;
+
+  /**
+   * @brief Precomputed enable plans.
+   * @note Optional. Must be set before calling rk_init().
+   * If set, rk_init() precomputes the enable plan of every client into this buffer.
+   */
+  struct rk_plans *plans;
+
+  /**
+   * @brief Impact index.
+   * @note Optional. Must be set before calling rk_init().
+   * If set, rk_init() precomputes the clients that depend on every node into this buffer. See rk_node_impact().
+   */
+  struct rk_impact *impact;
+
+  /**
+   * @brief Bitset graph state.
+   * @note Optional. Must be set before calling rk_init().
+   * If set, rk_optimize() uses bitset operations to find all nodes that are in a non-optimal state, and only
+   * updates these nodes. Node and client states must then only be changed using the API after rk_init().
+   */
+  struct rk_bitset *bitset;
+
+  /**
+   * @brief Remove redundant edges.
+   * @note Optional. Must be set before calling rk_init().
+   * If set, rk_init() removes all parallel edges, and every edge from a node to a child or client that
+   * already depends on the node through one of its other parents. This does not change the behavior of the
+   * graph, but reduces the number of edges every request traverses. Modifies the parents, children and
+   * clients arrays of all nodes and clients.
+   */
+  bool simplify;
+
+  /** @brief Number of edges removed by the last call to rk_init() (if simplify is set). */
+  uint32_t edges_removed;
+
+  /**
+   * @brief Independent components.
+   * @note Optional. Must be set before calling rk_init().
+   * If set, rk_init() splits the graph into shards, and requests for clients of different shards may be
+   * processed concurrently. See rk_shards.
+   */
+  struct rk_shards *shards;
+
+  /**
+   * @brief Dispatch callback
+   * @note Optional.
+   * If set, rk_apply() starts the update of a node that has a cb_update callback by calling this function
+   * instead of the node's callback, for example to execute the callback on a different thread.
+   * @param graph this graph.
+   * @param node node to be updated.
+   * @return same as the node's cb_update callback. Usually RK_PENDING, followed by a call to rk_node_complete()
+   *         once the node's callback has been executed.
+   */
+  int (*cb_dispatch)(struct rk_graph *graph, struct rk_node *node);
+
+  /** @brief User data for use by the dispatch callback. */
+  void *dispatch_ctx;
+
+  /**
+   * @brief Only call node callbacks on transitions.
+   * If set, the cb_update callback of a node is only called if the node changes state, instead of every time
+   * any dependent client is enabled or disabled. See also rk_node.transitions_only.
+   */
+  bool transitions_only;
+
+  /** @brief Number of node callback calls skipped because they were not transitions. Updated atomically. */
+  atomic_uint_least32_t cb_elided;
+
+  /**
+   * @brief Event trace buffer.
+   * @note Optional. If set, all node updates are recorded in this buffer.
+   */
+  struct rk_trace *trace;
+
+  /**
+   * @brief Work counters.
+   * @note Optional. If set, all work performed by requests is counted.
+   */
+  struct rk_stats *stats;
+
+  /**
+   * @brief Timestamp source for latency histograms. Timestamps may wrap around.
+   * @note Optional. Required if any node or client has a latency histogram.
+   */
+  uint32_t (*cb_timestamp)(void);
+
   /** @brief Scratch data used by implementation. Initialize to zero. */
   struct rk_node *ll_topo_tail;
+
+  /** @brief Scratch data used by implementation. Initialize to zero. */
+  uint32_t trv_epoch;
+
+  /** @brief Scratch data used by implementation. Initialize to zero. */
+  uint32_t size_epoch;
+
+  /** @brief Scratch data used by implementation. Initialize to zero. */
+  struct rk_node *ll_dirty_head;
+
+  /** @brief Scratch data used by implementation. Initialize to zero. */
+  bool indices_stale;
+
+  /** @brief Scratch data used by implementation. Initialize to zero. */
+  size_t req_remaining;
+
+  /** @brief Scratch data used by implementation. Initialize to zero. */
+  uint32_t req_trace_start;
+
+  /** @brief Scratch data used by implementation. Initialize to zero. */
+  int req_err;
+
+  /** @brief Scratch data used by implementation. Initialize to zero. */
+  struct rk_client **req_enable_list;
+
+  /** @brief Scratch data used by implementation. Initialize to zero. */
+  size_t req_enable_count;
 };
 
 // Scratch data used by implementation.
@@ -74,6 +530,43 @@ struct rk_node_ctx {
   struct rk_node *ll_trv;
   struct rk_node *ll_topo_next;
   struct rk_node *ll_topo_prev;
+  struct rk_node *ll_undo;
+  struct rk_node *ll_ready;
+  struct rk_node *ll_dirty;
+  struct rk_node *ll_heap;    // First child of this node while it is in the frontier heap of a traversal.
+  uint32_t node_idx;          // Index of this node in the graph's node array.
+  uint32_t trv_epoch;         // Node is in the "traverse" list if this matches the graph's trv_epoch.
+  uint32_t size_epoch;        // Node was counted by the current rk_plans_size() if this matches the graph's size_epoch.
+  struct rk_node *ll_size;    // Next node to be counted by the current rk_plans_size().
+  uint32_t topo_rank;         // Position of this node in the topological order (root is 0). May have gaps.
+  uint32_t active_dependants; // Number of enabled children and clients (counted per edge).
+  int32_t trv_delta;          // Planned change of active_dependants during the current traversal.
+  uint32_t trv_pending;       // Number of nodes in the "traverse" list to be ordered before this node, or
+                              // number of updates this node is waiting for during the current request.
+  bool trv_inflight;          // Callback returned RK_PENDING, and has not yet completed.
+  bool trv_cancelled;         // Update cancelled because an update it depends on failed.
+  bool dirty;                 // Node is in the graph's "dirty" list, and may be in a non-optimal state.
+  uint32_t trace_start;       // Timestamp at which the current update started (if tracing).
+  uint32_t cb_start;          // Timestamp at which the current callback was called (if recording latency).
+  struct rk_client **impact;  // All clients that depend on this node (if the graph has an impact index).
+  uint32_t impact_len;        // Length of the impact array.
+  bool fault_down;            // Node was disabled by a fault, and is re-enabled once the fault is recovered.
+  struct rk_node *ll_reorder; // Predecessor during a cycle search, or previous node of a slot while reordering.
+  uint32_t shard;             // Shard this node belongs to (if the graph is sharded, RK_SHARD_ROOT for the root).
+  uint32_t shard_epoch;       // Node is in the "traverse" list if this matches the epoch of its shard.
+  struct rk_node *ll_shard;   // Next node of the same shard in topological order.
+};
+
+// Adjacency storage used by implementation. Arrays provided by the user have a capacity of zero.
+struct rk_node_storage {
+  uint32_t parent_capacity; // Length of the parents array, if allocated from an arena.
+  uint32_t child_capacity;  // Length of the children array, if allocated from an arena.
+  uint32_t client_capacity; // Length of the clients array, if allocated from an arena.
+};
+
+// Adjacency storage used by implementation. Arrays provided by the user have a capacity of zero.
+struct rk_client_storage {
+  uint32_t parent_capacity; // Length of the parents array, if allocated from an arena.
 };
 
 /**
@@ -106,27 +599,37 @@ struct rk_node {
   /**
    * @brief Pointer to parent nodes.
    * @note May only be empty for the root node
+   * Managed by rk_node_add_child(). Initialize to zero, or to an array of parent_count nodes (see rk_arena).
    */
-  struct rk_node *parents[RK_MAX_PARENTS];
+  struct rk_node **parents;
 
   /** @brief Number of children nodes. */
   uint32_t child_count;
 
-  /** @brief Pointer to child nodes. */
-  struct rk_node *children[RK_MAX_CHILDREN];
+  /**
+   * @brief Pointer to child nodes.
+   * Managed by rk_node_add_child(). Initialize to zero, or to an array of child_count nodes (see rk_arena).
+   */
+  struct rk_node **children;
 
   /** @brief Number of clients. */
   uint32_t client_count;
 
-  /** @brief Pointer to clients. */
-  struct rk_client *clients[RK_MAX_CHILDREN];
+  /**
+   * @brief Pointer to clients.
+   * Managed by rk_node_add_client(). Initialize to zero, or to an array of client_count clients (see rk_arena).
+   */
+  struct rk_client **clients;
 
   /**
    * @brief Update callback
    * @note Optional.
    * @param Pointer to node being updated.
    * Called when any dependent client (direct or indirect) is enabled or disabled,
-   * or when the graph is optimized.
+   * or when the graph is optimized. Enabling a client does not update the parents of nodes
+   * that are already enabled, as they are already enabled as well.
+   * If transitions_only is set (for this node or the graph), only called when this node is
+   * enabled or disabled.
    *
    * - Use self->desired_state to determine if this resources should be turned on or off.
    * - Use self->state to determine if the node is currently enabled.
@@ -138,10 +641,34 @@ struct rk_node {
    *
    * @warning This callback should *not* change the value of self->state.
    * @return 0 if update successful and this node is now in the state self->desired_state,
-   *         any non-zero number if this update failed.
+   *         RK_PENDING if the update was started during a call to rk_apply() and will be completed
+   *         by calling rk_node_complete(),
+   *         any other non-zero number if this update failed.
    */
   int (*cb_update)(const struct rk_node *self);
 
+  /**
+   * @brief Only call this node's callback on transitions.
+   * If set, cb_update is only called if this node changes state. See also rk_graph.transitions_only.
+   */
+  bool transitions_only;
+
+  /** @brief Number of calls to this node's callback skipped because they were not transitions. */
+  uint32_t cb_elided;
+
+  /**
+   * @brief Node has faulted.
+   * @warning Do not modify directly. Set by rk_node_fault(), and cleared by rk_node_recover().
+   */
+  bool faulted;
+
+  /**
+   * @brief Callback latency histogram.
+   * @note Optional. If set, the duration of every call to cb_update (including asynchronous completion) is
+   * recorded. Requires rk_graph.cb_timestamp.
+   */
+  struct rk_histogram *cb_latency;
+
   /**
    * @brief Previous return value of the node's callback.
    * @warning only valid during cb_update call.
@@ -158,6 +685,9 @@ struct rk_node {
 
   /** @brief Scratch data used by implantation. Initialize to zero. */
   struct rk_node_ctx ctx;
+
+  /** @brief Storage used by implementation. Initialize to zero. */
+  struct rk_node_storage storage;
 };
 
 /** @brief A client that requires the resources represented by some graph nodes */
@@ -179,28 +709,74 @@ struct rk_client {
    */
   uint32_t parent_count;
 
-  /** @brief The nodes representing the resources this client requires */
-  struct rk_node *parents[RK_MAX_PARENTS];
+  /**
+   * @brief The nodes representing the resources this client requires
+   * Managed by rk_node_add_client(). Initialize to zero, or to an array of parent_count nodes (see rk_arena).
+   */
+  struct rk_node **parents;
+
+  /**
+   * @brief Latency histogram.
+   * @note Optional. If set, the duration of every call to rk_enable_client(), rk_enable_client_atomic() and
+   * rk_disable_client() for this client is recorded. Requires rk_graph.cb_timestamp.
+   */
+  struct rk_histogram *latency;
+
+  /**
+   * @brief Client was disabled because a node it depends on faulted.
+   * @warning Do not modify directly. Set by rk_node_fault(), and cleared by rk_node_recover() or when the client is
+   * disabled.
+   */
+  bool unserved;
 
   /** @brief Scratch data used by implantation. Initialize to zero. */
   bool in_dot_graph;
+
+  /** @brief Scratch data used by implantation. Initialize to zero. */
+  uint32_t trv_epoch;
+
+  /** @brief Scratch data used by implantation. Initialize to zero. */
+  struct rk_node **plan;
+
+  /** @brief Scratch data used by implantation. Initialize to zero. */
+  uint32_t plan_len;
+
+  /** @brief Storage used by implementation. Initialize to zero. */
+  struct rk_client_storage storage;
 };
 
 /**
  * @brief Enable a client in the resource graph.
  * This ensures that all resources that it depends on are enabled from the root down.
+ * If the graph is sharded, may be called concurrently for clients of different shards (see rk_shards).
  *
  * @param graph resource graph.
  * @param client client to be enabled.
  * @return 0 if successful
- * @return RK_ERR if an unexpected nullpointer is encountered
+ * @return RK_ERR if an unexpected nullpointer is encountered, or the client depends on a node that faulted
  * @return the error code returned by a node's cb_update callback if a callback fails
  */
 int rk_enable_client(struct rk_graph *graph, struct rk_client *client);
 
+/**
+ * @brief Transactionally enable a client in the resource graph.
+ * Identical to rk_enable_client(), except if a node's callback fails: In that case, all nodes that were
+ * enabled during this call are disabled again in reverse order, returning the graph to its previous
+ * (optimal) state without requiring a call to rk_optimize().
+ *
+ * @param graph resource graph.
+ * @param client client to be enabled.
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered, or the client depends on a node that faulted
+ * @return the error code returned by a node's cb_update callback if a callback fails
+ */
+int rk_enable_client_atomic(struct rk_graph *graph, struct rk_client *client);
+
 /**
  * @brief Disable a client in the resouce graph.
- * This disables all resource from the client upwards that are no longer required.
+ * This disables all resource from the client upwards that are no longer required. Nodes that are still
+ * required by another dependant are not visited, and neither are the nodes above them.
+ * If the graph is sharded, may be called concurrently for clients of different shards (see rk_shards).
  *
  * @param graph resource graph.
  * @return 0 if successful
@@ -209,6 +785,166 @@ int rk_enable_client(struct rk_graph *graph, struct rk_client *client);
  */
 int rk_disable_client(struct rk_graph *graph, struct rk_client *client);
 
+/**
+ * @brief Enable and disable multiple clients at once.
+ * Equivalent to enabling all clients in enable_list and then disabling all clients in disable_list,
+ * but all nodes are updated in a single combined traversal: Every node that any of the clients depends
+ * on is updated exactly once, directly to its final state. Nodes are therefor never enabled only to be
+ * disabled again during the same batch. A client contained in both lists is disabled.
+ *
+ * Each node is updated as soon as all updates it depends on have settled (its parents if it is
+ * being enabled, its children if it is being disabled). If a callback fails, all updates depending on
+ * it are cancelled, but independent updates are still carried out.
+ *
+ * Node callbacks may return RK_PENDING to complete asynchronously. In that case, this function returns
+ * RK_PENDING, and the request continues each time a pending update is completed using rk_node_complete().
+ * Many slow but independent updates can therefor be in flight at the same time. Until the request has
+ * completed, all other functions that operate on the graph fail, and enable_list must remain valid.
+ *
+ * @param graph resource graph.
+ * @param enable_list clients to be enabled. May be 0 if enable_count is 0.
+ * @param enable_count number of clients to be enabled.
+ * @param disable_list clients to be disabled. May be 0 if disable_count is 0.
+ * @param disable_count number of clients to be disabled.
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered, or a client in enable_list depends on a node that
+ *         faulted
+ * @return RK_PENDING if the request has not completed because a callback returned RK_PENDING
+ * @return the error code returned by a node's cb_update callback if a callback fails. Clients in
+ *         disable_list are left disabled, clients in enable_list are left in their previous state.
+ */
+int rk_apply(struct rk_graph *graph, struct rk_client **enable_list, size_t enable_count,
+             struct rk_client **disable_list, size_t disable_count);
+
+/**
+ * @brief Complete a node update that is pending.
+ * Must be called exactly once for every node callback that returned RK_PENDING, after the update
+ * has finished. Continues the request by updating all nodes that were waiting for this node.
+ * @warning Must not be called from within a node's callback.
+ *
+ * @param graph resource graph.
+ * @param node node whose update finished.
+ * @param err 0 if the update was successful and the node is now in the state node->desired_state,
+ *            any other non-zero number (except RK_PENDING) if the update failed.
+ * @return RK_PENDING if the request has not yet completed
+ * @return 0 if this completed the request successfully
+ * @return RK_ERR if an unexpected nullpointer is encountered or the node has no pending update
+ * @return the error code of the first failed callback if this completed a request that failed
+ */
+int rk_node_complete(struct rk_graph *graph, struct rk_node *node, int err);
+
+/**
+ * @brief Evaluate which nodes would be enabled in up to 64 client configurations at once.
+ * Does not call any callbacks, and does not modify the graph. Every configuration is a set of enabled clients,
+ * and is represented by one bit position in every 64-bit word: Bit k of enabled[i] is set if clients[i] is enabled in
+ * configuration k. All clients that are not listed are disabled in every configuration.
+ * The graph must have been initialized with rk_init().
+ *
+ * @param graph resource graph.
+ * @param clients clients. May be 0 if client_count is 0.
+ * @param enabled configurations in which every client is enabled (client_count words).
+ * @param client_count number of clients.
+ * @param node_on output: configurations in which every node is enabled (one word per node, in the order of the
+ *                graph's node array).
+ * @param on_count output: number of enabled nodes in every configuration (64 entries). May be 0.
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered
+ */
+int rk_what_if(struct rk_graph *graph, struct rk_client **clients, const uint64_t *enabled, size_t client_count,
+               uint64_t *node_on, uint32_t *on_count);
+
+/**
+ * @brief Get all clients that depend on a node, directly or through any of its (direct and indirect) children.
+ * Every client is listed once. Requires an impact index (see rk_impact). If edges were added or removed since the
+ * index was built, it is rebuilt first (as by any request), so that the result reflects the current graph.
+ *
+ * @param graph resource graph.
+ * @param node node.
+ * @param clients output: array of all clients that depend on the node. Points into the impact index, and becomes
+ *                invalid once an edge is changed: The next request, or call to this function, then rebuilds the
+ *                index in place. Also invalidated by rk_init().
+ * @param count output: length of the clients array.
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered, or the graph has no impact index
+ * @return RK_ERR if the impact index has to be rebuilt, but its buffer has become too small
+ */
+int rk_node_impact(struct rk_graph *graph, struct rk_node *node, struct rk_client ***clients, size_t *count);
+
+/**
+ * @brief Get the shard of a client.
+ * Requests for clients of different shards may be processed concurrently. See rk_shards.
+ *
+ * @param graph initialized resource graph.
+ * @param client client.
+ * @return index of the shard of the client
+ * @return RK_SHARD_ROOT if the client only depends on the root, the graph is not sharded, or an unexpected
+ *         nullpointer is encountered
+ */
+uint32_t rk_client_shard(struct rk_graph *graph, struct rk_client *client);
+
+/**
+ * @brief Read the oldest record from a trace buffer.
+ * May be called concurrently to any other function operating on the graph, but must not be called
+ * concurrently to itself.
+ *
+ * @param trace trace buffer.
+ * @param record output.
+ * @return true if a record was read, false if the buffer is empty.
+ */
+bool rk_trace_read(struct rk_trace *trace, struct rk_trace_record *record);
+
+/**
+ * @brief Read all work counters.
+ * May be called concurrently to any other function operating on the graph. The counters are read
+ * individually, and may therefore be mutually inconsistent if a request is in progress.
+ *
+ * @param stats work counters.
+ * @param snapshot output.
+ */
+void rk_stats_read(struct rk_stats *stats, struct rk_stats_snapshot *snapshot);
+
+/**
+ * @brief Reset all work counters to zero.
+ * May be called concurrently to any other function operating on the graph.
+ *
+ * @param stats work counters.
+ */
+void rk_stats_reset(struct rk_stats *stats);
+
+/**
+ * @brief Record a value in a latency histogram.
+ *
+ * @param hist histogram.
+ * @param value value to record.
+ */
+void rk_histogram_record(struct rk_histogram *hist, uint32_t value);
+
+/**
+ * @brief Get a percentile of all values recorded in a latency histogram.
+ * The result is the upper bound of the bucket containing the percentile, but never larger than the largest
+ * recorded value.
+ *
+ * @param hist histogram.
+ * @param percent percentile (0 to 100).
+ * @return the percentile, or 0 if the histogram is empty.
+ */
+uint32_t rk_histogram_percentile(const struct rk_histogram *hist, uint32_t percent);
+
+/**
+ * @brief Summarize a latency histogram.
+ *
+ * @param hist histogram.
+ * @param summary output.
+ */
+void rk_histogram_summarize(const struct rk_histogram *hist, struct rk_histogram_summary *summary);
+
+/**
+ * @brief Clear a latency histogram.
+ *
+ * @param hist histogram.
+ */
+void rk_histogram_reset(struct rk_histogram *hist);
+
 /**
  * @brief Attempt to optimize the resource graph.
  * Scans the whole resource graph for nodes that are enabled although they have no active dependents.
@@ -222,40 +958,292 @@ int rk_disable_client(struct rk_graph *graph, struct rk_client *client);
  */
 int rk_optimize(struct rk_graph *graph);
 
+/**
+ * @brief Attempt to optimize the parts of the resource graph that may be in a non-optimal state.
+ * Identical to rk_optimize(), except that only nodes that may have been left in a non-optimal state are
+ * revisited: Nodes whose callback failed, the parents of clients whose enabling or disabling failed, nodes
+ * initialized as enabled without an enabled dependant, and all their (direct and indirect) parents. Of these,
+ * only nodes that are enabled without an active dependant (or vice versa) are updated.
+ *
+ * @warning Node and client states that are changed directly after rk_init() are not tracked. Use rk_optimize()
+ *          in that case.
+ *
+ * @param graph resource graph.
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered
+ * @return the error code returned by a node's cb_update callback if a callback fails
+ */
+int rk_optimize_dirty(struct rk_graph *graph);
+
+/**
+ * @brief Report that a node has failed outside of the graph's control, for example because a regulator tripped.
+ * Marks the node as faulted and disabled, without calling its callback. All its (direct and indirect) children that
+ * are enabled are disabled in reverse-topological order, and all enabled clients that depend on the node are
+ * disabled and marked as unserved. The node's parents are left enabled, but may be disabled by
+ * rk_optimize_dirty(). Until the node is recovered, enabling a client that depends on it fails with RK_ERR.
+ * Disabling an unserved client clears its unserved flag, so it is not re-enabled by rk_node_recover().
+ *
+ * If a child's callback fails, the child is still disabled (since its parent is), and the pass continues.
+ *
+ * @param graph resource graph.
+ * @param node faulted node.
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered
+ * @return the error code returned by the first node's cb_update callback that failed
+ */
+int rk_node_fault(struct rk_graph *graph, struct rk_node *node);
+
+/**
+ * @brief Recover a node that faulted.
+ * Re-enables exactly the nodes that were disabled by rk_node_fault() (and all parents of the node that have been
+ * disabled since) in topological order, and re-enables all unserved clients that depend on the node once all their
+ * parents are enabled.
+ *
+ * If a callback fails, the node remains faulted, and recovery may be re-attempted.
+ * @note rk_init() discards the nodes and clients to be re-enabled by a recovery.
+ *
+ * @param graph resource graph.
+ * @param node faulted node.
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered, or the node has not faulted
+ * @return the error code returned by a node's cb_update callback if a callback fails
+ */
+int rk_node_recover(struct rk_graph *graph, struct rk_node *node);
+
 /**
  * @brief Add a child node to a node.
- * @warning This un-initializes the graph. Must call rk_init() before using the graph.
+ * @warning This un-initializes the graph. Must call rk_init() before using the graph. See also rk_graph_add_child().
  * Updates the child's parent pointer, and the parent's child_count and children pointers.
  *
  * @param node node to receive new child
  * @param child child to be added
  * @return 0 if successful
  * @return RK_ERR if an unexpected nullpointer is encountered
- * @return RK_ERR if the RK_MAX_PARENTS or RK_MAX_CHILDREN are exceeded
+ * @return RK_ERR if the default arena is exhausted (see RK_DEFAULT_ARENA_SIZE)
  */
 int rk_node_add_child(struct rk_node *node, struct rk_node *child);
 
 /**
  * @brief Add a client to a node.
  * Updates the client's parent pointer, and the parent's client_count and client pointers.
- * @warning This un-initializes the graph. Must call rk_init() before using the graph.
+ * @warning This un-initializes the graph. Must call rk_init() before using the graph. See also rk_graph_add_client().
  *
  * @param node node to receive new child
  * @param child child to be added
  * @return 0 if successful
  * @return RK_ERR if an unexpected nullpointer is encountered
- * @return RK_ERR if the RK_MAX_PARENTS or RK_MAX_CHILDREN are exceeded
+ * @return RK_ERR if the default arena is exhausted (see RK_DEFAULT_ARENA_SIZE)
  */
 int rk_node_add_client(struct rk_node *node, struct rk_client *client);
 
+/**
+ * @brief Add a child node to a node of an initialized graph.
+ * Identical to rk_node_add_child_arena(), except that the graph remains initialized: Instead of sorting the
+ * whole graph again in rk_init(), only the nodes between the child and the node in the topological order
+ * are reordered (Pearce-Kelly). If the new edge would create a cycle, the cycle is logged and the edge is not
+ * added.
+ *
+ * If the child is not yet part of the graph (has no parents, and is not the root), it is appended to the
+ * graph's nodes array, which requires rk_graph.node_capacity to be larger than rk_graph.node_count. Such a
+ * child must not have any children or clients yet. If it is enabled, it is not required by any client, and is
+ * left for rk_optimize_dirty() to disable.
+ *
+ * @note The compiled layout, enable plans, bitsets and impact index of the graph (if any) are rebuilt by the next
+ *       request, which fails if a buffer has become too small. The shards of a sharded graph are rebuilt before
+ *       this function returns, and RK_ERR is returned (with the change applied) if they cannot be rebuilt.
+ * @note If the child is enabled, the node must be enabled.
+ *
+ * @param graph initialized resource graph.
+ * @param arena arena to allocate from. May be 0 to use the graph's arena, or the default arena if it has none.
+ * @param node node to receive new child. Must be part of the graph.
+ * @param child child to be added
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered
+ * @return RK_ERR if the new edge would create a cycle
+ * @return RK_ERR if the arena is exhausted, or the nodes array is full
+ */
+int rk_graph_add_child(struct rk_graph *graph, struct rk_arena *arena, struct rk_node *node, struct rk_node *child);
+
+/**
+ * @brief Add a client to a node of an initialized graph.
+ * Identical to rk_node_add_client_arena(), except that the graph remains initialized.
+ *
+ * @note The compiled layout, enable plans, bitsets and impact index of the graph (if any) are rebuilt by the next
+ *       request, which fails if a buffer has become too small. The shards of a sharded graph are rebuilt before
+ *       this function returns, and RK_ERR is returned (with the change applied) if they cannot be rebuilt.
+ * @note If the client is enabled, the node must be enabled.
+ *
+ * @param graph initialized resource graph.
+ * @param arena arena to allocate from. May be 0 to use the graph's arena, or the default arena if it has none.
+ * @param node node to receive new client. Must be part of the graph.
+ * @param client client to be added
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered
+ * @return RK_ERR if the arena is exhausted
+ */
+int rk_graph_add_client(struct rk_graph *graph, struct rk_arena *arena, struct rk_node *node,
+                        struct rk_client *client);
+
+/**
+ * @brief Remove a child node from a node of an initialized graph.
+ * Removes one edge between the node and the child. The graph remains initialized. If the child is enabled, the node
+ * may no longer be required, and is left for rk_optimize_dirty() to disable.
+ *
+ * @note The compiled layout, enable plans, bitsets and impact index of the graph (if any) are rebuilt by the next
+ *       request, which fails if a buffer has become too small. The shards of a sharded graph are rebuilt before
+ *       this function returns, and RK_ERR is returned (with the change applied) if they cannot be rebuilt.
+ *
+ * @param graph initialized resource graph.
+ * @param node node to remove the child from.
+ * @param child child to be removed. Must have at least one other parent. See rk_graph_detach_node().
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered
+ * @return RK_ERR if the child is not a child of the node, or has no other parent
+ */
+int rk_graph_remove_child(struct rk_graph *graph, struct rk_node *node, struct rk_node *child);
+
+/**
+ * @brief Remove a client from a node of an initialized graph.
+ * Removes one edge between the node and the client. The graph remains initialized. If the client is enabled, the
+ * node may no longer be required, and is left for rk_optimize_dirty() to disable. A client without any parents is
+ * no longer part of the graph.
+ *
+ * @note The compiled layout, enable plans, bitsets and impact index of the graph (if any) are rebuilt by the next
+ *       request, which fails if a buffer has become too small. The shards of a sharded graph are rebuilt before
+ *       this function returns, and RK_ERR is returned (with the change applied) if they cannot be rebuilt.
+ *
+ * @param graph initialized resource graph.
+ * @param node node to remove the client from.
+ * @param client client to be removed. Must be disabled if the node is its only parent.
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered
+ * @return RK_ERR if the client is not a client of the node, or is enabled and has no other parent
+ */
+int rk_graph_remove_client(struct rk_graph *graph, struct rk_node *node, struct rk_client *client);
+
+/**
+ * @brief Remove a node from an initialized graph.
+ * Removes all edges of the node, and removes it from the graph's nodes array by moving the last node of the array
+ * into its place (changing that node's index, as used by trace records). Clients that only depended on the node
+ * are no longer part of the graph. The graph remains initialized, and the node may be added again using
+ * rk_graph_add_child(). The ranks of the remaining nodes (rk_node_ctx.topo_rank) keep their order, but are no
+ * longer consecutive until the derived indices of the graph are rebuilt or rk_init() is called.
+ *
+ * @note The compiled layout, enable plans, bitsets and impact index of the graph (if any) are rebuilt by the next
+ *       request, which fails if a buffer has become too small. The shards of a sharded graph are rebuilt before
+ *       this function returns, and RK_ERR is returned (with the change applied) if they cannot be rebuilt.
+ *
+ * @param graph initialized resource graph.
+ * @param node node to be removed. Must be disabled, and must not be the only parent of any of its children.
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered
+ * @return RK_ERR if the node is the root, is enabled (for example because enabled clients require it), or is
+ *         the only parent of one of its children
+ */
+int rk_graph_detach_node(struct rk_graph *graph, struct rk_node *node);
+
+/**
+ * @brief Add a child node to a node, allocating adjacency arrays from an arena if required.
+ * Identical to rk_node_add_child(), except that adjacency arrays are allocated from the given arena.
+ * @warning This un-initializes the graph. Must call rk_init() before using the graph.
+ *
+ * @param arena arena to allocate from. May be 0 to use the default arena.
+ * @param node node to receive new child
+ * @param child child to be added
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered
+ * @return RK_ERR if the arena is exhausted
+ */
+int rk_node_add_child_arena(struct rk_arena *arena, struct rk_node *node, struct rk_node *child);
+
+/**
+ * @brief Add a client to a node, allocating adjacency arrays from an arena if required.
+ * Identical to rk_node_add_client(), except that adjacency arrays are allocated from the given arena.
+ * @warning This un-initializes the graph. Must call rk_init() before using the graph.
+ *
+ * @param arena arena to allocate from. May be 0 to use the default arena.
+ * @param node node to receive new client
+ * @param client client to be added
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered
+ * @return RK_ERR if the arena is exhausted
+ */
+int rk_node_add_client_arena(struct rk_arena *arena, struct rk_node *node, struct rk_client *client);
+
+/**
+ * @brief Reset the default arena, returning all of its memory.
+ * @warning All adjacency arrays allocated from the default arena become invalid. Must only be called once no
+ * node or client uses such an array anymore, for example after all nodes and clients of all graphs that were
+ * built using the default arena have been reset to zero. Not thread-safe.
+ */
+void rk_default_arena_reset(void);
+
+/**
+ * @brief Calculate the size of the buffer required to compile a resource graph.
+ * @note All nodes and clients must have been added to the graph.
+ *
+ * @param graph resource graph
+ * @return required size of the rk_csr buffer in bytes
+ * @return 0 if an unexpected nullpointer is encountered
+ */
+size_t rk_csr_size(struct rk_graph *graph);
+
+/**
+ * @brief Calculate the size of the buffer required to store the enable plans of all clients of a resource graph.
+ * Does not modify the plans or the state of the graph, and may be called while the graph is initialized.
+ * @note All nodes and clients must have been added to the graph.
+ * @note Ancestors shared by multiple parents or clients are stored once per client parent. The plans of a graph
+ *       with N nodes and E client edges (client-parent pairs) therefore take at most E * N pointers, which is
+ *       reached if every client parent depends on all other nodes.
+ *
+ * @param graph resource graph
+ * @return required size of the rk_plans buffer in bytes
+ * @return 0 if an unexpected nullpointer is encountered
+ */
+size_t rk_plans_size(struct rk_graph *graph);
+
+/**
+ * @brief Calculate the size of the buffer required to store the bitset state of a resource graph.
+ * @note All nodes and clients must have been added to the graph.
+ *
+ * @param graph resource graph
+ * @return required size of the rk_bitset buffer in bytes
+ * @return 0 if an unexpected nullpointer is encountered
+ */
+size_t rk_bitset_size(struct rk_graph *graph);
+
+/**
+ * @brief Calculate the size of the buffer required to store the impact index of a resource graph.
+ * @note All nodes and clients must have been added to the graph.
+ *
+ * @param graph resource graph
+ * @return required size of the rk_impact buffer in bytes
+ * @return 0 if an unexpected nullpointer is encountered
+ */
+size_t rk_impact_size(struct rk_graph *graph);
+
+/**
+ * @brief Calculate the size of the buffer required to store the shards of a resource graph.
+ * @note All nodes and clients must have been added to the graph.
+ *
+ * @param graph resource graph
+ * @return required size of the rk_shards buffer in bytes
+ * @return 0 if an unexpected nullpointer is encountered
+ */
+size_t rk_shards_size(struct rk_graph *graph);
+
 /**
  * @brief Initialize a resource graph.
  * Must be called after all nodes and clients have been added to the graph,
  * and before the graph is used.
+ * If the graph has a compiled layout (csr), the graph is (re-)compiled.
  *
  * @param graph resource graph
  * @return 0 if successful
  * @return RK_ERR if the graph could not be initialized
+ * @return RK_ERR if a node's children or clients contain a null pointer. Requests do not check this again.
+ * @return RK_ERR if the graph's csr buffer is too small
+ * @return RK_ERR if the graph's trace buffer length is not a power of two
  */
 int rk_init(struct rk_graph *graph);
 
@@ -0,0 +1,226 @@
+/**
+ * @file resource_khan_exec.c
+ * @brief Resource Khan parallel callback executor.
+ * https://github.com/schilkp/ResourceKhan
+ */
+#include "resource_khan_exec.h"
+#include <string.h>
+
+// ==== Private Prototypes =====================================================
+
+static void *worker_main(void *arg);
+static int exec_dispatch(struct rk_graph *graph, struct rk_node *node);
+static bool deque_push(struct rk_exec_deque *d, struct rk_node *node);
+static struct rk_node *deque_pop(struct rk_exec_deque *d);
+static struct rk_node *deque_steal(struct rk_exec_deque *d);
+static struct rk_node *take_node(struct rk_exec_worker *worker);
+static void stop_workers(struct rk_executor *ex, size_t started_count);
+
+// Worker that is executing on the current thread (if any):
+static _Thread_local struct rk_exec_worker *current_worker = 0;
+
+// ==== Public Functions =======================================================
+
+int rk_exec_start(struct rk_executor *ex, struct rk_graph *graph, size_t thread_count) {
+  if (ex == 0) return RK_ERR;
+  if (graph == 0) return RK_ERR;
+
+  if (thread_count == 0 || thread_count > RK_EXEC_MAX_THREADS) {
+    RK_LOG_ERR("Cannot start executor with %zd threads (Maximum is %u).", thread_count, RK_EXEC_MAX_THREADS);
+    return RK_ERR;
+  }
+
+  memset(ex, 0, sizeof(*ex));
+  ex->graph = graph;
+  ex->thread_count = thread_count;
+
+  pthread_mutex_init(&ex->graph_lock, 0);
+  pthread_cond_init(&ex->done_cond, 0);
+  pthread_mutex_init(&ex->work_lock, 0);
+  pthread_cond_init(&ex->work_cond, 0);
+
+  // Workers steal from each other's deques as soon as they start, so all deques are initialized first:
+  for (size_t i = 0; i < thread_count; i++) {
+    struct rk_exec_worker *worker = &ex->workers[i];
+    worker->ex = ex;
+    worker->idx = i;
+    pthread_mutex_init(&worker->deque.lock, 0);
+  }
+
+  for (size_t i = 0; i < thread_count; i++) {
+    if (pthread_create(&ex->workers[i].thread, 0, worker_main, &ex->workers[i]) != 0) {
+      RK_LOG_ERR("Failed to start executor thread %zd.", i);
+      stop_workers(ex, i);
+      return RK_ERR;
+    }
+  }
+
+  graph->dispatch_ctx = ex;
+  graph->cb_dispatch = exec_dispatch;
+
+  return 0;
+}
+
+int rk_exec_apply(struct rk_executor *ex, struct rk_client **enable_list, size_t enable_count,
+                  struct rk_client **disable_list, size_t disable_count) {
+  if (ex == 0) return RK_ERR;
+
+  pthread_mutex_lock(&ex->graph_lock);
+
+  ex->done = false;
+  int err = rk_apply(ex->graph, enable_list, enable_count, disable_list, disable_count);
+
+  // Wait for the workers to complete the request:
+  if (err == RK_PENDING) {
+    while (!ex->done) {
+      pthread_cond_wait(&ex->done_cond, &ex->graph_lock);
+    }
+    err = ex->result;
+  }
+
+  pthread_mutex_unlock(&ex->graph_lock);
+
+  return err;
+}
+
+int rk_exec_stop(struct rk_executor *ex) {
+  if (ex == 0) return RK_ERR;
+
+  stop_workers(ex, ex->thread_count);
+
+  ex->graph->cb_dispatch = 0;
+  ex->graph->dispatch_ctx = 0;
+
+  return 0;
+}
+
+// ==== Private Functions ======================================================
+
+static void stop_workers(struct rk_executor *ex, size_t started_count) {
+  pthread_mutex_lock(&ex->work_lock);
+  ex->stop = true;
+  pthread_cond_broadcast(&ex->work_cond);
+  pthread_mutex_unlock(&ex->work_lock);
+
+  for (size_t i = 0; i < started_count; i++) {
+    pthread_join(ex->workers[i].thread, 0);
+  }
+  for (size_t i = 0; i < ex->thread_count; i++) {
+    pthread_mutex_destroy(&ex->workers[i].deque.lock);
+  }
+
+  pthread_cond_destroy(&ex->work_cond);
+  pthread_mutex_destroy(&ex->work_lock);
+  pthread_cond_destroy(&ex->done_cond);
+  pthread_mutex_destroy(&ex->graph_lock);
+}
+
+static void *worker_main(void *arg) {
+  struct rk_exec_worker *worker = arg;
+  struct rk_executor *ex = worker->ex;
+  current_worker = worker;
+
+  while (true) {
+    // Take a node. If all deques are empty, sleep until a node is dispatched: A node dispatched after
+    // work_seq was read changes it before the worker can start waiting, and is not missed.
+    uint_least32_t seq = atomic_load(&ex->work_seq);
+    struct rk_node *node = take_node(worker);
+    if (node == 0) {
+      pthread_mutex_lock(&ex->work_lock);
+      while (!ex->stop && atomic_load(&ex->work_seq) == seq) {
+        pthread_cond_wait(&ex->work_cond, &ex->work_lock);
+      }
+      bool stop = ex->stop;
+      pthread_mutex_unlock(&ex->work_lock);
+      if (stop) break;
+      continue;
+    }
+
+    int err = node->cb_update(node);
+
+    pthread_mutex_lock(&ex->graph_lock);
+    int result = rk_node_complete(ex->graph, node, err);
+    if (result != RK_PENDING) {
+      ex->result = result;
+      ex->done = true;
+      pthread_cond_broadcast(&ex->done_cond);
+    }
+    pthread_mutex_unlock(&ex->graph_lock);
+  }
+
+  return 0;
+}
+
+// Graph dispatch callback. Always called with the graph lock held.
+static int exec_dispatch(struct rk_graph *graph, struct rk_node *node) {
+  struct rk_executor *ex = graph->dispatch_ctx;
+
+  // Nodes dispatched by a worker are pushed onto its own deque, others are distributed round-robin:
+  size_t first;
+  if (current_worker != 0 && current_worker->ex == ex) {
+    first = current_worker->idx;
+  } else {
+    first = ex->next_worker;
+    ex->next_worker = (ex->next_worker + 1) % ex->thread_count;
+  }
+
+  for (size_t i = 0; i < ex->thread_count; i++) {
+    if (deque_push(&ex->workers[(first + i) % ex->thread_count].deque, node)) {
+      // Signalled with the work lock held, so that a worker cannot miss the new node between
+      // finding all deques empty and waiting:
+      pthread_mutex_lock(&ex->work_lock);
+      atomic_fetch_add(&ex->work_seq, 1);
+      pthread_cond_signal(&ex->work_cond);
+      pthread_mutex_unlock(&ex->work_lock);
+      return RK_PENDING;
+    }
+  }
+
+  // All deques are full. Execute callback directly:
+  return node->cb_update(node);
+}
+
+static bool deque_push(struct rk_exec_deque *d, struct rk_node *node) {
+  bool ok = false;
+  pthread_mutex_lock(&d->lock);
+  if (d->bottom - d->top < RK_EXEC_DEQUE_LEN) {
+    d->nodes[d->bottom % RK_EXEC_DEQUE_LEN] = node;
+    d->bottom++;
+    ok = true;
+  }
+  pthread_mutex_unlock(&d->lock);
+  return ok;
+}
+
+static struct rk_node *deque_pop(struct rk_exec_deque *d) {
+  struct rk_node *node = 0;
+  pthread_mutex_lock(&d->lock);
+  if (d->bottom != d->top) {
+    d->bottom--;
+    node = d->nodes[d->bottom % RK_EXEC_DEQUE_LEN];
+  }
+  pthread_mutex_unlock(&d->lock);
+  return node;
+}
+
+static struct rk_node *deque_steal(struct rk_exec_deque *d) {
+  struct rk_node *node = 0;
+  pthread_mutex_lock(&d->lock);
+  if (d->bottom != d->top) {
+    node = d->nodes[d->top % RK_EXEC_DEQUE_LEN];
+    d->top++;
+  }
+  pthread_mutex_unlock(&d->lock);
+  return node;
+}
+
+// Take the newest node from the worker's own deque, or otherwise steal the oldest node of another
+// worker. Only takes the lock of one deque at a time. Returns 0 if all deques are empty.
+static struct rk_node *take_node(struct rk_exec_worker *worker) {
+  struct rk_executor *ex = worker->ex;
+  struct rk_node *node = deque_pop(&worker->deque);
+  for (size_t i = 1; i < ex->thread_count && node == 0; i++) {
+    node = deque_steal(&ex->workers[(worker->idx + i) % ex->thread_count].deque);
+  }
+  return node;
+}
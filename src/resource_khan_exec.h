@@ -0,0 +1,120 @@
+/**
+ * @file resource_khan_exec.h
+ * @brief Resource Khan parallel callback executor.
+ * https://github.com/schilkp/ResourceKhan
+ *
+ * Executes the node callbacks of rk_apply() requests on a fixed pool of worker threads.
+ * Each node's callback is started as soon as all updates it depends on have completed
+ * (its parents when enabling, its children when disabling), so independent branches of the
+ * graph are updated in parallel.
+ *
+ * Every worker owns a deque of ready nodes. Nodes that become ready while a worker completes
+ * an update are pushed onto that worker's own deque and are executed by it in LIFO order, while
+ * idle workers steal the oldest nodes from other workers' deques. Workers that find all deques
+ * empty sleep until a new node is dispatched.
+ *
+ * The executor is built as a separate library (RK_Exec), which depends on pthreads.
+ *
+ * @warning Node callbacks are executed on worker threads, concurrently with each other. They
+ * must only access the node they are updating, and must not return RK_PENDING.
+ */
+#ifndef RESOURCE_KHAN_EXEC_H_
+#define RESOURCE_KHAN_EXEC_H_
+
+#include "resource_khan.h"
+#include <pthread.h>
+
+#ifndef RK_EXEC_MAX_THREADS
+/** @brief Maximum number of worker threads per executor. */
+#define RK_EXEC_MAX_THREADS 8
+#endif /* RK_EXEC_MAX_THREADS */
+
+#ifndef RK_EXEC_DEQUE_LEN
+/**
+ * @brief Capacity of each worker's deque.
+ * @note If all deques are full, node callbacks are executed directly by the thread that dispatched them.
+ */
+#define RK_EXEC_DEQUE_LEN 64
+#endif /* RK_EXEC_DEQUE_LEN */
+
+// Work-stealing deque. Private to the executor.
+struct rk_exec_deque {
+  pthread_mutex_t lock;
+  struct rk_node *nodes[RK_EXEC_DEQUE_LEN];
+  size_t top;    // Index of oldest node (stolen by other workers).
+  size_t bottom; // Index after newest node (popped by owner).
+};
+
+// Worker thread. Private to the executor.
+struct rk_exec_worker {
+  struct rk_executor *ex;
+  size_t idx;
+  pthread_t thread;
+  struct rk_exec_deque deque;
+};
+
+/**
+ * @brief A parallel callback executor.
+ * All members are private to the executor. Initialize using rk_exec_start().
+ */
+struct rk_executor {
+  struct rk_graph *graph;
+
+  size_t thread_count;
+  struct rk_exec_worker workers[RK_EXEC_MAX_THREADS];
+  size_t next_worker;
+
+  // Serializes all access to the graph:
+  pthread_mutex_t graph_lock;
+  pthread_cond_t done_cond;
+  bool done;
+  int result;
+
+  // Every deque is protected by its own lock. Workers only take the work lock to sleep on work_cond
+  // once all deques are empty. Whenever a node is dispatched, work_seq is incremented and work_cond
+  // signalled while holding the work lock:
+  pthread_mutex_t work_lock;
+  pthread_cond_t work_cond;
+  atomic_uint_least32_t work_seq;
+  bool stop;
+};
+
+/**
+ * @brief Start an executor and attach it to a graph.
+ * Sets the graph's dispatch callback. The graph must not be accessed other than through the
+ * executor until it is stopped.
+ *
+ * @param ex executor
+ * @param graph resource graph (must be initialized)
+ * @param thread_count number of worker threads (1 to RK_EXEC_MAX_THREADS)
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered or the executor could not be started
+ */
+int rk_exec_start(struct rk_executor *ex, struct rk_graph *graph, size_t thread_count);
+
+/**
+ * @brief Enable and disable multiple clients, executing node callbacks on the executor's workers.
+ * See rk_apply(). Blocks until the request has completed.
+ *
+ * @param ex executor
+ * @param enable_list clients to be enabled. May be 0 if enable_count is 0.
+ * @param enable_count number of clients to be enabled.
+ * @param disable_list clients to be disabled. May be 0 if disable_count is 0.
+ * @param disable_count number of clients to be disabled.
+ * @return see rk_apply(), except that RK_PENDING is never returned.
+ */
+int rk_exec_apply(struct rk_executor *ex, struct rk_client **enable_list, size_t enable_count,
+                  struct rk_client **disable_list, size_t disable_count);
+
+/**
+ * @brief Stop an executor and detach it from its graph.
+ * Waits for all worker threads to exit.
+ * @warning Must not be called while a call to rk_exec_apply() is in progress.
+ *
+ * @param ex executor
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered
+ */
+int rk_exec_stop(struct rk_executor *ex);
+
+#endif /* RESOURCE_KHAN_EXEC_H_ */
@@ -10,6 +10,18 @@
 // ==== Private Prototypes =====================================================
 
 static void reset_client_in_dot_graph(struct rk_graph *pt);
+static void out_trace_track(void (*out)(const char *msg), uint32_t track, const char *name, bool first);
+static void out_json_str(void (*out)(const char *msg), const char *str);
+static void out_uint(void (*out)(const char *msg), uint64_t value);
+static void out_int(void (*out)(const char *msg), int64_t value);
+static void out_us(void (*out)(const char *msg), uint32_t ticks, uint32_t ticks_per_us);
+static bool trace_record_valid(struct rk_graph *pt, const struct rk_trace_record *record);
+static struct rk_node *trace_dependency(struct rk_graph *pt, const struct rk_trace_record *record, uint32_t idx);
+static size_t find_trace_update(const struct rk_trace_record *records, size_t first, size_t last, uint32_t node);
+static bool out_trace_waits(struct rk_graph *pt, void (*out)(const char *msg), const struct rk_trace_record *records,
+                            size_t first, size_t i);
+static void out_trace_flows(struct rk_graph *pt, void (*out)(const char *msg), const struct rk_trace_record *records,
+                            size_t first, size_t i, uint32_t ticks_per_us, uint32_t *flow_id);
 
 static inline bool handle_contains_nullptr(struct rk_graph *graph) {
   if (graph == 0) return true;
@@ -92,7 +104,7 @@ int rk_exportdot_cb(struct rk_graph *graph, void (*out)(const char *msg), const
 
     // Trv list (if enabled)
     if (params->include_trv_list) {
-      if (node->ctx.ll_trv != 0) {
+      if (node->ctx.ll_trv != 0 && node->ctx.trv_epoch == graph->trv_epoch) {
         out("  \"");
         out(node->name);
         out("\" -> \"");
@@ -108,6 +120,90 @@ int rk_exportdot_cb(struct rk_graph *graph, void (*out)(const char *msg), const
   return 0;
 }
 
+int rk_exporttrace_cb(struct rk_graph *graph, const struct rk_trace_record *records, size_t record_count,
+                      uint32_t ticks_per_us, void (*out)(const char *msg)) {
+  if (handle_contains_nullptr(graph)) return RK_ERR;
+  if (records == 0 && record_count != 0) return RK_ERR;
+  if (out == 0) return RK_ERR;
+  if (ticks_per_us == 0) return RK_ERR;
+
+  static const char *request_names[] = {
+      [RK_TRACE_ENABLE] = "rk_enable_client",
+      [RK_TRACE_ENABLE_ATOMIC] = "rk_enable_client_atomic",
+      [RK_TRACE_DISABLE] = "rk_disable_client",
+      [RK_TRACE_APPLY] = "rk_apply",
+      [RK_TRACE_OPTIMIZE] = "rk_optimize",
+      [RK_TRACE_OPTIMIZE_DIRTY] = "rk_optimize_dirty",
+      [RK_TRACE_FAULT] = "rk_node_fault",
+      [RK_TRACE_RECOVER] = "rk_node_recover",
+  };
+
+  // Validate all records first, so that the output is never truncated:
+  for (size_t i = 0; i < record_count; i++) {
+    if (!trace_record_valid(graph, &records[i])) return RK_ERR;
+  }
+
+  out("{\"traceEvents\":[\r\n");
+
+  // Track names. Requests are shown on track 0, node i on track i+1:
+  out_trace_track(out, 0, "requests", true);
+  for (size_t node_idx = 0; node_idx < graph->node_count; node_idx++) {
+    out_trace_track(out, (uint32_t)node_idx + 1, graph->nodes[node_idx]->name, false);
+  }
+
+  // Events. All updates recorded since the previous request belong to the next request:
+  size_t request_first = 0;
+  uint32_t flow_id = 0;
+  for (size_t i = 0; i < record_count; i++) {
+    const struct rk_trace_record *record = &records[i];
+    uint32_t track;
+    const char *name;
+
+    if (record->type == RK_TRACE_REQUEST) {
+      track = 0;
+      name = request_names[record->node];
+    } else {
+      track = record->node + 1;
+      name = graph->nodes[record->node]->name;
+    }
+
+    out(",\r\n{\"name\":\"");
+    out_json_str(out, name);
+    out("\",\"cat\":\"");
+    out(record->type == RK_TRACE_REQUEST ? "request" : "update");
+    out("\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+    out_uint(out, track);
+    out(",\"ts\":");
+    out_us(out, record->timestamp, ticks_per_us);
+    out(",\"dur\":");
+    out_us(out, record->duration, ticks_per_us);
+    out(",\"args\":{");
+    if (record->type != RK_TRACE_REQUEST) {
+      out("\"old_state\":\"");
+      out(record->old_state ? "ON" : "OFF");
+      out("\",\"new_state\":\"");
+      out(record->new_state ? "ON" : "OFF");
+      out("\",");
+      if (out_trace_waits(graph, out, records, request_first, i)) {
+        out(",");
+      }
+    }
+    out("\"return\":");
+    out_int(out, record->cb_return);
+    out("}}");
+
+    if (record->type == RK_TRACE_REQUEST) {
+      request_first = i + 1;
+    } else {
+      out_trace_flows(graph, out, records, request_first, i, ticks_per_us, &flow_id);
+    }
+  }
+
+  out("\r\n]}\r\n");
+
+  return 0;
+}
+
 // ==== Private Functions ======================================================
 
 static void reset_client_in_dot_graph(struct rk_graph *pt) {
@@ -118,3 +214,152 @@ static void reset_client_in_dot_graph(struct rk_graph *pt) {
     }
   }
 }
+
+// Output a track (thread) name metadata event.
+static void out_trace_track(void (*out)(const char *msg), uint32_t track, const char *name, bool first) {
+  if (!first) {
+    out(",\r\n");
+  }
+  out("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":");
+  out_uint(out, track);
+  out(",\"args\":{\"name\":\"");
+  out_json_str(out, name);
+  out("\"}}");
+}
+
+// Output the contents of a JSON string, escaping quotes, backslashes and control characters.
+static void out_json_str(void (*out)(const char *msg), const char *str) {
+  static const char hex[] = "0123456789abcdef";
+  char buf[32];
+  size_t len = 0;
+
+  for (; *str != '\0'; str++) {
+    unsigned char c = (unsigned char)*str;
+
+    // Flush if the longest escape sequence (\u00XX) and the terminator may not fit:
+    if (len + 7 > sizeof(buf)) {
+      buf[len] = '\0';
+      out(buf);
+      len = 0;
+    }
+
+    if (c == '"' || c == '\\') {
+      buf[len++] = '\\';
+      buf[len++] = (char)c;
+    } else if (c < 0x20) {
+      memcpy(&buf[len], "\\u00", 4);
+      len += 4;
+      buf[len++] = hex[c >> 4];
+      buf[len++] = hex[c & 0xF];
+    } else {
+      buf[len++] = (char)c;
+    }
+  }
+
+  buf[len] = '\0';
+  out(buf);
+}
+
+static void out_uint(void (*out)(const char *msg), uint64_t value) {
+  char buf[21];
+  size_t pos = sizeof(buf) - 1;
+  buf[pos] = '\0';
+  do {
+    buf[--pos] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  out(&buf[pos]);
+}
+
+static void out_int(void (*out)(const char *msg), int64_t value) {
+  if (value < 0) {
+    out("-");
+    out_uint(out, (uint64_t)0 - (uint64_t)value);
+  } else {
+    out_uint(out, (uint64_t)value);
+  }
+}
+
+// Output a timestamp/duration in microseconds, with nanosecond resolution.
+static void out_us(void (*out)(const char *msg), uint32_t ticks, uint32_t ticks_per_us) {
+  uint64_t ns = (uint64_t)ticks * 1000u / ticks_per_us;
+  out_uint(out, ns / 1000u);
+
+  char frac[5] = {'.', (char)('0' + (ns / 100u) % 10), (char)('0' + (ns / 10u) % 10), (char)('0' + ns % 10), '\0'};
+  out(frac);
+}
+
+// Check that a trace record refers to a valid request kind or node of the graph.
+static bool trace_record_valid(struct rk_graph *pt, const struct rk_trace_record *record) {
+  if (record->type == RK_TRACE_REQUEST) return record->node <= RK_TRACE_RECOVER;
+  if (record->type == RK_TRACE_UPDATE) return record->node < pt->node_count;
+  return false;
+}
+
+// Get the idx-th node an update waits for: Its parents if the node is enabled, or its children if it is
+// disabled. Returns 0 if there is no such node.
+static struct rk_node *trace_dependency(struct rk_graph *pt, const struct rk_trace_record *record, uint32_t idx) {
+  struct rk_node *node = pt->nodes[record->node];
+  if (record->new_state) {
+    return idx < node->parent_count ? node->parents[idx] : 0;
+  } else {
+    return idx < node->child_count ? node->children[idx] : 0;
+  }
+}
+
+// Find the most recent update of a node among records first to last-1.
+// Returns the index of the record, or last if the node was not updated.
+static size_t find_trace_update(const struct rk_trace_record *records, size_t first, size_t last, uint32_t node) {
+  for (size_t i = last; i > first; i--) {
+    if (records[i - 1].type == RK_TRACE_UPDATE && records[i - 1].node == node) return i - 1;
+  }
+  return last;
+}
+
+// Output the "waits_for" argument of update i: All updates of the same request it waited for, which
+// are all updates of the nodes it depends on (see trace_dependency()) since the first update of the request.
+// Returns true if any argument was output.
+static bool out_trace_waits(struct rk_graph *pt, void (*out)(const char *msg), const struct rk_trace_record *records,
+                            size_t first, size_t i) {
+  bool any = false;
+  struct rk_node *dep;
+  for (uint32_t dep_idx = 0; (dep = trace_dependency(pt, &records[i], dep_idx)) != 0; dep_idx++) {
+    if (find_trace_update(records, first, i, dep->ctx.node_idx) == i) continue;
+    out(any ? ",\"" : "\"waits_for\":[\"");
+    out_json_str(out, dep->name);
+    out("\"");
+    any = true;
+  }
+  if (any) {
+    out("]");
+  }
+  return any;
+}
+
+// Output a flow event (rendered as an arrow) from every update that update i waited for to update i.
+static void out_trace_flows(struct rk_graph *pt, void (*out)(const char *msg), const struct rk_trace_record *records,
+                            size_t first, size_t i, uint32_t ticks_per_us, uint32_t *flow_id) {
+  struct rk_node *dep;
+  for (uint32_t dep_idx = 0; (dep = trace_dependency(pt, &records[i], dep_idx)) != 0; dep_idx++) {
+    size_t dep_record = find_trace_update(records, first, i, dep->ctx.node_idx);
+    if (dep_record == i) continue;
+
+    out(",\r\n{\"name\":\"wait\",\"cat\":\"dependency\",\"ph\":\"s\",\"id\":");
+    out_uint(out, *flow_id);
+    out(",\"pid\":1,\"tid\":");
+    out_uint(out, records[dep_record].node + 1);
+    out(",\"ts\":");
+    out_us(out, records[dep_record].timestamp, ticks_per_us);
+    out("}");
+
+    out(",\r\n{\"name\":\"wait\",\"cat\":\"dependency\",\"ph\":\"f\",\"bp\":\"e\",\"id\":");
+    out_uint(out, *flow_id);
+    out(",\"pid\":1,\"tid\":");
+    out_uint(out, records[i].node + 1);
+    out(",\"ts\":");
+    out_us(out, records[i].timestamp, ticks_per_us);
+    out("}");
+
+    (*flow_id)++;
+  }
+}
@@ -28,4 +28,23 @@ struct rk_dot_params {
  */
 int rk_exportdot_cb(struct rk_graph *graph, void (*out)(const char *msg), const struct rk_dot_params *params);
 
+/**
+ * @brief Render trace records into Chrome trace-event JSON, to be visualized using Perfetto or chrome://tracing.
+ * The output is generated by repeatedly calling the "out" output stream callback. Every node is rendered as
+ * a separate track showing all of its updates, and all requests are rendered on an additional "requests" track.
+ * Every update lists the updates of the same request it waited for (of its parents when enabling, or of its
+ * children when disabling) in its "waits_for" argument, and is connected to them by flow events.
+ *
+ * @param graph resource graph the records were recorded from
+ * @param records trace records, as read using rk_trace_read()
+ * @param record_count number of records
+ * @param ticks_per_us number of timestamp ticks per microsecond
+ * @param out output stream
+ * @return 0 if successful
+ * @return RK_ERR if an unexpected nullpointer is encountered or ticks_per_us is 0
+ * @return RK_ERR if a record is invalid. Nothing is output in that case.
+ */
+int rk_exporttrace_cb(struct rk_graph *graph, const struct rk_trace_record *records, size_t record_count,
+                      uint32_t ticks_per_us, void (*out)(const char *msg));
+
 #endif /* RESOURCE_KHAN_EXT_H_ */
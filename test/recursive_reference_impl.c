@@ -2,6 +2,13 @@
 
 #define RK_MAX_DEPTH 10
 
+// Capacity of every adjacency array of the reference implementation:
+#define REF_MAX_EDGES 8
+
+// Storage for all adjacency arrays of the reference implementation:
+static void *ref_storage[4096];
+static size_t ref_storage_used = 0;
+
 // ==== Private Prototypes =====================================================
 
 static int inner_enable(struct rk_node *node, uint32_t current_depth);
@@ -9,6 +16,7 @@ static int inner_disable(struct rk_node *node, uint32_t current_depth);
 static int inner_optimize(struct rk_node *node, uint32_t current_depth);
 static int update_node(struct rk_node *node, bool new_state);
 static bool has_active_dependant(struct rk_node *node);
+static void *ref_alloc(void *array);
 
 #define RK_ON_OFF(_i_) ((_i_) ? "ON" : "OFF")
 
@@ -43,6 +51,11 @@ int rk_disable_client(struct rk_graph *pt, struct rk_client *client) {
 int rk_optimize(struct rk_graph *pt) { return inner_optimize(pt->root, 0); }
 
 int rk_node_add_child(struct rk_node *node, struct rk_node *child) {
+  node->children = ref_alloc(node->children);
+  child->parents = ref_alloc(child->parents);
+  if (node->children == 0 || child->parents == 0) return RK_ERR;
+  if (node->child_count == REF_MAX_EDGES || child->parent_count == REF_MAX_EDGES) return RK_ERR;
+
   node->children[node->child_count] = child;
   node->child_count++;
   child->parents[child->parent_count] = node;
@@ -52,6 +65,11 @@ int rk_node_add_child(struct rk_node *node, struct rk_node *child) {
 }
 
 int rk_node_add_client(struct rk_node *node, struct rk_client *client) {
+  node->clients = ref_alloc(node->clients);
+  client->parents = ref_alloc(client->parents);
+  if (node->clients == 0 || client->parents == 0) return RK_ERR;
+  if (node->client_count == REF_MAX_EDGES || client->parent_count == REF_MAX_EDGES) return RK_ERR;
+
   node->clients[node->client_count] = client;
   node->client_count++;
   client->parents[client->parent_count] = node;
@@ -72,7 +90,8 @@ static int inner_enable(struct rk_node *node, uint32_t current_depth) {
     return RK_ERR;
   }
 
-  for (size_t i = 0; i < node->parent_count; i++) {
+  // All parents of an enabled node are enabled:
+  for (size_t i = 0; !node->state && i < node->parent_count; i++) {
     int err = inner_enable(node->parents[i], current_depth + 1);
     if (err) return err;
   }
@@ -85,9 +104,10 @@ static int inner_disable(struct rk_node *node, uint32_t current_depth) {
     return RK_ERR;
   }
 
-  bool new_state = has_active_dependant(node);
+  // Nodes that are still required keep all their parents enabled:
+  if (!node->state || has_active_dependant(node)) return 0;
 
-  int err = update_node(node, new_state);
+  int err = update_node(node, false);
   if (err) return err;
 
   for (size_t i = 0; i < node->parent_count; i++) {
@@ -156,3 +176,13 @@ static bool has_active_dependant(struct rk_node *node) {
   }
   return false;
 }
+
+// Allocate an adjacency array of REF_MAX_EDGES entries, unless the array has already been allocated.
+// Returns 0 if the storage is exhausted.
+static void *ref_alloc(void *array) {
+  if (array != 0) return array;
+  if (ref_storage_used + REF_MAX_EDGES > sizeof(ref_storage) / sizeof(ref_storage[0])) return 0;
+  array = &ref_storage[ref_storage_used];
+  ref_storage_used += REF_MAX_EDGES;
+  return array;
+}
@@ -0,0 +1,262 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =====================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//       +---+---+     |
+//       |       |     |
+//      n_d     n_c    |
+//       |       |     |
+//       |       +-+ +-+
+//       |         | |
+//       |         n_e
+//       |          |
+//       +----+ +---+
+//            | |
+//            n_f
+//             |
+//            n_g
+//
+// All nodes have a single, identically named client (n_root -> c_root, n_a -> c_a etc),
+// except n_g, which has two (c_g1, c_g2).
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+struct rk_node n_d = {.name = "n_d", .cb_update = mock_cb_update};
+struct rk_node n_e = {.name = "n_e", .cb_update = mock_cb_update};
+struct rk_node n_f = {.name = "n_f", .cb_update = mock_cb_update};
+struct rk_node n_g = {.name = "n_g", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {&n_root, &n_a, &n_b, &n_c, &n_d, &n_e, &n_f, &n_g};
+struct rk_graph pt = {.nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_b = {.name = "c_b"};
+struct rk_client c_c = {.name = "c_c"};
+struct rk_client c_d = {.name = "c_d"};
+struct rk_client c_e = {.name = "c_e"};
+struct rk_client c_f = {.name = "c_f"};
+struct rk_client c_g1 = {.name = "c_g1"};
+struct rk_client c_g2 = {.name = "c_g2"};
+
+struct rk_client *clients[] = {&c_root, &c_a, &c_b, &c_c, &c_d, &c_e, &c_f, &c_g1, &c_g2};
+
+void assert_graph_state_optimal(void) {
+  assert_graph_state_legal(&pt);
+  ASSERT_NODE(n_root, c_root.enabled || c_a.enabled || c_b.enabled || c_c.enabled || c_d.enabled || c_e.enabled ||
+                          c_f.enabled || c_g1.enabled || c_g2.enabled);
+  ASSERT_NODE(n_a, c_a.enabled || c_c.enabled || c_d.enabled || c_e.enabled || c_f.enabled || c_g1.enabled ||
+                       c_g2.enabled);
+  ASSERT_NODE(n_b, c_b.enabled || c_e.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled);
+  ASSERT_NODE(n_c, c_c.enabled || c_e.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled);
+  ASSERT_NODE(n_d, c_d.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled);
+  ASSERT_NODE(n_e, c_e.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled);
+  ASSERT_NODE(n_f, c_f.enabled || c_g1.enabled || c_g2.enabled);
+  ASSERT_NODE(n_g, c_g1.enabled || c_g2.enabled);
+}
+
+struct rk_node *failing_node = 0;
+unsigned int cb_calls[sizeof(nodes) / sizeof(nodes[0])] = {0};
+unsigned int cb_enables[sizeof(nodes) / sizeof(nodes[0])] = {0};
+
+int mock_cb_update(const struct rk_node *self) {
+  assert_graph_state_legal(&pt);
+  if (self == failing_node) {
+    return -1;
+  }
+  for (size_t i = 0; i < pt.node_count; i++) {
+    if (pt.nodes[i] == self) {
+      cb_calls[i]++;
+      if (self->desired_state && !self->state) {
+        cb_enables[i]++;
+      }
+      return 0;
+    }
+  }
+  TEST_FAIL(); // Node not in nodes array?!
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_d);
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_child(&n_b, &n_e);
+  rk_node_add_client(&n_a, &c_a);
+  rk_node_add_client(&n_b, &c_b);
+  rk_node_add_client(&n_c, &c_c);
+
+  rk_node_add_child(&n_d, &n_f);
+  rk_node_add_child(&n_c, &n_e);
+  rk_node_add_client(&n_d, &c_d);
+
+  rk_node_add_child(&n_e, &n_f);
+  rk_node_add_client(&n_e, &c_e);
+
+  rk_node_add_child(&n_f, &n_g);
+  rk_node_add_client(&n_f, &c_f);
+
+  rk_node_add_client(&n_g, &c_g1);
+  rk_node_add_client(&n_g, &c_g2);
+}
+
+void reset_cb_counters(void) {
+  memset(cb_calls, 0, sizeof(cb_calls));
+  memset(cb_enables, 0, sizeof(cb_enables));
+}
+
+void assert_cb_called_at_most_once(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    TEST_ASSERT_MESSAGE(cb_calls[i] <= 1, "Callback called more than once during a single batch!");
+  }
+}
+
+// ======== Tests ==================================================================================
+
+void test_apply_enable(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  struct rk_client *enable[] = {&c_g1, &c_b, &c_d, &c_root};
+
+  reset_cb_counters();
+  ASSERT_OK(rk_apply(&pt, enable, 4, 0, 0));
+  assert_graph_state_optimal();
+  assert_cb_called_at_most_once();
+
+  // All nodes are ancestors of c_g1:
+  for (size_t i = 0; i < pt.node_count; i++) {
+    TEST_ASSERT_EQUAL_UINT(1, cb_calls[i]);
+  }
+}
+
+void test_apply_disable(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  struct rk_client *enable[] = {&c_g1, &c_g2, &c_c, &c_a};
+  ASSERT_OK(rk_apply(&pt, enable, 4, 0, 0));
+  assert_graph_state_optimal();
+
+  struct rk_client *disable[] = {&c_g1, &c_g2, &c_a};
+  reset_cb_counters();
+  ASSERT_OK(rk_apply(&pt, 0, 0, disable, 3));
+  assert_graph_state_optimal();
+  assert_cb_called_at_most_once();
+
+  struct rk_client *disable2[] = {&c_c};
+  ASSERT_OK(rk_apply(&pt, 0, 0, disable2, 1));
+  assert_graph_state_optimal();
+}
+
+void test_apply_mixed(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  ASSERT_OK(rk_enable_client(&pt, &c_e));
+  assert_graph_state_optimal();
+
+  // Hand over from c_d/c_e to c_f, which requires the same nodes plus n_f:
+  struct rk_client *enable[] = {&c_f};
+  struct rk_client *disable[] = {&c_d, &c_e};
+  reset_cb_counters();
+  ASSERT_OK(rk_apply(&pt, enable, 1, disable, 2));
+  assert_graph_state_optimal();
+  assert_cb_called_at_most_once();
+  TEST_ASSERT_TRUE(c_f.enabled);
+  TEST_ASSERT_FALSE(c_d.enabled);
+  TEST_ASSERT_FALSE(c_e.enabled);
+}
+
+void test_apply_cancel(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  // A client that is both enabled and disabled in a single batch ends up disabled, and
+  // none of its nodes are enabled along the way:
+  struct rk_client *enable[] = {&c_g1};
+  struct rk_client *disable[] = {&c_g1};
+  reset_cb_counters();
+  ASSERT_OK(rk_apply(&pt, enable, 1, disable, 1));
+  assert_graph_state_optimal();
+  assert_cb_called_at_most_once();
+  TEST_ASSERT_FALSE(c_g1.enabled);
+
+  for (size_t i = 0; i < pt.node_count; i++) {
+    TEST_ASSERT_EQUAL_UINT(0, cb_enables[i]);
+  }
+}
+
+void test_apply_failure(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+
+  struct rk_client *enable[] = {&c_c, &c_g1};
+  struct rk_client *disable[] = {&c_b};
+
+  failing_node = &n_c;
+  ASSERT_ERR(rk_apply(&pt, enable, 2, disable, 1));
+  assert_graph_state_legal(&pt);
+  TEST_ASSERT_FALSE(c_b.enabled);
+  TEST_ASSERT_FALSE(c_c.enabled);
+  TEST_ASSERT_FALSE(c_g1.enabled);
+
+  failing_node = 0;
+  ASSERT_OK(rk_apply(&pt, enable, 2, 0, 0));
+  assert_graph_state_optimal();
+}
+
+void test_apply_nullptr(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  struct rk_client *enable[] = {&c_a, 0};
+  ASSERT_ERR(rk_apply(&pt, enable, 2, 0, 0));
+  ASSERT_ERR(rk_apply(&pt, 0, 1, 0, 0));
+  ASSERT_OK(rk_apply(&pt, 0, 0, 0, 0));
+  assert_graph_state_optimal();
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+  failing_node = 0;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_apply_enable);
+  RUN_TEST(test_apply_disable);
+  RUN_TEST(test_apply_mixed);
+  RUN_TEST(test_apply_cancel);
+  RUN_TEST(test_apply_failure);
+  RUN_TEST(test_apply_nullptr);
+  return UNITY_END();
+}
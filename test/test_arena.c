@@ -0,0 +1,218 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//                  n_root
+//                     |
+//       +------+------+-- ... --+
+//       |      |      |         |
+//      n_0    n_1    n_2  ...  n_299
+//       |      |      |         |
+//      c_0    c_1    c_2  ...  c_299
+//
+// In addition, c_wide depends on n_0 to n_99.
+//
+// All adjacency arrays are allocated from the arena.
+//
+// A second graph is statically initialized, with adjacency arrays provided by compound literals:
+//
+//    s_root
+//      |
+//     s_a
+//      |
+//     s_c
+
+#define FAN_OUT    300
+#define WIDE_COUNT 100
+
+struct rk_node n_root = {.name = "n_root"};
+struct rk_node n_fan[FAN_OUT];
+struct rk_node *nodes[FAN_OUT + 1];
+struct rk_graph pt = {.nodes = nodes, .node_count = FAN_OUT + 1, .root = &n_root};
+
+struct rk_client c_fan[FAN_OUT];
+struct rk_client c_wide = {.name = "c_wide"};
+
+void *arena_buf[4096];
+struct rk_arena arena = {.buf = arena_buf, .size = sizeof(arena_buf)};
+
+extern struct rk_node s_root;
+extern struct rk_node s_a;
+struct rk_client s_c = {.name = "s_c", .parent_count = 1, .parents = (struct rk_node *[]){&s_a}};
+struct rk_node s_root = {.name = "s_root", .child_count = 1, .children = (struct rk_node *[]){&s_a}};
+struct rk_node s_a = {.name = "s_a",
+                      .parent_count = 1,
+                      .parents = (struct rk_node *[]){&s_root},
+                      .client_count = 1,
+                      .clients = (struct rk_client *[]){&s_c}};
+struct rk_node *s_nodes[] = {&s_root, &s_a};
+struct rk_graph s_pt = {.nodes = s_nodes, .node_count = 2, .root = &s_root};
+
+void init_graph(void) {
+  nodes[0] = &n_root;
+  for (size_t i = 0; i < FAN_OUT; i++) {
+    snprintf(n_fan[i].name, sizeof(n_fan[i].name), "n_%zu", i);
+    snprintf(c_fan[i].name, sizeof(c_fan[i].name), "c_%zu", i);
+    nodes[i + 1] = &n_fan[i];
+    TEST_ASSERT_EQUAL(0, rk_node_add_child_arena(&arena, &n_root, &n_fan[i]));
+    TEST_ASSERT_EQUAL(0, rk_node_add_client_arena(&arena, &n_fan[i], &c_fan[i]));
+  }
+  for (size_t i = 0; i < WIDE_COUNT; i++) {
+    TEST_ASSERT_EQUAL(0, rk_node_add_client_arena(&arena, &n_fan[i], &c_wide));
+  }
+}
+
+void assert_graph_state_optimal(void) {
+  assert_graph_state_legal(&pt);
+  bool any = false;
+  for (size_t i = 0; i < FAN_OUT; i++) {
+    ASSERT_NODE(n_fan[i], c_fan[i].enabled || (i < WIDE_COUNT && c_wide.enabled));
+    any = any || c_fan[i].enabled;
+  }
+  ASSERT_NODE(n_root, any || c_wide.enabled);
+}
+
+// ======== Tests ==================================================================================
+
+void test_arena_layout(void) {
+  TEST_ASSERT_EQUAL(FAN_OUT, n_root.child_count);
+  TEST_ASSERT_EQUAL(WIDE_COUNT, c_wide.parent_count);
+  for (size_t i = 0; i < FAN_OUT; i++) {
+    TEST_ASSERT_EQUAL_PTR(&n_fan[i], n_root.children[i]);
+    TEST_ASSERT_EQUAL_PTR(&n_root, n_fan[i].parents[0]);
+    TEST_ASSERT_EQUAL_PTR(&c_fan[i], n_fan[i].clients[0]);
+  }
+  for (size_t i = 0; i < WIDE_COUNT; i++) {
+    TEST_ASSERT_EQUAL_PTR(&n_fan[i], c_wide.parents[i]);
+    TEST_ASSERT_EQUAL_PTR(&c_wide, n_fan[i].clients[1]);
+  }
+
+  // Every array is at most twice its length, and all copies made while growing it are no larger:
+  size_t edges = 2 * FAN_OUT + 2 * WIDE_COUNT;
+  TEST_ASSERT_LESS_OR_EQUAL(2 * (4 * edges) * sizeof(void *), arena.used);
+}
+
+void test_arena_enable_disable(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_fan[250]));
+  assert_graph_state_optimal();
+  ASSERT_OK(rk_enable_client(&pt, &c_wide));
+  assert_graph_state_optimal();
+  ASSERT_OK(rk_disable_client(&pt, &c_fan[250]));
+  assert_graph_state_optimal();
+  ASSERT_OK(rk_disable_client(&pt, &c_wide));
+  assert_graph_state_optimal();
+}
+
+void test_arena_exhausted(void) {
+  struct rk_node n_x = {.name = "n_x"};
+  struct rk_client c_x = {.name = "c_x"};
+
+  // Exhausted arena:
+  struct rk_arena full_arena = {.buf = arena_buf, .size = sizeof(arena_buf), .used = sizeof(arena_buf)};
+  ASSERT_ERR(rk_node_add_client_arena(&full_arena, &n_x, &c_x));
+  TEST_ASSERT_EQUAL(0, n_x.client_count);
+  TEST_ASSERT_EQUAL(0, c_x.parent_count);
+
+  // Without an arena:
+  struct rk_arena no_arena = {0};
+  ASSERT_ERR(rk_node_add_child_arena(&no_arena, &n_x, &n_root));
+  TEST_ASSERT_EQUAL(0, n_x.child_count);
+
+  ASSERT_ERR(rk_node_add_child_arena(&arena, 0, &n_x));
+  ASSERT_ERR(rk_node_add_client_arena(&arena, &n_x, 0));
+}
+
+void test_arena_static_arrays(void) {
+  struct rk_node **a_parents = s_a.parents;
+
+  ASSERT_OK(rk_init(&s_pt));
+  ASSERT_OK(rk_enable_client(&s_pt, &s_c));
+  ASSERT_NODE(s_root, 1);
+  ASSERT_NODE(s_a, 1);
+  ASSERT_OK(rk_disable_client(&s_pt, &s_c));
+  ASSERT_NODE(s_root, 0);
+  ASSERT_NODE(s_a, 0);
+
+  // Statically initialized arrays are full, and are copied into the arena when an edge is added:
+  struct rk_node s_b = {.name = "s_b"};
+  ASSERT_OK(rk_node_add_child_arena(&arena, &s_b, &s_a));
+  TEST_ASSERT_EQUAL(2, s_a.parent_count);
+  TEST_ASSERT_NOT_EQUAL(a_parents, s_a.parents);
+  TEST_ASSERT_EQUAL_PTR(&s_root, s_a.parents[0]);
+  TEST_ASSERT_EQUAL_PTR(&s_b, s_a.parents[1]);
+  TEST_ASSERT_EQUAL_PTR(&s_root, a_parents[0]);
+}
+
+void test_arena_graph_arena(void) {
+  void *g_buf[64];
+  struct rk_arena g_arena = {.buf = g_buf, .size = sizeof(g_buf)};
+  struct rk_node g_root = {.name = "g_root"};
+  struct rk_node g_a = {.name = "g_a"};
+  struct rk_client g_c = {.name = "g_c"};
+  struct rk_node *g_nodes[2] = {&g_root};
+  struct rk_graph g_pt = {.nodes = g_nodes, .node_count = 1, .node_capacity = 2, .root = &g_root, .arena = &g_arena};
+
+  // Edges added to an initialized graph without an arena are allocated from the graph's arena:
+  ASSERT_OK(rk_init(&g_pt));
+  ASSERT_OK(rk_graph_add_child(&g_pt, 0, &g_root, &g_a));
+  ASSERT_OK(rk_graph_add_client(&g_pt, 0, &g_a, &g_c));
+  TEST_ASSERT_EQUAL(2, g_pt.node_count);
+  TEST_ASSERT_EQUAL(4 * sizeof(void *), g_arena.used);
+
+  ASSERT_OK(rk_enable_client(&g_pt, &g_c));
+  ASSERT_NODE(g_root, 1);
+  ASSERT_NODE(g_a, 1);
+}
+
+void test_arena_default_reset(void) {
+  struct rk_node n_x = {.name = "n_x"};
+  struct rk_client c_x = {.name = "c_x"};
+
+  // Exhaust the default arena:
+  int err = 0;
+  for (size_t i = 0; i < RK_DEFAULT_ARENA_SIZE && err == 0; i++) {
+    err = rk_node_add_client(&n_x, &c_x);
+  }
+  TEST_ASSERT_EQUAL(RK_ERR, err);
+
+  // Once nothing refers to its memory anymore, the default arena can be reset:
+  memset(&n_x, 0, sizeof(n_x));
+  memset(&c_x, 0, sizeof(c_x));
+  rk_default_arena_reset();
+  ASSERT_OK(rk_node_add_client(&n_x, &c_x));
+  TEST_ASSERT_EQUAL(1, n_x.client_count);
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  n_root.state = false;
+  c_wide.enabled = false;
+  for (size_t i = 0; i < FAN_OUT; i++) {
+    n_fan[i].state = false;
+    c_fan[i].enabled = false;
+  }
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  UNITY_BEGIN();
+  init_graph();
+  RUN_TEST(test_arena_layout);
+  RUN_TEST(test_arena_enable_disable);
+  RUN_TEST(test_arena_exhausted);
+  RUN_TEST(test_arena_static_arrays);
+  RUN_TEST(test_arena_graph_arena);
+  RUN_TEST(test_arena_default_reset);
+  return UNITY_END();
+}
@@ -0,0 +1,270 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//          n_c        |
+//           |         |
+//           +---+ +---+
+//               | |
+//               n_d
+//
+// All nodes have a single, identically named client (n_root -> c_root, n_a -> c_a etc).
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+#define N_ROOT 0
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+#define N_A 1
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+#define N_B 2
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+#define N_C 3
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+#define N_D 4
+struct rk_node n_d = {.name = "n_d", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {[N_ROOT] = &n_root, [N_A] = &n_a, [N_B] = &n_b, [N_C] = &n_c, [N_D] = &n_d};
+struct rk_graph pt = {.nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_b = {.name = "c_b"};
+struct rk_client c_c = {.name = "c_c"};
+struct rk_client c_d = {.name = "c_d"};
+
+struct rk_client *clients[] = {&c_root, &c_a, &c_b, &c_c, &c_d};
+
+void assert_graph_state_optimal(void) {
+  assert_graph_state_legal(&pt);
+  ASSERT_NODE(n_root, c_root.enabled || c_a.enabled || c_b.enabled || c_c.enabled || c_d.enabled);
+  ASSERT_NODE(n_a, c_a.enabled || c_c.enabled || c_d.enabled);
+  ASSERT_NODE(n_b, c_b.enabled || c_d.enabled);
+  ASSERT_NODE(n_c, c_c.enabled || c_d.enabled);
+  ASSERT_NODE(n_d, c_d.enabled);
+}
+
+// Nodes whose callbacks complete asynchronously:
+bool node_slow[sizeof(nodes) / sizeof(nodes[0])] = {0};
+
+// Error codes returned by the callbacks of nodes that do not complete asynchronously:
+int node_err[sizeof(nodes) / sizeof(nodes[0])] = {0};
+
+// Nodes whose callbacks have been started:
+bool node_cb_started[sizeof(nodes) / sizeof(nodes[0])] = {0};
+
+int mock_cb_update(const struct rk_node *self) {
+  assert_graph_state_legal(&pt);
+  for (size_t i = 0; i < pt.node_count; i++) {
+    if (pt.nodes[i] == self) {
+      node_cb_started[i] = true;
+      return node_slow[i] ? RK_PENDING : node_err[i];
+    }
+  }
+  TEST_FAIL(); // Node not in nodes array?!
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_client(&n_a, &c_a);
+
+  rk_node_add_child(&n_b, &n_d);
+  rk_node_add_client(&n_b, &c_b);
+
+  rk_node_add_child(&n_c, &n_d);
+  rk_node_add_client(&n_c, &c_c);
+
+  rk_node_add_client(&n_d, &c_d);
+}
+
+// ======== Tests ==================================================================================
+
+void test_async_enable_overlaps(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  node_slow[N_A] = true;
+  node_slow[N_B] = true;
+
+  struct rk_client *enable[] = {&c_c, &c_b};
+  TEST_ASSERT_EQUAL_INT(RK_PENDING, rk_apply(&pt, enable, 2, 0, 0));
+
+  // Both independent slow updates are in flight at the same time:
+  TEST_ASSERT_TRUE(node_cb_started[N_A]);
+  TEST_ASSERT_TRUE(node_cb_started[N_B]);
+  TEST_ASSERT_FALSE(node_cb_started[N_C]);
+  ASSERT_NODE(n_root, 1);
+  ASSERT_NODE(n_a, 0);
+  ASSERT_NODE(n_b, 0);
+
+  TEST_ASSERT_EQUAL_INT(RK_PENDING, rk_node_complete(&pt, &n_b, 0));
+  ASSERT_NODE(n_b, 1);
+  TEST_ASSERT_FALSE(c_b.enabled);
+
+  // Completing n_a releases n_c, which completes the request:
+  ASSERT_OK(rk_node_complete(&pt, &n_a, 0));
+  TEST_ASSERT_TRUE(node_cb_started[N_C]);
+  TEST_ASSERT_TRUE(c_b.enabled);
+  TEST_ASSERT_TRUE(c_c.enabled);
+  assert_graph_state_optimal();
+}
+
+void test_async_disable(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  assert_graph_state_optimal();
+  memset(node_cb_started, 0, sizeof(node_cb_started));
+
+  node_slow[N_D] = true;
+  node_slow[N_B] = true;
+
+  struct rk_client *disable[] = {&c_d};
+  TEST_ASSERT_EQUAL_INT(RK_PENDING, rk_apply(&pt, 0, 0, disable, 1));
+
+  // Only n_d can be disabled until it has completed:
+  TEST_ASSERT_TRUE(node_cb_started[N_D]);
+  TEST_ASSERT_FALSE(node_cb_started[N_B]);
+  TEST_ASSERT_FALSE(node_cb_started[N_C]);
+
+  TEST_ASSERT_EQUAL_INT(RK_PENDING, rk_node_complete(&pt, &n_d, 0));
+  TEST_ASSERT_TRUE(node_cb_started[N_B]);
+  TEST_ASSERT_TRUE(node_cb_started[N_C]);
+  TEST_ASSERT_TRUE(node_cb_started[N_A]);
+  TEST_ASSERT_FALSE(node_cb_started[N_ROOT]);
+
+  ASSERT_OK(rk_node_complete(&pt, &n_b, 0));
+  assert_graph_state_optimal();
+}
+
+void test_async_busy(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  node_slow[N_ROOT] = true;
+
+  struct rk_client *enable[] = {&c_a};
+  TEST_ASSERT_EQUAL_INT(RK_PENDING, rk_apply(&pt, enable, 1, 0, 0));
+
+  // Graph cannot be used until the request completed:
+  ASSERT_ERR(rk_enable_client(&pt, &c_b));
+  ASSERT_ERR(rk_disable_client(&pt, &c_b));
+  ASSERT_ERR(rk_optimize(&pt));
+  ASSERT_ERR(rk_init(&pt));
+  ASSERT_ERR(rk_apply(&pt, enable, 1, 0, 0));
+
+  // Only nodes with a pending update can be completed:
+  ASSERT_ERR(rk_node_complete(&pt, &n_a, 0));
+
+  ASSERT_OK(rk_node_complete(&pt, &n_root, 0));
+  ASSERT_ERR(rk_node_complete(&pt, &n_root, 0));
+  assert_graph_state_optimal();
+}
+
+void test_async_failure(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  node_slow[N_A] = true;
+  node_slow[N_B] = true;
+
+  struct rk_client *enable[] = {&c_c, &c_b};
+  TEST_ASSERT_EQUAL_INT(RK_PENDING, rk_apply(&pt, enable, 2, 0, 0));
+
+  // Failure of n_a cancels n_c, but n_b still completes:
+  TEST_ASSERT_EQUAL_INT(RK_PENDING, rk_node_complete(&pt, &n_a, -1));
+  TEST_ASSERT_EQUAL_INT(-1, rk_node_complete(&pt, &n_b, 0));
+  TEST_ASSERT_FALSE(node_cb_started[N_C]);
+  ASSERT_NODE(n_a, 0);
+  ASSERT_NODE(n_b, 1);
+  ASSERT_NODE(n_c, 0);
+  TEST_ASSERT_FALSE(c_b.enabled);
+  TEST_ASSERT_FALSE(c_c.enabled);
+  assert_graph_state_legal(&pt);
+
+  // Graph is usable again:
+  node_slow[N_A] = false;
+  node_slow[N_B] = false;
+  ASSERT_OK(rk_apply(&pt, enable, 2, 0, 0));
+  ASSERT_OK(rk_optimize(&pt));
+  assert_graph_state_optimal();
+}
+
+void test_async_pending_outside_apply(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  // RK_PENDING is treated as an error by all synchronous functions:
+  node_slow[N_A] = true;
+  ASSERT_ERR(rk_enable_client(&pt, &c_a));
+  ASSERT_NODE(n_a, 0);
+  TEST_ASSERT_FALSE(c_a.enabled);
+  assert_graph_state_legal(&pt);
+}
+
+void test_async_user_error_codes(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  // Small user error codes are passed through unchanged, and are never mistaken for RK_PENDING:
+  node_err[N_A] = 2;
+  TEST_ASSERT_EQUAL_INT(2, rk_enable_client(&pt, &c_a));
+  ASSERT_NODE(n_a, 0);
+  TEST_ASSERT_FALSE(c_a.enabled);
+
+  struct rk_client *enable[] = {&c_a};
+  TEST_ASSERT_EQUAL_INT(2, rk_apply(&pt, enable, 1, 0, 0));
+  ASSERT_NODE(n_a, 0);
+  TEST_ASSERT_FALSE(c_a.enabled);
+  assert_graph_state_legal(&pt);
+
+  // The graph is not left busy:
+  node_err[N_A] = 0;
+  ASSERT_OK(rk_apply(&pt, enable, 1, 0, 0));
+  ASSERT_NODE(n_a, 1);
+  TEST_ASSERT_TRUE(c_a.enabled);
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+  memset(node_slow, 0, sizeof(node_slow));
+  memset(node_err, 0, sizeof(node_err));
+  memset(node_cb_started, 0, sizeof(node_cb_started));
+
+  // Abandon any request left unfinished by a failed test:
+  pt.req_remaining = 0;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_async_enable_overlaps);
+  RUN_TEST(test_async_disable);
+  RUN_TEST(test_async_busy);
+  RUN_TEST(test_async_failure);
+  RUN_TEST(test_async_pending_outside_apply);
+  RUN_TEST(test_async_user_error_codes);
+  return UNITY_END();
+}
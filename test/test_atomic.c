@@ -0,0 +1,227 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =====================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//       +---+---+     |
+//       |       |     |
+//      n_d     n_c    |
+//       |       |     |
+//       |       +-+ +-+
+//       |         | |
+//       |         n_e
+//       |          |
+//       +----+ +---+
+//            | |
+//            n_f
+//             |
+//            n_g
+//
+// All nodes have a single, identically named client (n_root -> c_root, n_a -> c_a etc),
+// except n_g, which has two (c_g1, c_g2). In addition, there is c_many, which has
+// parents n_a, n_d, and n_e.
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+struct rk_node n_d = {.name = "n_d", .cb_update = mock_cb_update};
+struct rk_node n_e = {.name = "n_e", .cb_update = mock_cb_update};
+struct rk_node n_f = {.name = "n_f", .cb_update = mock_cb_update};
+struct rk_node n_g = {.name = "n_g", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {&n_root, &n_a, &n_b, &n_c, &n_d, &n_e, &n_f, &n_g};
+struct rk_graph pt = {.nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_b = {.name = "c_b"};
+struct rk_client c_c = {.name = "c_c"};
+struct rk_client c_d = {.name = "c_d"};
+struct rk_client c_e = {.name = "c_e"};
+struct rk_client c_f = {.name = "c_f"};
+struct rk_client c_g1 = {.name = "c_g1"};
+struct rk_client c_g2 = {.name = "c_g2"};
+struct rk_client c_many = {.name = "c_many"};
+
+struct rk_client *clients[] = {&c_root, &c_a, &c_b, &c_c, &c_d, &c_e, &c_f, &c_g1, &c_g2, &c_many};
+
+void assert_graph_state_optimal(void) {
+  assert_graph_state_legal(&pt);
+  ASSERT_NODE(n_root, c_root.enabled || c_a.enabled || c_b.enabled || c_c.enabled || c_d.enabled || c_e.enabled ||
+                          c_f.enabled || c_g1.enabled || c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_a, c_a.enabled || c_c.enabled || c_d.enabled || c_e.enabled || c_f.enabled || c_g1.enabled ||
+                       c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_b, c_b.enabled || c_e.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_c, c_c.enabled || c_e.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_d, c_d.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_e, c_e.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_f, c_f.enabled || c_g1.enabled || c_g2.enabled);
+
+  ASSERT_NODE(n_g, c_g1.enabled || c_g2.enabled);
+}
+
+// Node whose callback fails when asked to enable/disable the node:
+struct rk_node *fail_enable = 0;
+struct rk_node *fail_disable = 0;
+
+int mock_cb_update(const struct rk_node *self) {
+  assert_graph_state_legal(&pt);
+  if (self->desired_state && self == fail_enable) {
+    return -1;
+  }
+  if (!self->desired_state && self == fail_disable) {
+    return -1;
+  }
+  return 0;
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_d);
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_child(&n_b, &n_e);
+  rk_node_add_client(&n_a, &c_a);
+  rk_node_add_client(&n_a, &c_many);
+  rk_node_add_client(&n_b, &c_b);
+  rk_node_add_client(&n_c, &c_c);
+
+  rk_node_add_child(&n_d, &n_f);
+  rk_node_add_child(&n_c, &n_e);
+  rk_node_add_client(&n_d, &c_d);
+  rk_node_add_client(&n_d, &c_many);
+
+  rk_node_add_child(&n_e, &n_f);
+  rk_node_add_client(&n_e, &c_e);
+  rk_node_add_client(&n_e, &c_many);
+
+  rk_node_add_child(&n_f, &n_g);
+  rk_node_add_client(&n_f, &c_f);
+
+  rk_node_add_client(&n_g, &c_g1);
+  rk_node_add_client(&n_g, &c_g2);
+}
+
+// ======== Tests ==================================================================================
+
+void test_atomic_ok(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client_atomic(&pt, &c_g1));
+  assert_graph_state_optimal();
+  ASSERT_OK(rk_enable_client_atomic(&pt, &c_b));
+  assert_graph_state_optimal();
+  ASSERT_OK(rk_disable_client(&pt, &c_g1));
+  assert_graph_state_optimal();
+}
+
+void test_atomic_rollback(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  fail_enable = &n_f;
+  ASSERT_ERR(rk_enable_client_atomic(&pt, &c_g1));
+  TEST_ASSERT_FALSE(c_g1.enabled);
+  assert_graph_state_optimal();
+
+  fail_enable = 0;
+  ASSERT_OK(rk_enable_client_atomic(&pt, &c_g1));
+  assert_graph_state_optimal();
+}
+
+void test_atomic_rollback_partial(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  assert_graph_state_optimal();
+
+  // Only the nodes enabled during the failed call are disabled again:
+  fail_enable = &n_e;
+  ASSERT_ERR(rk_enable_client_atomic(&pt, &c_f));
+  assert_graph_state_optimal();
+  ASSERT_NODE(n_b, 1);
+  ASSERT_NODE(n_d, 1);
+}
+
+void test_atomic_rollback_many_parents(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  // c_many's first parents are successfully enabled before its last one fails:
+  fail_enable = &n_e;
+  ASSERT_ERR(rk_enable_client_atomic(&pt, &c_many));
+  TEST_ASSERT_FALSE(c_many.enabled);
+  assert_graph_state_optimal();
+}
+
+void test_atomic_rollback_failure(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  // If a node cannot be disabled during rollback, it and its parents are left on:
+  fail_enable = &n_f;
+  fail_disable = &n_d;
+  ASSERT_ERR(rk_enable_client_atomic(&pt, &c_f));
+  assert_graph_state_legal(&pt);
+  ASSERT_NODE(n_root, 1);
+  ASSERT_NODE(n_a, 1);
+  ASSERT_NODE(n_d, 1);
+  ASSERT_NODE(n_b, 0);
+  ASSERT_NODE(n_c, 0);
+  ASSERT_NODE(n_e, 0);
+  ASSERT_NODE(n_f, 0);
+
+  fail_enable = 0;
+  fail_disable = 0;
+  ASSERT_OK(rk_optimize(&pt));
+  assert_graph_state_optimal();
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+  fail_enable = 0;
+  fail_disable = 0;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_atomic_ok);
+  RUN_TEST(test_atomic_rollback);
+  RUN_TEST(test_atomic_rollback_partial);
+  RUN_TEST(test_atomic_rollback_many_parents);
+  RUN_TEST(test_atomic_rollback_failure);
+  return UNITY_END();
+}
@@ -0,0 +1,229 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//                  n_root
+//                     |
+//       +------+------+-- ... --+
+//       |      |      |         |
+//     n_r0   n_r1   n_r2  ... n_r99
+//       |      |      |         |
+//     n_l0   n_l1   n_l2  ... n_l99
+//       |      |      |         |
+//      c_0    c_1    c_2  ...  c_99
+//
+// In addition, every rail n_ri has the leaf n_l(i+1) as a child (and n_r99 has n_l0), so that every
+// leaf has two parents. The 201 nodes span multiple bitset words.
+
+#define RAIL_COUNT 100
+#define NODE_COUNT (2 * RAIL_COUNT + 1)
+
+int mock_cb_update(const struct rk_node *self);
+
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_rail[RAIL_COUNT];
+struct rk_node n_leaf[RAIL_COUNT];
+struct rk_node *nodes[NODE_COUNT];
+
+struct rk_client c_leaf[RAIL_COUNT];
+
+void *arena_buf[4096];
+struct rk_arena arena = {.buf = arena_buf, .size = sizeof(arena_buf)};
+
+// Bitsets: 4 words per bitset.
+#define BITSET_SIZE ((2 + RAIL_COUNT) * 4 * sizeof(uint64_t) + (NODE_COUNT + RAIL_COUNT) * sizeof(void *))
+uint64_t bitset_buf[(BITSET_SIZE + 7) / 8];
+struct rk_bitset bitset = {.buf = bitset_buf, .buf_size = BITSET_SIZE};
+
+struct rk_graph pt = {.nodes = nodes, .node_count = NODE_COUNT, .root = &n_root, .bitset = &bitset};
+
+// MOCK:
+struct rk_node *failing_node = 0;
+size_t cb_calls = 0;
+
+int mock_cb_update(const struct rk_node *self) {
+  cb_calls++;
+  return self == failing_node ? -1 : 0;
+}
+
+void init_graph(void) {
+  // Nodes are listed leaves first, to ensure the node list order differs from the topological order:
+  nodes[NODE_COUNT - 1] = &n_root;
+  for (size_t i = 0; i < RAIL_COUNT; i++) {
+    snprintf(n_rail[i].name, sizeof(n_rail[i].name), "n_r%zu", i);
+    snprintf(n_leaf[i].name, sizeof(n_leaf[i].name), "n_l%zu", i);
+    snprintf(c_leaf[i].name, sizeof(c_leaf[i].name), "c_%zu", i);
+    n_rail[i].cb_update = mock_cb_update;
+    n_leaf[i].cb_update = mock_cb_update;
+    nodes[i] = &n_leaf[i];
+    nodes[RAIL_COUNT + i] = &n_rail[i];
+  }
+
+  for (size_t i = 0; i < RAIL_COUNT; i++) {
+    TEST_ASSERT_EQUAL(0, rk_node_add_child_arena(&arena, &n_root, &n_rail[i]));
+    TEST_ASSERT_EQUAL(0, rk_node_add_child_arena(&arena, &n_rail[i], &n_leaf[i]));
+    TEST_ASSERT_EQUAL(0, rk_node_add_child_arena(&arena, &n_rail[i], &n_leaf[(i + 1) % RAIL_COUNT]));
+    TEST_ASSERT_EQUAL(0, rk_node_add_client_arena(&arena, &n_leaf[i], &c_leaf[i]));
+  }
+}
+
+void assert_graph_state_optimal(void) {
+  assert_graph_state_legal(&pt);
+  bool any = false;
+  for (size_t i = 0; i < RAIL_COUNT; i++) {
+    ASSERT_NODE(n_leaf[i], c_leaf[i].enabled);
+    ASSERT_NODE(n_rail[i], c_leaf[i].enabled || c_leaf[(i + 1) % RAIL_COUNT].enabled);
+    any = any || c_leaf[i].enabled;
+  }
+  ASSERT_NODE(n_root, any);
+}
+
+uint32_t rng_state = 1;
+
+uint32_t rng(void) {
+  rng_state = rng_state * 1103515245u + 12345u;
+  return rng_state >> 16;
+}
+
+// ======== Tests ==================================================================================
+
+void test_bitset_size(void) {
+  TEST_ASSERT_EQUAL(BITSET_SIZE, rk_bitset_size(&pt));
+  TEST_ASSERT_EQUAL(0, rk_bitset_size(0));
+
+  ASSERT_OK(rk_init(&pt));
+  TEST_ASSERT_EQUAL(4, bitset.word_count);
+  TEST_ASSERT_EQUAL(RAIL_COUNT, bitset.client_count);
+
+  bitset.buf_size = BITSET_SIZE - 1;
+  ASSERT_ERR(rk_init(&pt));
+  bitset.buf_size = BITSET_SIZE;
+}
+
+void test_bitset_optimal(void) {
+  ASSERT_OK(rk_init(&pt));
+  for (size_t i = 0; i < RAIL_COUNT; i += 3) {
+    ASSERT_OK(rk_enable_client(&pt, &c_leaf[i]));
+  }
+  assert_graph_state_optimal();
+
+  // Nothing to do:
+  cb_calls = 0;
+  ASSERT_OK(rk_optimize(&pt));
+  TEST_ASSERT_EQUAL(0, cb_calls);
+  assert_graph_state_optimal();
+}
+
+void test_bitset_init_state(void) {
+  // Leaf 70 and its parents are enabled without an enabled client:
+  n_root.state = true;
+  n_rail[69].state = true;
+  n_rail[70].state = true;
+  n_leaf[70].state = true;
+  ASSERT_OK(rk_init(&pt));
+
+  cb_calls = 0;
+  ASSERT_OK(rk_optimize(&pt));
+  TEST_ASSERT_EQUAL(4, cb_calls);
+  assert_graph_state_optimal();
+}
+
+void test_bitset_changed_state(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_leaf[20]));
+
+  // States changed after initialization are re-derived by rk_optimize():
+  n_rail[50].state = true;
+  c_leaf[19].enabled = true;
+  n_leaf[19].state = true;
+  n_rail[18].state = true;
+
+  cb_calls = 0;
+  ASSERT_OK(rk_optimize(&pt));
+  TEST_ASSERT_EQUAL(1, cb_calls);
+  assert_graph_state_optimal();
+
+  // Counters are correct afterwards:
+  ASSERT_OK(rk_disable_client(&pt, &c_leaf[19]));
+  ASSERT_OK(rk_disable_client(&pt, &c_leaf[20]));
+  assert_graph_state_optimal();
+  ASSERT_NODE(n_root, false);
+}
+
+void test_bitset_failures(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  for (size_t round = 0; round < 200; round++) {
+    struct rk_client *client = &c_leaf[rng() % RAIL_COUNT];
+
+    // Occasionally fail a node while disabling, leaving it and its parents enabled:
+    if (client->enabled) {
+      if (rng() % 4 == 0) {
+        failing_node = client->parents[0];
+        ASSERT_ERR(rk_disable_client(&pt, client));
+        failing_node = 0;
+
+        ASSERT_OK(rk_optimize(&pt));
+      } else {
+        ASSERT_OK(rk_disable_client(&pt, client));
+      }
+    } else {
+      ASSERT_OK(rk_enable_client(&pt, client));
+    }
+
+    assert_graph_state_optimal();
+  }
+}
+
+void test_bitset_failing_optimize(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_leaf[10]));
+
+  failing_node = &n_leaf[10];
+  ASSERT_ERR(rk_disable_client(&pt, &c_leaf[10]));
+
+  // Leaf fails again, so its parents must remain enabled:
+  ASSERT_ERR(rk_optimize(&pt));
+  assert_graph_state_legal(&pt);
+  ASSERT_NODE(n_leaf[10], true);
+  ASSERT_NODE(n_rail[9], true);
+  ASSERT_NODE(n_rail[10], true);
+
+  failing_node = 0;
+  ASSERT_OK(rk_optimize(&pt));
+  assert_graph_state_optimal();
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < RAIL_COUNT; i++) {
+    c_leaf[i].enabled = false;
+  }
+  failing_node = 0;
+  cb_calls = 0;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_bitset_size);
+  RUN_TEST(test_bitset_optimal);
+  RUN_TEST(test_bitset_init_state);
+  RUN_TEST(test_bitset_changed_state);
+  RUN_TEST(test_bitset_failures);
+  RUN_TEST(test_bitset_failing_optimize);
+  return UNITY_END();
+}
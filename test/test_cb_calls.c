@@ -97,7 +97,7 @@ void assert_correct_callbacks_called(bool *is, bool *expected, size_t len) {
 // ======== Tests ==================================================================================
 
 // Test that enabeling a client only causes the callback of nodes that the client
-// depends on to get called:
+// depends on to get called. Nodes above a node that is already enabled are not updated:
 
 void test_cb_calls_enable1(void) {
   ASSERT_OK(rk_init(&pt));
@@ -128,7 +128,7 @@ void test_cb_calls_enable3(void) {
 
   memset(node_cb_called, 0, sizeof(node_cb_called));
   ASSERT_OK(rk_enable_client(&pt, &c_d));
-  bool expected[] = {[N_ROOT] = true, [N_A] = true, [N_B] = true, [N_C] = true, [N_D] = true};
+  bool expected[] = {[N_ROOT] = false, [N_A] = false, [N_B] = true, [N_C] = true, [N_D] = true};
   assert_correct_callbacks_called(node_cb_called, expected, pt.node_count);
 }
 
@@ -143,19 +143,19 @@ void test_cb_calls_enable4(void) {
 
   memset(node_cb_called, 0, sizeof(node_cb_called));
   ASSERT_OK(rk_enable_client(&pt, &c_d));
-  bool expected[] = {[N_ROOT] = true, [N_A] = true, [N_B] = true, [N_C] = true, [N_D] = true};
+  bool expected[] = {[N_ROOT] = false, [N_A] = false, [N_B] = false, [N_C] = false, [N_D] = true};
   assert_correct_callbacks_called(node_cb_called, expected, pt.node_count);
 }
 
 // Test that disabling a client only causes the callback of nodes that the client
-// depends on to get called:
+// depends on to get called. Nodes that remain required, and all nodes above them, are not updated:
 
 void test_cb_calls_disable1(void) {
   ASSERT_OK(rk_init(&pt));
 
   memset(node_cb_called, 0, sizeof(node_cb_called));
   ASSERT_OK(rk_disable_client(&pt, &c_root));
-  bool expected[] = {[N_ROOT] = true, [N_A] = false, [N_B] = false, [N_C] = false, [N_D] = false};
+  bool expected[] = {[N_ROOT] = false, [N_A] = false, [N_B] = false, [N_C] = false, [N_D] = false};
   assert_correct_callbacks_called(node_cb_called, expected, pt.node_count);
 }
 
@@ -173,15 +173,20 @@ void test_cb_calls_disable2(void) {
 void test_cb_calls_disable3(void) {
   ASSERT_OK(rk_init(&pt));
 
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+
   memset(node_cb_called, 0, sizeof(node_cb_called));
   ASSERT_OK(rk_disable_client(&pt, &c_c));
-  bool expected[] = {[N_ROOT] = true, [N_A] = true, [N_B] = false, [N_C] = true, [N_D] = false};
+  bool expected[] = {[N_ROOT] = false, [N_A] = true, [N_B] = false, [N_C] = true, [N_D] = false};
   assert_correct_callbacks_called(node_cb_called, expected, pt.node_count);
 }
 
 void test_cb_calls_disable4(void) {
   ASSERT_OK(rk_init(&pt));
 
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+
   memset(node_cb_called, 0, sizeof(node_cb_called));
   ASSERT_OK(rk_disable_client(&pt, &c_d));
   bool expected[] = {[N_ROOT] = true, [N_A] = true, [N_B] = true, [N_C] = true, [N_D] = true};
@@ -0,0 +1,257 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =====================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//       +---+---+     |
+//       |       |     |
+//      n_d     n_c    |
+//       |       |     |
+//       |       +-+ +-+
+//       |         | |
+//       |         n_e
+//       |          |
+//       +----+ +---+
+//            | |
+//            n_f
+//             |
+//            n_g
+//
+// All nodes have a single, identically named client (n_root -> c_root, n_a -> c_a etc),
+// except n_g, which has two (c_g1, c_g2). In addition, there is c_many, which has
+// parents n_a, n_d, and n_e.
+//
+// The graph is compiled. The node list is deliberately not in topological order.
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+struct rk_node n_d = {.name = "n_d", .cb_update = mock_cb_update};
+struct rk_node n_e = {.name = "n_e", .cb_update = mock_cb_update};
+struct rk_node n_f = {.name = "n_f", .cb_update = mock_cb_update};
+struct rk_node n_g = {.name = "n_g", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {&n_g, &n_c, &n_root, &n_f, &n_b, &n_e, &n_a, &n_d};
+
+// Compiled graph:
+void *csr_buf[32];
+struct rk_csr csr = {.buf = csr_buf, .buf_size = sizeof(csr_buf)};
+
+struct rk_graph pt = {.nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root, .csr = &csr};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_b = {.name = "c_b"};
+struct rk_client c_c = {.name = "c_c"};
+struct rk_client c_d = {.name = "c_d"};
+struct rk_client c_e = {.name = "c_e"};
+struct rk_client c_f = {.name = "c_f"};
+struct rk_client c_g1 = {.name = "c_g1"};
+struct rk_client c_g2 = {.name = "c_g2"};
+struct rk_client c_many = {.name = "c_many"};
+
+struct rk_client *clients[] = {
+    &c_root, &c_a, &c_b, &c_c, &c_d, &c_e, &c_f, &c_g1, &c_g2, &c_many,
+};
+
+#define CLIENT_COUNT (sizeof(clients) / sizeof(clients[0]))
+
+struct rk_node *failing_node = 0;
+
+void assert_graph_state_optimal(void) {
+  assert_graph_state_legal(&pt);
+  ASSERT_NODE(n_root, c_root.enabled || c_a.enabled || c_b.enabled || c_c.enabled || c_d.enabled || c_e.enabled ||
+                          c_f.enabled || c_g1.enabled || c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_a, c_a.enabled || c_c.enabled || c_d.enabled || c_e.enabled || c_f.enabled || c_g1.enabled ||
+                       c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_b, c_b.enabled || c_e.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_c, c_c.enabled || c_e.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_d, c_d.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_e, c_e.enabled || c_f.enabled || c_g1.enabled || c_g2.enabled || c_many.enabled);
+
+  ASSERT_NODE(n_f, c_f.enabled || c_g1.enabled || c_g2.enabled);
+
+  ASSERT_NODE(n_g, c_g1.enabled || c_g2.enabled);
+}
+
+int mock_cb_update(const struct rk_node *self) {
+  assert_graph_state_legal(&pt);
+  return self == failing_node ? -1 : 0;
+}
+
+void init_graph(void) {
+
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_d);
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_child(&n_b, &n_e);
+  rk_node_add_client(&n_a, &c_a);
+  rk_node_add_client(&n_a, &c_many);
+  rk_node_add_client(&n_b, &c_b);
+  rk_node_add_client(&n_c, &c_c);
+
+  rk_node_add_child(&n_d, &n_f);
+  rk_node_add_child(&n_c, &n_e);
+  rk_node_add_client(&n_d, &c_d);
+  rk_node_add_client(&n_d, &c_many);
+  rk_node_add_client(&n_c, &c_c);
+
+  rk_node_add_child(&n_e, &n_f);
+  rk_node_add_client(&n_e, &c_e);
+  rk_node_add_client(&n_e, &c_many);
+
+  rk_node_add_child(&n_f, &n_g);
+  rk_node_add_client(&n_f, &c_f);
+
+  rk_node_add_client(&n_g, &c_g1);
+  rk_node_add_client(&n_g, &c_g2);
+}
+
+// ======== Tests ==================================================================================
+
+void test_csr_compile(void) {
+  size_t size = rk_csr_size(&pt);
+  TEST_ASSERT_GREATER_THAN(0, size);
+  TEST_ASSERT_LESS_OR_EQUAL(sizeof(csr_buf), size);
+
+  // Buffer too small:
+  csr.buf_size = size - 1;
+  ASSERT_ERR(rk_init(&pt));
+  csr.buf_size = sizeof(csr_buf);
+
+  ASSERT_OK(rk_init(&pt));
+  TEST_ASSERT_FALSE(csr.wide);
+
+  // All nodes are numbered in topological order:
+  for (size_t idx = 0; idx < pt.node_count; idx++) {
+    struct rk_node *node = csr.order[idx];
+    TEST_ASSERT_EQUAL(idx, node->ctx.topo_rank);
+    for (size_t i = 0; i < node->parent_count; i++) {
+      TEST_ASSERT_LESS_THAN(idx, node->parents[i]->ctx.topo_rank);
+    }
+  }
+  TEST_ASSERT_EQUAL_PTR(&n_root, csr.order[0]);
+  TEST_ASSERT_EQUAL_PTR(&n_g, csr.order[pt.node_count - 1]);
+
+  TEST_ASSERT_EQUAL(0, rk_csr_size(0));
+}
+
+void test_csr_all_configurations(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  // Visit all configurations of enabled clients, changing a single client every step (gray code):
+  for (unsigned int i = 1; i < (1u << CLIENT_COUNT); i++) {
+    struct rk_client *client = clients[__builtin_ctz(i)];
+    if (client->enabled) {
+      ASSERT_OK(rk_disable_client(&pt, client));
+    } else {
+      ASSERT_OK(rk_enable_client(&pt, client));
+    }
+    assert_graph_state_optimal();
+  }
+}
+
+void test_csr_apply(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  struct rk_client *enable_list[] = {&c_g1, &c_many, &c_b};
+  ASSERT_OK(rk_apply(&pt, enable_list, 3, 0, 0));
+  assert_graph_state_optimal();
+
+  struct rk_client *disable_list[] = {&c_g1, &c_b};
+  struct rk_client *enable_list2[] = {&c_c};
+  ASSERT_OK(rk_apply(&pt, enable_list2, 1, disable_list, 2));
+  assert_graph_state_optimal();
+  TEST_ASSERT_TRUE(c_c.enabled);
+  TEST_ASSERT_FALSE(c_g1.enabled);
+}
+
+void test_csr_atomic(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  failing_node = &n_f;
+  ASSERT_ERR(rk_enable_client_atomic(&pt, &c_g1));
+  failing_node = 0;
+  assert_graph_state_optimal();
+  ASSERT_NODE(n_root, 0);
+
+  ASSERT_OK(rk_enable_client_atomic(&pt, &c_g1));
+  assert_graph_state_optimal();
+}
+
+void test_csr_optimize(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = true;
+  }
+  c_d.enabled = true;
+
+  assert_graph_state_legal(&pt);
+  ASSERT_OK(rk_optimize(&pt));
+  assert_graph_state_optimal();
+}
+
+void test_csr_epoch_wraparound(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_f));
+  pt.trv_epoch = UINT32_MAX;
+  ASSERT_OK(rk_enable_client(&pt, &c_e));
+  assert_graph_state_optimal();
+  ASSERT_OK(rk_disable_client(&pt, &c_f));
+  assert_graph_state_optimal();
+  ASSERT_OK(rk_disable_client(&pt, &c_e));
+  assert_graph_state_optimal();
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < CLIENT_COUNT; i++) {
+    clients[i]->enabled = false;
+  }
+  failing_node = 0;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_csr_compile);
+  RUN_TEST(test_csr_all_configurations);
+  RUN_TEST(test_csr_apply);
+  RUN_TEST(test_csr_atomic);
+  RUN_TEST(test_csr_optimize);
+  RUN_TEST(test_csr_epoch_wraparound);
+  return UNITY_END();
+}
@@ -0,0 +1,154 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//           +----+----+
+//                |
+//               n_c
+//
+// Clients: c_a (n_a), c_c1 (n_c) and c_c2 (n_c).
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {&n_root, &n_a, &n_b, &n_c};
+struct rk_graph pt = {.nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root};
+
+// CLIENTS:
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_c1 = {.name = "c_c1"};
+struct rk_client c_c2 = {.name = "c_c2"};
+
+struct rk_client *clients[] = {&c_a, &c_c1, &c_c2};
+
+int mock_cb_update(const struct rk_node *self) {
+  (void)self;
+  assert_graph_state_legal(&pt);
+  return 0;
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_child(&n_b, &n_c);
+
+  rk_node_add_client(&n_a, &c_a);
+  rk_node_add_client(&n_c, &c_c1);
+  rk_node_add_client(&n_c, &c_c2);
+}
+
+void assert_dependants(uint32_t root, uint32_t a, uint32_t b, uint32_t c) {
+  TEST_ASSERT_EQUAL_MESSAGE(root, n_root.ctx.active_dependants, "n_root");
+  TEST_ASSERT_EQUAL_MESSAGE(a, n_a.ctx.active_dependants, "n_a");
+  TEST_ASSERT_EQUAL_MESSAGE(b, n_b.ctx.active_dependants, "n_b");
+  TEST_ASSERT_EQUAL_MESSAGE(c, n_c.ctx.active_dependants, "n_c");
+}
+
+// ======== Tests ==================================================================================
+
+void test_dependants_overlapping_clients(void) {
+  ASSERT_OK(rk_init(&pt));
+  assert_dependants(0, 0, 0, 0);
+
+  ASSERT_OK(rk_enable_client(&pt, &c_c1));
+  assert_dependants(2, 1, 1, 1);
+
+  ASSERT_OK(rk_enable_client(&pt, &c_c2));
+  assert_dependants(2, 1, 1, 2);
+
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+  assert_dependants(2, 2, 1, 2);
+
+  // n_c is still required by c_c2:
+  ASSERT_OK(rk_disable_client(&pt, &c_c1));
+  assert_dependants(2, 2, 1, 1);
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_a, true);
+  ASSERT_NODE(n_b, true);
+  ASSERT_NODE(n_c, true);
+
+  // n_a is still required by c_a:
+  ASSERT_OK(rk_disable_client(&pt, &c_c2));
+  assert_dependants(1, 1, 0, 0);
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_a, true);
+  ASSERT_NODE(n_b, false);
+  ASSERT_NODE(n_c, false);
+
+  ASSERT_OK(rk_disable_client(&pt, &c_a));
+  assert_dependants(0, 0, 0, 0);
+  ASSERT_NODE(n_root, false);
+  ASSERT_NODE(n_a, false);
+}
+
+void test_dependants_repeated_requests(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  // Enabling or disabling a client twice does not count it twice:
+  ASSERT_OK(rk_enable_client(&pt, &c_c1));
+  ASSERT_OK(rk_enable_client(&pt, &c_c1));
+  assert_dependants(2, 1, 1, 1);
+
+  ASSERT_OK(rk_disable_client(&pt, &c_c1));
+  ASSERT_OK(rk_disable_client(&pt, &c_c1));
+  assert_dependants(0, 0, 0, 0);
+  ASSERT_NODE(n_root, false);
+}
+
+void test_dependants_init(void) {
+  // States set before initialization are counted:
+  n_root.state = true;
+  n_a.state = true;
+  c_a.enabled = true;
+  ASSERT_OK(rk_init(&pt));
+  assert_dependants(1, 1, 0, 0);
+
+  // ... and re-derived by rk_optimize():
+  n_b.state = true;
+  ASSERT_OK(rk_optimize(&pt));
+  assert_dependants(1, 1, 0, 0);
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_a, true);
+  ASSERT_NODE(n_b, false);
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_dependants_overlapping_clients);
+  RUN_TEST(test_dependants_repeated_requests);
+  RUN_TEST(test_dependants_init);
+  return UNITY_END();
+}
@@ -0,0 +1,133 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//       n_root
+//    +----+----+
+//    |         |
+//   n_a       n_b
+//    |         |
+//   c_a       n_c
+//              |
+//             c_c
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {&n_root, &n_a, &n_b, &n_c};
+struct rk_graph pt = {.nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root};
+
+// CLIENTS:
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_c = {.name = "c_c"};
+
+struct rk_client *clients[] = {&c_a, &c_c};
+
+void assert_graph_state_optimal(void) {
+  assert_graph_state_legal(&pt);
+  ASSERT_NODE(n_root, c_a.enabled || c_c.enabled);
+  ASSERT_NODE(n_a, c_a.enabled);
+  ASSERT_NODE(n_b, c_c.enabled);
+  ASSERT_NODE(n_c, c_c.enabled);
+}
+
+int mock_cb_update(const struct rk_node *self) {
+  (void)self;
+  assert_graph_state_legal(&pt);
+  return 0;
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_child(&n_b, &n_c);
+
+  rk_node_add_client(&n_a, &c_a);
+  rk_node_add_client(&n_c, &c_c);
+}
+
+// Force the traversal epoch to wrap around during the next request. All nodes and clients carry
+// stale stamps that match the first epoch after the wrap-around:
+void prepare_wraparound(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->ctx.trv_epoch = 1;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->trv_epoch = 1;
+  }
+  pt.trv_epoch = UINT32_MAX;
+}
+
+// ======== Tests ==================================================================================
+
+void test_epoch_wraparound_enable_disable(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  prepare_wraparound();
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+  assert_graph_state_optimal();
+
+  prepare_wraparound();
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  assert_graph_state_optimal();
+
+  prepare_wraparound();
+  ASSERT_OK(rk_disable_client(&pt, &c_a));
+  assert_graph_state_optimal();
+
+  prepare_wraparound();
+  ASSERT_OK(rk_disable_client(&pt, &c_c));
+  assert_graph_state_optimal();
+}
+
+void test_epoch_wraparound_apply(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  struct rk_client *enable_list[] = {&c_a, &c_c};
+  struct rk_client *disable_list[] = {&c_a};
+
+  // A stale stamp would mark c_a as contained in the disable list:
+  prepare_wraparound();
+  ASSERT_OK(rk_apply(&pt, enable_list, 2, 0, 0));
+  assert_graph_state_optimal();
+  TEST_ASSERT_TRUE(c_a.enabled);
+  TEST_ASSERT_TRUE(c_c.enabled);
+
+  prepare_wraparound();
+  ASSERT_OK(rk_apply(&pt, 0, 0, disable_list, 1));
+  assert_graph_state_optimal();
+  TEST_ASSERT_FALSE(c_a.enabled);
+  TEST_ASSERT_TRUE(c_c.enabled);
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_epoch_wraparound_enable_disable);
+  RUN_TEST(test_epoch_wraparound_apply);
+  return UNITY_END();
+}
@@ -0,0 +1,197 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+#include "resource_khan_exec.h"
+
+#include <stdatomic.h>
+#include <time.h>
+
+// ======== Resource Graph =========================================================================
+
+//
+//                 n_root
+//                    |
+//      +-----+-------+-----+
+//      |     |       |     |
+//     n_0   n_1     n_2   n_3
+//      |     |       |     |
+//     c_0   c_1     c_2   c_3
+//
+// In addition, c_all depends on all of n_0 to n_3.
+//
+// Every node's callback takes 2ms.
+
+#define FAN_OUT 4
+
+int mock_cb_update(const struct rk_node *self);
+
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_fan[FAN_OUT];
+struct rk_node *nodes[FAN_OUT + 1];
+struct rk_graph pt = {.nodes = nodes, .node_count = FAN_OUT + 1, .root = &n_root};
+
+struct rk_client c_fan[FAN_OUT];
+struct rk_client c_all = {.name = "c_all"};
+
+// Callbacks run on worker threads, so violations are recorded instead of asserted:
+atomic_int cb_count;
+atomic_int cb_in_flight;
+atomic_int cb_max_in_flight;
+atomic_bool cb_illegal;
+atomic_bool cb_fail;
+
+int mock_cb_update(const struct rk_node *self) {
+  int in_flight = atomic_fetch_add(&cb_in_flight, 1) + 1;
+  int max = atomic_load(&cb_max_in_flight);
+  while (in_flight > max && !atomic_compare_exchange_weak(&cb_max_in_flight, &max, in_flight)) {
+  }
+
+  // Children may only be enabled once the root is enabled, and the root only
+  // disabled once all children are disabled:
+  if (self != &n_root && self->desired_state && !n_root.state) {
+    atomic_store(&cb_illegal, true);
+  }
+  if (self == &n_root && !self->desired_state) {
+    for (size_t i = 0; i < FAN_OUT; i++) {
+      if (n_fan[i].state) {
+        atomic_store(&cb_illegal, true);
+      }
+    }
+  }
+
+  struct timespec delay = {.tv_sec = 0, .tv_nsec = 2000000};
+  nanosleep(&delay, 0);
+
+  atomic_fetch_add(&cb_count, 1);
+  atomic_fetch_sub(&cb_in_flight, 1);
+  return (self == &n_fan[3] && atomic_load(&cb_fail)) ? -1 : 0;
+}
+
+void init_graph(void) {
+  nodes[0] = &n_root;
+  for (size_t i = 0; i < FAN_OUT; i++) {
+    snprintf(n_fan[i].name, sizeof(n_fan[i].name), "n_%zu", i);
+    snprintf(c_fan[i].name, sizeof(c_fan[i].name), "c_%zu", i);
+    n_fan[i].cb_update = mock_cb_update;
+    nodes[i + 1] = &n_fan[i];
+    rk_node_add_child(&n_root, &n_fan[i]);
+    rk_node_add_client(&n_fan[i], &c_fan[i]);
+    rk_node_add_client(&n_fan[i], &c_all);
+  }
+}
+
+void assert_graph_state_optimal(void) {
+  assert_graph_state_legal(&pt);
+  bool any = c_all.enabled;
+  for (size_t i = 0; i < FAN_OUT; i++) {
+    ASSERT_NODE(n_fan[i], c_fan[i].enabled || c_all.enabled);
+    any = any || c_fan[i].enabled;
+  }
+  ASSERT_NODE(n_root, any);
+}
+
+// ======== Tests ==================================================================================
+
+void test_exec_enable_disable(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  struct rk_executor ex;
+  ASSERT_OK(rk_exec_start(&ex, &pt, 4));
+
+  struct rk_client *clients[] = {&c_all};
+  ASSERT_OK(rk_exec_apply(&ex, clients, 1, 0, 0));
+  assert_graph_state_optimal();
+  TEST_ASSERT_EQUAL_INT(FAN_OUT + 1, atomic_load(&cb_count));
+
+  ASSERT_OK(rk_exec_apply(&ex, 0, 0, clients, 1));
+  assert_graph_state_optimal();
+  TEST_ASSERT_EQUAL_INT(2 * (FAN_OUT + 1), atomic_load(&cb_count));
+
+  ASSERT_OK(rk_exec_stop(&ex));
+
+  TEST_ASSERT_FALSE(atomic_load(&cb_illegal));
+
+  // Independent siblings are updated in parallel:
+  TEST_ASSERT_GREATER_THAN_INT(1, atomic_load(&cb_max_in_flight));
+  TEST_ASSERT_LESS_OR_EQUAL_INT(4, atomic_load(&cb_max_in_flight));
+
+  // Graph can be used directly again after the executor is stopped:
+  ASSERT_OK(rk_enable_client(&pt, &c_fan[0]));
+  assert_graph_state_optimal();
+}
+
+void test_exec_single_thread(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  struct rk_executor ex;
+  ASSERT_OK(rk_exec_start(&ex, &pt, 1));
+
+  struct rk_client *clients[] = {&c_fan[1], &c_fan[3]};
+  ASSERT_OK(rk_exec_apply(&ex, clients, 2, 0, 0));
+  assert_graph_state_optimal();
+  ASSERT_OK(rk_exec_stop(&ex));
+
+  TEST_ASSERT_FALSE(atomic_load(&cb_illegal));
+  TEST_ASSERT_EQUAL_INT(1, atomic_load(&cb_max_in_flight));
+}
+
+void test_exec_failure(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  struct rk_executor ex;
+  ASSERT_OK(rk_exec_start(&ex, &pt, 4));
+
+  atomic_store(&cb_fail, true);
+  struct rk_client *clients[] = {&c_fan[2], &c_fan[3]};
+  ASSERT_ERR(rk_exec_apply(&ex, clients, 2, 0, 0));
+  assert_graph_state_legal(&pt);
+  ASSERT_NODE(n_fan[2], 1);
+  ASSERT_NODE(n_fan[3], 0);
+
+  atomic_store(&cb_fail, false);
+  ASSERT_OK(rk_exec_apply(&ex, clients, 2, 0, 0));
+  assert_graph_state_optimal();
+  ASSERT_OK(rk_exec_stop(&ex));
+
+  TEST_ASSERT_FALSE(atomic_load(&cb_illegal));
+}
+
+void test_exec_invalid(void) {
+  struct rk_executor ex;
+  ASSERT_ERR(rk_exec_start(&ex, &pt, 0));
+  ASSERT_ERR(rk_exec_start(&ex, &pt, RK_EXEC_MAX_THREADS + 1));
+  ASSERT_ERR(rk_exec_start(0, &pt, 1));
+  ASSERT_ERR(rk_exec_start(&ex, 0, 1));
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  n_root.state = false;
+  c_all.enabled = false;
+  for (size_t i = 0; i < FAN_OUT; i++) {
+    n_fan[i].state = false;
+    c_fan[i].enabled = false;
+  }
+  atomic_store(&cb_count, 0);
+  atomic_store(&cb_in_flight, 0);
+  atomic_store(&cb_max_in_flight, 0);
+  atomic_store(&cb_illegal, false);
+  atomic_store(&cb_fail, false);
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_exec_enable_disable);
+  RUN_TEST(test_exec_single_thread);
+  RUN_TEST(test_exec_failure);
+  RUN_TEST(test_exec_invalid);
+  return UNITY_END();
+}
@@ -0,0 +1,338 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//           +----+----+
+//                |
+//               n_c
+//                |
+//               n_d
+//
+// Clients: c_a (n_a), c_b (n_b), c_c (n_c) and c_d (n_d).
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+struct rk_node n_d = {.name = "n_d", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {&n_root, &n_a, &n_b, &n_c, &n_d};
+
+struct rk_graph pt = {.nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root};
+
+// CLIENTS:
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_b = {.name = "c_b"};
+struct rk_client c_c = {.name = "c_c"};
+struct rk_client c_d = {.name = "c_d"};
+
+struct rk_client *clients[] = {&c_a, &c_b, &c_c, &c_d};
+
+// MOCK:
+struct rk_node *failing_node = 0;
+
+struct cb_call {
+  const struct rk_node *node;
+  bool desired_state;
+};
+
+struct cb_call cb_log[32];
+size_t cb_log_len = 0;
+
+int mock_cb_update(const struct rk_node *self) {
+  TEST_ASSERT_LESS_THAN(sizeof(cb_log) / sizeof(cb_log[0]), cb_log_len);
+  cb_log[cb_log_len].node = self;
+  cb_log[cb_log_len].desired_state = self->desired_state;
+  cb_log_len++;
+  return self == failing_node ? -1 : 0;
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_child(&n_b, &n_c);
+  rk_node_add_client(&n_a, &c_a);
+  rk_node_add_client(&n_b, &c_b);
+
+  rk_node_add_child(&n_c, &n_d);
+  rk_node_add_client(&n_c, &c_c);
+
+  rk_node_add_client(&n_d, &c_d);
+}
+
+void assert_cb_call(size_t idx, struct rk_node *node, bool desired_state) {
+  TEST_ASSERT_LESS_THAN(cb_log_len, idx);
+  TEST_ASSERT_EQUAL_PTR_MESSAGE(node, cb_log[idx].node, node->name);
+  TEST_ASSERT_EQUAL_MESSAGE(desired_state, cb_log[idx].desired_state, node->name);
+}
+
+// ======== Tests ==================================================================================
+
+void test_fault(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  cb_log_len = 0;
+
+  // n_c and n_d are disabled from the leaves up. n_a's callback is not called:
+  ASSERT_OK(rk_node_fault(&pt, &n_a));
+  TEST_ASSERT_EQUAL(2, cb_log_len);
+  assert_cb_call(0, &n_d, false);
+  assert_cb_call(1, &n_c, false);
+
+  TEST_ASSERT_TRUE(n_a.faulted);
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_a, false);
+  ASSERT_NODE(n_b, true);
+  ASSERT_NODE(n_c, false);
+  ASSERT_NODE(n_d, false);
+  assert_graph_state_legal(&pt);
+
+  // Only clients depending on n_a lose service:
+  TEST_ASSERT_FALSE(c_d.enabled);
+  TEST_ASSERT_TRUE(c_d.unserved);
+  TEST_ASSERT_TRUE(c_b.enabled);
+  TEST_ASSERT_FALSE(c_b.unserved);
+  TEST_ASSERT_FALSE(c_a.unserved);
+  TEST_ASSERT_FALSE(c_c.unserved);
+}
+
+void test_recover(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  ASSERT_OK(rk_node_fault(&pt, &n_a));
+  cb_log_len = 0;
+
+  // Exactly the nodes that were disabled are re-enabled:
+  ASSERT_OK(rk_node_recover(&pt, &n_a));
+  TEST_ASSERT_EQUAL(3, cb_log_len);
+  assert_cb_call(0, &n_a, true);
+  assert_cb_call(1, &n_c, true);
+  assert_cb_call(2, &n_d, true);
+
+  TEST_ASSERT_FALSE(n_a.faulted);
+  TEST_ASSERT_TRUE(c_d.enabled);
+  TEST_ASSERT_FALSE(c_d.unserved);
+  TEST_ASSERT_FALSE(c_c.enabled);
+  assert_graph_state_legal(&pt);
+
+  // Graph is back in an optimal state:
+  cb_log_len = 0;
+  ASSERT_OK(rk_disable_client(&pt, &c_d));
+  ASSERT_OK(rk_disable_client(&pt, &c_b));
+  for (size_t i = 0; i < pt.node_count; i++) {
+    ASSERT_NODE(*nodes[i], false);
+  }
+}
+
+void test_recover_disabled_parents(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+  ASSERT_OK(rk_node_fault(&pt, &n_a));
+
+  // n_root is no longer required:
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  ASSERT_NODE(n_root, false);
+  cb_log_len = 0;
+
+  ASSERT_OK(rk_node_recover(&pt, &n_a));
+  TEST_ASSERT_EQUAL(2, cb_log_len);
+  assert_cb_call(0, &n_root, true);
+  assert_cb_call(1, &n_a, true);
+  TEST_ASSERT_TRUE(c_a.enabled);
+  assert_graph_state_legal(&pt);
+}
+
+void test_fault_failing_child(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+
+  // n_d is disabled regardless, and n_c is still disabled:
+  failing_node = &n_d;
+  ASSERT_ERR(rk_node_fault(&pt, &n_b));
+  failing_node = 0;
+  ASSERT_NODE(n_b, false);
+  ASSERT_NODE(n_c, false);
+  ASSERT_NODE(n_d, false);
+  TEST_ASSERT_TRUE(c_d.unserved);
+  assert_graph_state_legal(&pt);
+
+  ASSERT_OK(rk_node_recover(&pt, &n_b));
+  ASSERT_NODE(n_d, true);
+  TEST_ASSERT_TRUE(c_d.enabled);
+  assert_graph_state_legal(&pt);
+}
+
+void test_recover_failing(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  ASSERT_OK(rk_node_fault(&pt, &n_c));
+
+  // Node remains faulted:
+  failing_node = &n_d;
+  ASSERT_ERR(rk_node_recover(&pt, &n_c));
+  TEST_ASSERT_TRUE(n_c.faulted);
+  TEST_ASSERT_TRUE(c_d.unserved);
+  ASSERT_NODE(n_c, true);
+  ASSERT_NODE(n_d, false);
+  assert_graph_state_legal(&pt);
+
+  failing_node = 0;
+  cb_log_len = 0;
+  ASSERT_OK(rk_node_recover(&pt, &n_c));
+  TEST_ASSERT_EQUAL(1, cb_log_len);
+  assert_cb_call(0, &n_d, true);
+  TEST_ASSERT_TRUE(c_d.enabled);
+}
+
+void test_overlapping_faults(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  ASSERT_OK(rk_node_fault(&pt, &n_a));
+  ASSERT_OK(rk_node_fault(&pt, &n_b));
+
+  // n_c also depends on n_b, and remains disabled:
+  ASSERT_OK(rk_node_recover(&pt, &n_a));
+  ASSERT_NODE(n_a, true);
+  ASSERT_NODE(n_c, false);
+  TEST_ASSERT_TRUE(c_d.unserved);
+  assert_graph_state_legal(&pt);
+
+  ASSERT_OK(rk_node_recover(&pt, &n_b));
+  ASSERT_NODE(n_c, true);
+  ASSERT_NODE(n_d, true);
+  TEST_ASSERT_TRUE(c_d.enabled);
+  TEST_ASSERT_FALSE(c_d.unserved);
+  assert_graph_state_legal(&pt);
+}
+
+void test_enable_faulted(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_node_fault(&pt, &n_a));
+
+  // Clients depending on n_a (directly or through a child) cannot be enabled:
+  ASSERT_ERR(rk_enable_client(&pt, &c_a));
+  ASSERT_ERR(rk_enable_client(&pt, &c_d));
+  TEST_ASSERT_FALSE(c_a.enabled);
+  TEST_ASSERT_FALSE(c_d.enabled);
+  ASSERT_NODE(n_a, false);
+  ASSERT_NODE(n_c, false);
+  ASSERT_NODE(n_d, false);
+  assert_graph_state_legal(&pt);
+
+  // The faulted node's callback is never called:
+  for (size_t i = 0; i < cb_log_len; i++) {
+    TEST_ASSERT_NOT_EQUAL(&n_a, cb_log[i].node);
+  }
+  cb_log_len = 0;
+
+  ASSERT_OK(rk_optimize(&pt));
+  ASSERT_ERR(rk_enable_client_atomic(&pt, &c_c));
+  TEST_ASSERT_FALSE(c_c.enabled);
+  ASSERT_NODE(n_root, false);
+  ASSERT_NODE(n_b, false);
+
+  struct rk_client *enable_list[] = {&c_b, &c_d};
+  ASSERT_ERR(rk_apply(&pt, enable_list, 2, 0, 0));
+  TEST_ASSERT_FALSE(c_d.enabled);
+  ASSERT_NODE(n_a, false);
+  assert_graph_state_legal(&pt);
+
+  // Clients independent of n_a are unaffected:
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+  TEST_ASSERT_TRUE(c_b.enabled);
+
+  ASSERT_OK(rk_node_recover(&pt, &n_a));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  ASSERT_NODE(n_d, true);
+  assert_graph_state_legal(&pt);
+}
+
+void test_disable_unserved(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  ASSERT_OK(rk_node_fault(&pt, &n_a));
+  TEST_ASSERT_TRUE(c_c.unserved);
+  TEST_ASSERT_TRUE(c_d.unserved);
+
+  struct rk_client *disable_list[] = {&c_d};
+  ASSERT_OK(rk_disable_client(&pt, &c_c));
+  ASSERT_OK(rk_apply(&pt, 0, 0, disable_list, 1));
+  TEST_ASSERT_FALSE(c_c.unserved);
+  TEST_ASSERT_FALSE(c_d.unserved);
+  cb_log_len = 0;
+
+  // Disabled clients are not re-enabled by the recovery:
+  ASSERT_OK(rk_node_recover(&pt, &n_a));
+  TEST_ASSERT_FALSE(c_c.enabled);
+  TEST_ASSERT_FALSE(c_d.enabled);
+  assert_graph_state_legal(&pt);
+
+  ASSERT_OK(rk_optimize(&pt));
+  for (size_t i = 0; i < pt.node_count; i++) {
+    ASSERT_NODE(*nodes[i], false);
+  }
+}
+
+void test_fault_invalid(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_ERR(rk_node_fault(0, &n_a));
+  ASSERT_ERR(rk_node_fault(&pt, 0));
+  ASSERT_ERR(rk_node_recover(0, &n_a));
+  ASSERT_ERR(rk_node_recover(&pt, 0));
+
+  // Node has not faulted:
+  ASSERT_ERR(rk_node_recover(&pt, &n_a));
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+    pt.nodes[i]->faulted = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+    clients[i]->unserved = false;
+  }
+  failing_node = 0;
+  cb_log_len = 0;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_fault);
+  RUN_TEST(test_recover);
+  RUN_TEST(test_recover_disabled_parents);
+  RUN_TEST(test_fault_failing_child);
+  RUN_TEST(test_recover_failing);
+  RUN_TEST(test_overlapping_faults);
+  RUN_TEST(test_enable_faulted);
+  RUN_TEST(test_disable_unserved);
+  RUN_TEST(test_fault_invalid);
+  return UNITY_END();
+}
@@ -0,0 +1,153 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//           +----+----+
+//                |
+//               n_c
+//                |
+//               n_d
+//
+// Clients: c_root (n_root), c_a (n_a), c_c (n_c), c_d (n_d) and c_bd (n_b and n_d).
+
+// NODES:
+struct rk_node n_root = {.name = "n_root"};
+struct rk_node n_a = {.name = "n_a"};
+struct rk_node n_b = {.name = "n_b"};
+struct rk_node n_c = {.name = "n_c"};
+struct rk_node n_d = {.name = "n_d"};
+
+struct rk_node *nodes[] = {&n_d, &n_root, &n_c, &n_b, &n_a};
+
+// Impact index:
+void *impact_buf[17];
+struct rk_impact impact = {.buf = impact_buf, .buf_size = sizeof(impact_buf)};
+
+struct rk_graph pt = {
+    .nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root, .impact = &impact};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_c = {.name = "c_c"};
+struct rk_client c_d = {.name = "c_d"};
+struct rk_client c_bd = {.name = "c_bd"};
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_child(&n_b, &n_c);
+  rk_node_add_client(&n_a, &c_a);
+  rk_node_add_client(&n_b, &c_bd);
+
+  rk_node_add_child(&n_c, &n_d);
+  rk_node_add_client(&n_c, &c_c);
+
+  rk_node_add_client(&n_d, &c_d);
+  rk_node_add_client(&n_d, &c_bd);
+}
+
+// Assert that the impact of a node contains exactly the given clients, in any order.
+void assert_impact(struct rk_node *node, struct rk_client **expected, size_t expected_count) {
+  struct rk_client **clients = 0;
+  size_t count = 0;
+  ASSERT_OK(rk_node_impact(&pt, node, &clients, &count));
+  TEST_ASSERT_EQUAL_MESSAGE(expected_count, count, node->name);
+
+  for (size_t i = 0; i < expected_count; i++) {
+    size_t occurrences = 0;
+    for (size_t j = 0; j < count; j++) {
+      occurrences += clients[j] == expected[i] ? 1 : 0;
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(1, occurrences, expected[i]->name);
+  }
+}
+
+// ======== Tests ==================================================================================
+
+void test_impact_size(void) {
+  // n_root: 5 clients, n_a: 4, n_b: 3, n_c: 3, n_d: 2.
+  TEST_ASSERT_EQUAL(17 * sizeof(struct rk_client *), rk_impact_size(&pt));
+  TEST_ASSERT_EQUAL(0, rk_impact_size(0));
+}
+
+void test_impact(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  struct rk_client *root_impact[] = {&c_root, &c_a, &c_c, &c_d, &c_bd};
+  assert_impact(&n_root, root_impact, 5);
+
+  struct rk_client *a_impact[] = {&c_a, &c_c, &c_d, &c_bd};
+  assert_impact(&n_a, a_impact, 4);
+
+  // c_bd depends on n_b both directly and through n_d, but is only listed once:
+  struct rk_client *b_impact[] = {&c_bd, &c_c, &c_d};
+  assert_impact(&n_b, b_impact, 3);
+
+  struct rk_client *c_impact[] = {&c_c, &c_d, &c_bd};
+  assert_impact(&n_c, c_impact, 3);
+
+  struct rk_client *d_impact[] = {&c_d, &c_bd};
+  assert_impact(&n_d, d_impact, 2);
+}
+
+void test_impact_buffer_too_small(void) {
+  impact.buf_size = 17 * sizeof(struct rk_client *) - 1;
+  ASSERT_ERR(rk_init(&pt));
+
+  impact.buf_size = sizeof(impact_buf);
+  ASSERT_OK(rk_init(&pt));
+}
+
+void test_impact_invalid(void) {
+  struct rk_client **clients = 0;
+  size_t count = 0;
+
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_ERR(rk_node_impact(0, &n_a, &clients, &count));
+  ASSERT_ERR(rk_node_impact(&pt, 0, &clients, &count));
+  ASSERT_ERR(rk_node_impact(&pt, &n_a, 0, &count));
+  ASSERT_ERR(rk_node_impact(&pt, &n_a, &clients, 0));
+
+  // No impact index:
+  pt.impact = 0;
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_ERR(rk_node_impact(&pt, &n_a, &clients, &count));
+  pt.impact = &impact;
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_impact_size);
+  RUN_TEST(test_impact);
+  RUN_TEST(test_impact_buffer_too_small);
+  RUN_TEST(test_impact_invalid);
+  return UNITY_END();
+}
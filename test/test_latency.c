@@ -0,0 +1,250 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |
+//          n_c
+//
+// All nodes have a single, identically named client (n_root -> c_root, n_a -> c_a etc).
+// n_b has no callback.
+//
+// Every call to the timestamp source advances time by one tick, and every callback takes the
+// number of ticks given in its node's cb_ticks entry.
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+#define N_ROOT 0
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+#define N_A 1
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+#define N_B 2
+struct rk_node n_b = {.name = "n_b"};
+#define N_C 3
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {[N_ROOT] = &n_root, [N_A] = &n_a, [N_B] = &n_b, [N_C] = &n_c};
+
+uint32_t cb_ticks[] = {[N_ROOT] = 10, [N_A] = 100, [N_B] = 0, [N_C] = 1000};
+
+uint32_t now = 0;
+
+uint32_t mock_timestamp(void) { return now++; }
+
+struct rk_graph pt = {.nodes = nodes,
+                      .node_count = sizeof(nodes) / sizeof(nodes[0]),
+                      .root = &n_root,
+                      .cb_timestamp = mock_timestamp};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_b = {.name = "c_b"};
+struct rk_client c_c = {.name = "c_c"};
+
+struct rk_client *clients[] = {&c_root, &c_a, &c_b, &c_c};
+
+// HISTOGRAMS:
+struct rk_histogram hist_root;
+struct rk_histogram hist_a;
+struct rk_histogram hist_c;
+struct rk_histogram hist_client_a;
+struct rk_histogram hist_client_c;
+
+int mock_cb_update(const struct rk_node *self) {
+  now += cb_ticks[self->ctx.node_idx];
+  return 0;
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_client(&n_a, &c_a);
+
+  rk_node_add_client(&n_b, &c_b);
+
+  rk_node_add_client(&n_c, &c_c);
+
+  n_root.cb_latency = &hist_root;
+  n_a.cb_latency = &hist_a;
+  n_c.cb_latency = &hist_c;
+  c_a.latency = &hist_client_a;
+  c_c.latency = &hist_client_c;
+}
+
+void assert_summary(struct rk_histogram *hist, uint32_t count, uint32_t p50, uint32_t p99, uint32_t max) {
+  struct rk_histogram_summary summary;
+  rk_histogram_summarize(hist, &summary);
+  TEST_ASSERT_EQUAL_MESSAGE(count, summary.count, "count");
+  TEST_ASSERT_EQUAL_MESSAGE(p50, summary.p50, "p50");
+  TEST_ASSERT_EQUAL_MESSAGE(p99, summary.p99, "p99");
+  TEST_ASSERT_EQUAL_MESSAGE(max, summary.max, "max");
+}
+
+// ======== Tests ==================================================================================
+
+void test_latency_enable_disable(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  // Every callback call takes one tick more than the callback itself:
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  assert_summary(&hist_root, 1, 11, 11, 11);
+  assert_summary(&hist_a, 1, 101, 101, 101);
+  assert_summary(&hist_c, 1, 1001, 1001, 1001);
+
+  // The request covers the three callback calls, and 7 timestamps:
+  assert_summary(&hist_client_c, 1, 1117, 1117, 1117);
+  assert_summary(&hist_client_a, 0, 0, 0, 0);
+
+  ASSERT_OK(rk_disable_client(&pt, &c_c));
+  TEST_ASSERT_EQUAL(2, hist_root.count);
+  TEST_ASSERT_EQUAL(2, hist_client_c.count);
+
+  ASSERT_OK(rk_enable_client_atomic(&pt, &c_a));
+  TEST_ASSERT_EQUAL(3, hist_root.count);
+  TEST_ASSERT_EQUAL(3, hist_a.count);
+  TEST_ASSERT_EQUAL(2, hist_c.count);
+  assert_summary(&hist_client_a, 1, 115, 115, 115);
+}
+
+void test_latency_elided(void) {
+  pt.transitions_only = true;
+  ASSERT_OK(rk_init(&pt));
+
+  // Elided calls are not recorded:
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+  TEST_ASSERT_EQUAL(1, hist_root.count);
+  TEST_ASSERT_EQUAL(1, hist_a.count);
+  TEST_ASSERT_EQUAL(2, hist_client_a.count + hist_client_c.count);
+
+  pt.transitions_only = false;
+}
+
+void test_latency_no_timestamp(void) {
+  pt.cb_timestamp = 0;
+  ASSERT_ERR(rk_init(&pt));
+
+  n_root.cb_latency = 0;
+  n_a.cb_latency = 0;
+  n_c.cb_latency = 0;
+  ASSERT_ERR(rk_init(&pt));
+
+  c_a.latency = 0;
+  c_c.latency = 0;
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+
+  pt.cb_timestamp = mock_timestamp;
+  n_root.cb_latency = &hist_root;
+  n_a.cb_latency = &hist_a;
+  n_c.cb_latency = &hist_c;
+  c_a.latency = &hist_client_a;
+  c_c.latency = &hist_client_c;
+}
+
+void test_histogram_small_values(void) {
+  struct rk_histogram hist = {0};
+
+  // Small values are recorded exactly:
+  for (uint32_t i = 1; i <= 10; i++) {
+    rk_histogram_record(&hist, i);
+  }
+  assert_summary(&hist, 10, 5, 10, 10);
+  TEST_ASSERT_EQUAL(1, rk_histogram_percentile(&hist, 0));
+  TEST_ASSERT_EQUAL(3, rk_histogram_percentile(&hist, 30));
+  TEST_ASSERT_EQUAL(10, rk_histogram_percentile(&hist, 100));
+  TEST_ASSERT_EQUAL(10, rk_histogram_percentile(&hist, 200));
+}
+
+void test_histogram_large_values(void) {
+  struct rk_histogram hist = {0};
+
+  // 99 fast and one slow value:
+  for (uint32_t i = 0; i < 99; i++) {
+    rk_histogram_record(&hist, 1000);
+  }
+  rk_histogram_record(&hist, 1000000);
+
+  // Percentiles are bucket upper bounds, which are at most 2^-RK_HIST_SUB_BITS larger than the value:
+  struct rk_histogram_summary summary;
+  rk_histogram_summarize(&hist, &summary);
+  TEST_ASSERT_EQUAL(100, summary.count);
+  TEST_ASSERT_UINT32_WITHIN(1000 >> RK_HIST_SUB_BITS, 1000 + (1000 >> (RK_HIST_SUB_BITS + 1)), summary.p50);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(1000, summary.p99);
+  TEST_ASSERT_LESS_THAN_UINT32(1000000, summary.p99);
+  TEST_ASSERT_EQUAL(1000000, summary.max);
+
+  // Percentiles never exceed the largest value:
+  TEST_ASSERT_EQUAL(1000000, rk_histogram_percentile(&hist, 100));
+
+  // Full range:
+  rk_histogram_record(&hist, UINT32_MAX);
+  TEST_ASSERT_EQUAL(UINT32_MAX, rk_histogram_percentile(&hist, 100));
+  TEST_ASSERT_UINT32_WITHIN(1000000 >> RK_HIST_SUB_BITS, 1000000 + (1000000 >> (RK_HIST_SUB_BITS + 1)),
+                            rk_histogram_percentile(&hist, 99));
+}
+
+void test_histogram_reset(void) {
+  struct rk_histogram hist = {0};
+  TEST_ASSERT_EQUAL(0, rk_histogram_percentile(&hist, 50));
+
+  rk_histogram_record(&hist, 42);
+  TEST_ASSERT_EQUAL(1, hist.count);
+
+  rk_histogram_reset(&hist);
+  assert_summary(&hist, 0, 0, 0, 0);
+
+  // Invalid arguments are ignored:
+  struct rk_histogram_summary summary;
+  rk_histogram_record(0, 1);
+  rk_histogram_summarize(0, &summary);
+  rk_histogram_summarize(&hist, 0);
+  rk_histogram_reset(0);
+  TEST_ASSERT_EQUAL(0, rk_histogram_percentile(0, 50));
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+  rk_histogram_reset(&hist_root);
+  rk_histogram_reset(&hist_a);
+  rk_histogram_reset(&hist_c);
+  rk_histogram_reset(&hist_client_a);
+  rk_histogram_reset(&hist_client_c);
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_latency_enable_disable);
+  RUN_TEST(test_latency_elided);
+  RUN_TEST(test_latency_no_timestamp);
+  RUN_TEST(test_histogram_small_values);
+  RUN_TEST(test_histogram_large_values);
+  RUN_TEST(test_histogram_reset);
+  return UNITY_END();
+}
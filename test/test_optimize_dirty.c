@@ -0,0 +1,231 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//          n_c       n_d
+//
+// All nodes have a single, identically named client (n_root -> c_root, n_a -> c_a etc).
+// In addition, there is c_cd, which has parents n_c and n_d.
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+#define N_ROOT 0
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+#define N_A 1
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+#define N_B 2
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+#define N_C 3
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+#define N_D 4
+struct rk_node n_d = {.name = "n_d", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {[N_ROOT] = &n_root, [N_A] = &n_a, [N_B] = &n_b, [N_C] = &n_c, [N_D] = &n_d};
+
+#define NODE_COUNT (sizeof(nodes) / sizeof(nodes[0]))
+
+struct rk_graph pt = {.nodes = nodes, .node_count = NODE_COUNT, .root = &n_root};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_b = {.name = "c_b"};
+struct rk_client c_c = {.name = "c_c"};
+struct rk_client c_d = {.name = "c_d"};
+struct rk_client c_cd = {.name = "c_cd"};
+
+struct rk_client *clients[] = {&c_root, &c_a, &c_b, &c_c, &c_d, &c_cd};
+
+// MOCK:
+struct rk_node *failing_node = 0;
+size_t cb_calls[NODE_COUNT];
+
+int mock_cb_update(const struct rk_node *self) {
+  cb_calls[self->ctx.node_idx]++;
+  return self == failing_node ? -1 : 0;
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_client(&n_a, &c_a);
+
+  rk_node_add_child(&n_b, &n_d);
+  rk_node_add_client(&n_b, &c_b);
+
+  rk_node_add_client(&n_c, &c_c);
+  rk_node_add_client(&n_c, &c_cd);
+
+  rk_node_add_client(&n_d, &c_d);
+  rk_node_add_client(&n_d, &c_cd);
+}
+
+void assert_graph_state_optimal(void) {
+  assert_graph_state_legal(&pt);
+  ASSERT_NODE(n_root, c_root.enabled || c_a.enabled || c_b.enabled || c_c.enabled || c_d.enabled || c_cd.enabled);
+  ASSERT_NODE(n_a, c_a.enabled || c_c.enabled || c_cd.enabled);
+  ASSERT_NODE(n_b, c_b.enabled || c_d.enabled || c_cd.enabled);
+  ASSERT_NODE(n_c, c_c.enabled || c_cd.enabled);
+  ASSERT_NODE(n_d, c_d.enabled || c_cd.enabled);
+}
+
+void assert_cb_calls(size_t root, size_t a, size_t b, size_t c, size_t d) {
+  TEST_ASSERT_EQUAL_MESSAGE(root, cb_calls[N_ROOT], "n_root");
+  TEST_ASSERT_EQUAL_MESSAGE(a, cb_calls[N_A], "n_a");
+  TEST_ASSERT_EQUAL_MESSAGE(b, cb_calls[N_B], "n_b");
+  TEST_ASSERT_EQUAL_MESSAGE(c, cb_calls[N_C], "n_c");
+  TEST_ASSERT_EQUAL_MESSAGE(d, cb_calls[N_D], "n_d");
+  memset(cb_calls, 0, sizeof(cb_calls));
+}
+
+// ======== Tests ==================================================================================
+
+void test_optimize_dirty_clean(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  ASSERT_OK(rk_disable_client(&pt, &c_d));
+  memset(cb_calls, 0, sizeof(cb_calls));
+
+  // Nothing to do:
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  assert_cb_calls(0, 0, 0, 0, 0);
+  assert_graph_state_optimal();
+}
+
+void test_optimize_dirty_init(void) {
+  // n_b is enabled without any enabled dependant:
+  n_root.state = true;
+  n_a.state = true;
+  n_b.state = true;
+  n_c.state = true;
+  c_c.enabled = true;
+  ASSERT_OK(rk_init(&pt));
+
+  // Only n_b and its parent are revisited, and only n_b is updated:
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  assert_cb_calls(0, 0, 1, 0, 0);
+  assert_graph_state_optimal();
+
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  assert_cb_calls(0, 0, 0, 0, 0);
+}
+
+void test_optimize_dirty_failed_disable(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  memset(cb_calls, 0, sizeof(cb_calls));
+
+  // n_d fails to disable, leaving n_d, n_b and n_root enabled:
+  failing_node = &n_d;
+  ASSERT_ERR(rk_disable_client(&pt, &c_d));
+  assert_cb_calls(0, 0, 0, 0, 1);
+  ASSERT_NODE(n_d, true);
+
+  // Retry fails again. Node remains dirty:
+  ASSERT_ERR(rk_optimize_dirty(&pt));
+  assert_cb_calls(0, 0, 0, 0, 1);
+
+  failing_node = 0;
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  assert_cb_calls(1, 0, 1, 0, 1);
+  assert_graph_state_optimal();
+}
+
+void test_optimize_dirty_failed_enable(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  // n_root, n_a and n_c are enabled before n_d fails, leaving them enabled without a dependant:
+  failing_node = &n_d;
+  ASSERT_ERR(rk_enable_client(&pt, &c_cd));
+  assert_cb_calls(2, 1, 1, 1, 1);
+  ASSERT_NODE(n_c, true);
+
+  failing_node = 0;
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  assert_cb_calls(1, 1, 1, 1, 0);
+  assert_graph_state_optimal();
+}
+
+void test_optimize_dirty_failed_apply(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  failing_node = &n_d;
+  struct rk_client *enable_list[] = {&c_cd};
+  ASSERT_ERR(rk_apply(&pt, enable_list, 1, 0, 0));
+  ASSERT_NODE(n_c, true);
+  memset(cb_calls, 0, sizeof(cb_calls));
+
+  failing_node = 0;
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  assert_cb_calls(1, 1, 1, 1, 0);
+  assert_graph_state_optimal();
+}
+
+void test_optimize_dirty_full_optimize(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  failing_node = &n_d;
+  ASSERT_ERR(rk_enable_client(&pt, &c_cd));
+  failing_node = 0;
+
+  // A full optimization clears all dirty nodes:
+  ASSERT_OK(rk_optimize(&pt));
+  assert_graph_state_optimal();
+  memset(cb_calls, 0, sizeof(cb_calls));
+
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  assert_cb_calls(0, 0, 0, 0, 0);
+}
+
+void test_optimize_dirty_invalid(void) {
+  ASSERT_ERR(rk_optimize_dirty(0));
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_optimize_dirty(&pt));
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+  failing_node = 0;
+  memset(cb_calls, 0, sizeof(cb_calls));
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_optimize_dirty_clean);
+  RUN_TEST(test_optimize_dirty_init);
+  RUN_TEST(test_optimize_dirty_failed_disable);
+  RUN_TEST(test_optimize_dirty_failed_enable);
+  RUN_TEST(test_optimize_dirty_failed_apply);
+  RUN_TEST(test_optimize_dirty_full_optimize);
+  RUN_TEST(test_optimize_dirty_invalid);
+  return UNITY_END();
+}
@@ -0,0 +1,260 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//           +----+----+
+//                |
+//               n_c
+//                |
+//               n_d
+//
+// Clients: c_root (n_root), c_c (n_c), c_d (n_d) and c_ab (n_a and n_b).
+// n_b has no callback.
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+struct rk_node n_b = {.name = "n_b"};
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+struct rk_node n_d = {.name = "n_d", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {&n_d, &n_root, &n_c, &n_b, &n_a};
+
+// Enable plans:
+void *plans_buf[14];
+struct rk_plans plans = {.buf = plans_buf, .buf_size = sizeof(plans_buf)};
+
+struct rk_stats stats;
+
+struct rk_graph pt = {
+    .nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root, .stats = &stats};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_c = {.name = "c_c"};
+struct rk_client c_d = {.name = "c_d"};
+struct rk_client c_ab = {.name = "c_ab"};
+
+struct rk_client *clients[] = {&c_root, &c_c, &c_d, &c_ab};
+
+// MOCK:
+struct rk_node *failing_node = 0;
+
+struct cb_call {
+  const struct rk_node *node;
+  bool desired_state;
+};
+
+struct cb_call cb_log[64];
+size_t cb_log_len = 0;
+
+int mock_cb_update(const struct rk_node *self) {
+  TEST_ASSERT_LESS_THAN(sizeof(cb_log) / sizeof(cb_log[0]), cb_log_len);
+  cb_log[cb_log_len].node = self;
+  cb_log[cb_log_len].desired_state = self->desired_state;
+  cb_log_len++;
+  return self == failing_node ? -1 : 0;
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_child(&n_b, &n_c);
+  rk_node_add_client(&n_a, &c_ab);
+  rk_node_add_client(&n_b, &c_ab);
+
+  rk_node_add_child(&n_c, &n_d);
+  rk_node_add_client(&n_c, &c_c);
+
+  rk_node_add_client(&n_d, &c_d);
+}
+
+void reset_states(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+  failing_node = 0;
+  cb_log_len = 0;
+  rk_stats_reset(&stats);
+}
+
+// Run a sequence of requests, and record the resulting callback calls.
+void run_sequence(struct cb_call *log, size_t *log_len) {
+  reset_states();
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  ASSERT_OK(rk_enable_client(&pt, &c_ab));
+  ASSERT_OK(rk_disable_client(&pt, &c_d));
+  ASSERT_OK(rk_enable_client_atomic(&pt, &c_c));
+  ASSERT_OK(rk_disable_client(&pt, &c_ab));
+  ASSERT_OK(rk_disable_client(&pt, &c_c));
+
+  failing_node = &n_c;
+  ASSERT_ERR(rk_enable_client(&pt, &c_d));
+  ASSERT_ERR(rk_enable_client_atomic(&pt, &c_d));
+  failing_node = 0;
+  ASSERT_OK(rk_optimize(&pt));
+  assert_graph_state_legal(&pt);
+
+  memcpy(log, cb_log, sizeof(cb_log));
+  *log_len = cb_log_len;
+}
+
+// ======== Tests ==================================================================================
+
+void test_plans_size(void) {
+  // c_root: n_root. c_c: n_c, n_a, n_b, n_root. c_d: n_d, n_c, n_a, n_b, n_root. c_ab: n_a, n_root, n_b, n_root.
+  TEST_ASSERT_EQUAL(14 * sizeof(struct rk_node *), rk_plans_size(&pt));
+  TEST_ASSERT_EQUAL(0, rk_plans_size(0));
+
+  pt.plans = &plans;
+  ASSERT_OK(rk_init(&pt));
+  TEST_ASSERT_EQUAL(5, c_d.plan_len);
+  TEST_ASSERT_EQUAL(4, c_ab.plan_len);
+
+  // Calculating the size of an initialized graph does not affect its plans or traversals:
+  struct rk_node **plan_d = c_d.plan;
+  uint32_t trv_epoch = pt.trv_epoch;
+  TEST_ASSERT_EQUAL(14 * sizeof(struct rk_node *), rk_plans_size(&pt));
+  TEST_ASSERT_EQUAL_PTR(plan_d, c_d.plan);
+  TEST_ASSERT_EQUAL(5, c_d.plan_len);
+  TEST_ASSERT_EQUAL(trv_epoch, pt.trv_epoch);
+
+  // Plans are in topological order for every parent:
+  TEST_ASSERT_EQUAL_PTR(&n_root, c_d.plan[0]);
+  TEST_ASSERT_EQUAL_PTR(&n_d, c_d.plan[4]);
+  TEST_ASSERT_EQUAL_PTR(&n_root, c_ab.plan[0]);
+  TEST_ASSERT_EQUAL_PTR(&n_root, c_ab.plan[2]);
+
+  // Buffer too small:
+  plans.buf_size = sizeof(plans_buf) - 1;
+  ASSERT_ERR(rk_init(&pt));
+  plans.buf_size = sizeof(plans_buf);
+
+  pt.plans = 0;
+  ASSERT_OK(rk_init(&pt));
+  TEST_ASSERT_NULL(c_d.plan);
+}
+
+void test_plans_same_callbacks(void) {
+  static struct cb_call log_flood[64];
+  static struct cb_call log_plans[64];
+  size_t log_flood_len;
+  size_t log_plans_len;
+
+  pt.plans = 0;
+  run_sequence(log_flood, &log_flood_len);
+
+  pt.plans = &plans;
+  run_sequence(log_plans, &log_plans_len);
+
+  TEST_ASSERT_EQUAL(log_flood_len, log_plans_len);
+  for (size_t i = 0; i < log_flood_len; i++) {
+    TEST_ASSERT_EQUAL_PTR(log_flood[i].node, log_plans[i].node);
+    TEST_ASSERT_EQUAL(log_flood[i].desired_state, log_plans[i].desired_state);
+  }
+
+  pt.plans = 0;
+}
+
+void test_plans_no_flood(void) {
+  pt.plans = &plans;
+  ASSERT_OK(rk_init(&pt));
+  rk_stats_reset(&stats);
+
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  ASSERT_OK(rk_enable_client(&pt, &c_ab));
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_a, true);
+  ASSERT_NODE(n_b, true);
+  ASSERT_NODE(n_c, true);
+  ASSERT_NODE(n_d, true);
+
+  struct rk_stats_snapshot snapshot;
+  rk_stats_read(&stats, &snapshot);
+  TEST_ASSERT_EQUAL(0, snapshot.flood_visits);
+
+  // n_a and n_b are already enabled, so their parents are not updated. n_b has no callback, and
+  // is skipped as well:
+  TEST_ASSERT_EQUAL(5 + 1, snapshot.topo_visits);
+
+  pt.plans = 0;
+}
+
+void test_plans_outdated(void) {
+  pt.plans = &plans;
+  ASSERT_OK(rk_init(&pt));
+  TEST_ASSERT_NOT_NULL(c_root.plan);
+
+  // Plans of modified clients are discarded:
+  struct rk_node n_extra = {.name = "n_extra"};
+  ASSERT_OK(rk_node_add_client(&n_extra, &c_root));
+  TEST_ASSERT_NULL(c_root.plan);
+
+  pt.plans = 0;
+  c_root.parent_count--;
+}
+
+void test_plans_parallel_edges(void) {
+  struct rk_node p_root = {.name = "p_root"};
+  struct rk_node p_a = {.name = "p_a"};
+  struct rk_client p_c = {.name = "p_c"};
+  struct rk_node *p_nodes[] = {&p_root, &p_a};
+  void *p_buf[4];
+  struct rk_plans p_plans = {.buf = p_buf, .buf_size = sizeof(p_buf)};
+  struct rk_graph p_pt = {.nodes = p_nodes, .node_count = 2, .root = &p_root, .plans = &p_plans};
+
+  ASSERT_OK(rk_node_add_child(&p_root, &p_a));
+  ASSERT_OK(rk_node_add_client(&p_a, &p_c));
+  ASSERT_OK(rk_node_add_client(&p_a, &p_c));
+
+  // The plan of a client with parallel edges to its first parent is only laid out once. p_c: p_root, p_a,
+  // p_root, p_a:
+  TEST_ASSERT_EQUAL(4 * sizeof(struct rk_node *), rk_plans_size(&p_pt));
+  ASSERT_OK(rk_init(&p_pt));
+  TEST_ASSERT_EQUAL(4, p_c.plan_len);
+  TEST_ASSERT_EQUAL_PTR(&p_buf[0], p_c.plan);
+
+  ASSERT_OK(rk_enable_client(&p_pt, &p_c));
+  ASSERT_NODE(p_root, true);
+  ASSERT_NODE(p_a, true);
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) { reset_states(); }
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_plans_size);
+  RUN_TEST(test_plans_same_callbacks);
+  RUN_TEST(test_plans_no_flood);
+  RUN_TEST(test_plans_outdated);
+  RUN_TEST(test_plans_parallel_edges);
+  return UNITY_END();
+}
@@ -0,0 +1,332 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//           +----+----+----+
+//                |         |
+//               n_c       n_d
+//
+// n_c has the parents n_a and n_b, n_d only has the parent n_b.
+// Clients: c_a (n_a), c_c (n_c), c_d (n_d) and c_ab (n_a and n_b).
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+struct rk_node n_root;
+struct rk_node n_a;
+struct rk_node n_b;
+struct rk_node n_c;
+struct rk_node n_d;
+
+struct rk_node *nodes[5];
+
+struct rk_graph pt;
+
+// CLIENTS:
+struct rk_client c_a;
+struct rk_client c_c;
+struct rk_client c_d;
+struct rk_client c_ab;
+
+// MOCK:
+size_t cb_calls = 0;
+
+int mock_cb_update(const struct rk_node *self) {
+  (void)self;
+  cb_calls++;
+  return 0;
+}
+
+void reset_node(struct rk_node *node, const char *name) {
+  memset(node, 0, sizeof(*node));
+  snprintf(node->name, sizeof(node->name), "%s", name);
+  node->cb_update = mock_cb_update;
+}
+
+void reset_client(struct rk_client *client, const char *name) {
+  memset(client, 0, sizeof(*client));
+  snprintf(client->name, sizeof(client->name), "%s", name);
+}
+
+// Reset the graph to its initial structure.
+void init_graph(void) {
+  reset_node(&n_root, "n_root");
+  reset_node(&n_a, "n_a");
+  reset_node(&n_b, "n_b");
+  reset_node(&n_c, "n_c");
+  reset_node(&n_d, "n_d");
+  reset_client(&c_a, "c_a");
+  reset_client(&c_c, "c_c");
+  reset_client(&c_d, "c_d");
+  reset_client(&c_ab, "c_ab");
+
+  nodes[0] = &n_root;
+  nodes[1] = &n_a;
+  nodes[2] = &n_b;
+  nodes[3] = &n_c;
+  nodes[4] = &n_d;
+  pt = (struct rk_graph){.nodes = nodes, .node_count = 5, .node_capacity = 5, .root = &n_root};
+
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_client(&n_a, &c_a);
+  rk_node_add_client(&n_a, &c_ab);
+
+  rk_node_add_child(&n_b, &n_c);
+  rk_node_add_child(&n_b, &n_d);
+  rk_node_add_client(&n_b, &c_ab);
+
+  rk_node_add_client(&n_c, &c_c);
+
+  rk_node_add_client(&n_d, &c_d);
+
+  TEST_ASSERT_EQUAL(0, rk_init(&pt));
+}
+
+// Check that the topological list is ordered by rank and only contains the nodes of the graph.
+void assert_topo_order_valid(void) {
+  size_t count = 0;
+  for (struct rk_node *node = &n_root; node != 0; node = node->ctx.ll_topo_next) {
+    for (size_t i = 0; i < node->parent_count; i++) {
+      TEST_ASSERT_LESS_THAN_MESSAGE(node->ctx.topo_rank, node->parents[i]->ctx.topo_rank, node->name);
+    }
+    if (node->ctx.ll_topo_next != 0) {
+      TEST_ASSERT_LESS_THAN(node->ctx.ll_topo_next->ctx.topo_rank, node->ctx.topo_rank);
+    }
+    TEST_ASSERT_EQUAL_PTR(node, pt.nodes[node->ctx.node_idx]);
+    count++;
+  }
+  TEST_ASSERT_EQUAL(pt.node_count, count);
+}
+
+// ======== Tests ==================================================================================
+
+void test_remove_child(void) {
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+
+  // n_c remains enabled through n_b. n_a is no longer required:
+  ASSERT_OK(rk_graph_remove_child(&pt, &n_a, &n_c));
+  TEST_ASSERT_EQUAL(0, n_a.child_count);
+  TEST_ASSERT_EQUAL(1, n_c.parent_count);
+  ASSERT_NODE(n_a, true);
+  ASSERT_NODE(n_c, true);
+
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  ASSERT_NODE(n_a, false);
+  ASSERT_NODE(n_b, true);
+  assert_graph_state_legal(&pt);
+  assert_topo_order_valid();
+
+  ASSERT_OK(rk_disable_client(&pt, &c_c));
+  for (size_t i = 0; i < pt.node_count; i++) {
+    ASSERT_NODE(*nodes[i], false);
+  }
+}
+
+void test_remove_child_invalid(void) {
+  // n_d has no other parent:
+  ASSERT_ERR(rk_graph_remove_child(&pt, &n_b, &n_d));
+
+  // Not a child:
+  ASSERT_ERR(rk_graph_remove_child(&pt, &n_a, &n_d));
+
+  ASSERT_ERR(rk_graph_remove_child(0, &n_b, &n_c));
+  ASSERT_ERR(rk_graph_remove_child(&pt, 0, &n_c));
+  ASSERT_ERR(rk_graph_remove_child(&pt, &n_b, 0));
+  TEST_ASSERT_EQUAL(2, n_b.child_count);
+}
+
+void test_remove_client(void) {
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+  ASSERT_OK(rk_enable_client(&pt, &c_ab));
+
+  // c_a is enabled, and has no other parent:
+  ASSERT_ERR(rk_graph_remove_client(&pt, &n_a, &c_a));
+
+  // n_b is no longer required:
+  ASSERT_OK(rk_graph_remove_client(&pt, &n_b, &c_ab));
+  TEST_ASSERT_EQUAL(1, c_ab.parent_count);
+  TEST_ASSERT_EQUAL(0, n_b.client_count);
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  ASSERT_NODE(n_a, true);
+  ASSERT_NODE(n_b, false);
+
+  // Disabled clients can be removed from their last parent:
+  ASSERT_OK(rk_disable_client(&pt, &c_a));
+  ASSERT_OK(rk_graph_remove_client(&pt, &n_a, &c_a));
+  TEST_ASSERT_EQUAL(0, c_a.parent_count);
+  TEST_ASSERT_EQUAL(1, n_a.client_count);
+
+  // Not a client:
+  ASSERT_ERR(rk_graph_remove_client(&pt, &n_a, &c_a));
+  ASSERT_ERR(rk_graph_remove_client(&pt, &n_a, 0));
+
+  ASSERT_OK(rk_disable_client(&pt, &c_ab));
+  for (size_t i = 0; i < pt.node_count; i++) {
+    ASSERT_NODE(*nodes[i], false);
+  }
+}
+
+void test_detach_leaf(void) {
+  ASSERT_OK(rk_graph_detach_node(&pt, &n_d));
+  TEST_ASSERT_EQUAL(4, pt.node_count);
+  TEST_ASSERT_EQUAL(0, n_d.parent_count);
+  TEST_ASSERT_EQUAL(0, n_d.client_count);
+  TEST_ASSERT_EQUAL(0, c_d.parent_count);
+  TEST_ASSERT_EQUAL(1, n_b.child_count);
+  assert_topo_order_valid();
+
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  ASSERT_OK(rk_optimize(&pt));
+  ASSERT_NODE(n_c, true);
+  ASSERT_NODE(n_d, false);
+  ASSERT_OK(rk_disable_client(&pt, &c_c));
+
+  // Node can be added again:
+  ASSERT_OK(rk_graph_add_child(&pt, 0, &n_b, &n_d));
+  ASSERT_OK(rk_graph_add_client(&pt, 0, &n_d, &c_d));
+  TEST_ASSERT_EQUAL(5, pt.node_count);
+  assert_topo_order_valid();
+
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_b, true);
+  ASSERT_NODE(n_d, true);
+  assert_graph_state_legal(&pt);
+}
+
+void test_detach_inner(void) {
+  // n_c keeps its other parent n_b. c_ab only depends on n_b:
+  ASSERT_OK(rk_graph_detach_node(&pt, &n_a));
+  TEST_ASSERT_EQUAL(4, pt.node_count);
+  TEST_ASSERT_EQUAL(1, n_c.parent_count);
+  TEST_ASSERT_EQUAL(1, c_ab.parent_count);
+  TEST_ASSERT_EQUAL(0, c_a.parent_count);
+  TEST_ASSERT_EQUAL(1, n_root.child_count);
+  assert_topo_order_valid();
+
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_a, false);
+  ASSERT_NODE(n_b, true);
+  ASSERT_NODE(n_c, true);
+  assert_graph_state_legal(&pt);
+}
+
+void test_detach_dirty(void) {
+  // n_a is enabled without any dependants:
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  ASSERT_OK(rk_graph_remove_child(&pt, &n_a, &n_c));
+  ASSERT_OK(rk_disable_client(&pt, &c_a));
+  ASSERT_NODE(n_a, false);
+
+  // Detached nodes are removed from the dirty list:
+  ASSERT_OK(rk_graph_detach_node(&pt, &n_a));
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  ASSERT_NODE(n_c, true);
+  assert_graph_state_legal(&pt);
+}
+
+void test_detach_refused(void) {
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+
+  // Root:
+  ASSERT_ERR(rk_graph_detach_node(&pt, &n_root));
+
+  // Required by an enabled client:
+  ASSERT_ERR(rk_graph_detach_node(&pt, &n_c));
+  ASSERT_ERR(rk_graph_detach_node(&pt, &n_a));
+
+  // Only parent of n_d:
+  ASSERT_ERR(rk_graph_detach_node(&pt, &n_b));
+
+  // Not part of the graph:
+  ASSERT_OK(rk_graph_detach_node(&pt, &n_d));
+  ASSERT_ERR(rk_graph_detach_node(&pt, &n_d));
+  ASSERT_ERR(rk_graph_detach_node(&pt, 0));
+
+  TEST_ASSERT_EQUAL(4, pt.node_count);
+  assert_topo_order_valid();
+}
+
+void test_detach_rank_gaps(void) {
+  // n_a leaves a gap between the ranks of n_root and n_b:
+  uint32_t rank_b = n_b.ctx.topo_rank;
+  ASSERT_OK(rk_graph_detach_node(&pt, &n_a));
+  TEST_ASSERT_EQUAL(rank_b, n_b.ctx.topo_rank);
+  TEST_ASSERT_GREATER_THAN(n_root.ctx.topo_rank + 1, n_b.ctx.topo_rank);
+  assert_topo_order_valid();
+
+  // Edges can still be added across the gap:
+  ASSERT_OK(rk_graph_add_child(&pt, 0, &n_d, &n_c));
+  ASSERT_OK(rk_graph_add_child(&pt, 0, &n_root, &n_a));
+  assert_topo_order_valid();
+
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  ASSERT_NODE(n_b, true);
+  ASSERT_NODE(n_d, true);
+  ASSERT_NODE(n_c, true);
+  assert_graph_state_legal(&pt);
+}
+
+void test_detach_indices(void) {
+  static void *csr_buf[64];
+  static void *plans_buf[64];
+  struct rk_csr csr = {.buf = csr_buf, .buf_size = sizeof(csr_buf)};
+  struct rk_plans plans = {.buf = plans_buf, .buf_size = sizeof(plans_buf)};
+  pt.csr = &csr;
+  pt.plans = &plans;
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_graph_detach_node(&pt, &n_a));
+
+  // Ranks are compacted when the indices are rebuilt:
+  ASSERT_OK(rk_enable_client(&pt, &c_ab));
+  for (struct rk_node *node = &n_root; node != 0; node = node->ctx.ll_topo_next) {
+    TEST_ASSERT_LESS_THAN(pt.node_count, node->ctx.topo_rank);
+    TEST_ASSERT_EQUAL_PTR(node, csr.order[node->ctx.topo_rank]);
+  }
+  TEST_ASSERT_EQUAL(2, c_ab.plan_len);
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_b, true);
+  assert_graph_state_legal(&pt);
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  init_graph();
+  cb_calls = 0;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_remove_child);
+  RUN_TEST(test_remove_child_invalid);
+  RUN_TEST(test_remove_client);
+  RUN_TEST(test_detach_leaf);
+  RUN_TEST(test_detach_inner);
+  RUN_TEST(test_detach_dirty);
+  RUN_TEST(test_detach_refused);
+  RUN_TEST(test_detach_rank_gaps);
+  RUN_TEST(test_detach_indices);
+  return UNITY_END();
+}
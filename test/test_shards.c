@@ -0,0 +1,510 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+// ======== Resource Graph =========================================================================
+
+//
+//                      n_root
+//                        |
+//         +--------+-----+--+--------+
+//         |        |        |        |
+//        n_a      n_b      n_c      n_d
+//         |        |        |
+//       n_a1     n_b1     n_c1
+//
+// Clients: c_root (n_root), c_a (n_a), c_a1 (n_a1), c_b1 (n_b1), c_rootb (n_root and n_b),
+// and c_cd (n_c1 and n_d), which joins n_c, n_c1 and n_d into a single shard.
+//
+// Shards: 0 = {n_a, n_a1}, 1 = {n_b, n_b1}, 2 = {n_c, n_c1, n_d}.
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+#define N_ROOT 0
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+#define N_A 1
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+#define N_A1 2
+struct rk_node n_a1 = {.name = "n_a1", .cb_update = mock_cb_update};
+#define N_B 3
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+#define N_B1 4
+struct rk_node n_b1 = {.name = "n_b1", .cb_update = mock_cb_update};
+#define N_C 5
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+#define N_C1 6
+struct rk_node n_c1 = {.name = "n_c1", .cb_update = mock_cb_update};
+#define N_D 7
+struct rk_node n_d = {.name = "n_d", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {[N_ROOT] = &n_root, [N_A] = &n_a, [N_A1] = &n_a1, [N_B] = &n_b,
+                           [N_B1] = &n_b1,     [N_C] = &n_c, [N_C1] = &n_c1, [N_D] = &n_d};
+
+#define NODE_COUNT (sizeof(nodes) / sizeof(nodes[0]))
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_a1 = {.name = "c_a1"};
+struct rk_client c_b1 = {.name = "c_b1"};
+struct rk_client c_rootb = {.name = "c_rootb"};
+struct rk_client c_cd = {.name = "c_cd"};
+
+struct rk_client *clients[] = {&c_root, &c_a, &c_a1, &c_b1, &c_rootb, &c_cd};
+
+#define CLIENT_COUNT (sizeof(clients) / sizeof(clients[0]))
+
+// LOCKS:
+#define SHARD_COUNT 3
+pthread_mutex_t shard_locks[SHARD_COUNT];
+pthread_mutex_t root_lock;
+
+// Number of locks held, and number of times a lock was taken, per shard (root last):
+int lock_depth[SHARD_COUNT + 1];
+size_t lock_calls[SHARD_COUNT + 1];
+
+// Root lock is held by the calling thread:
+_Thread_local bool root_lock_held = false;
+
+void mock_cb_lock(struct rk_graph *graph, uint32_t shard) {
+  (void)graph;
+  size_t idx = shard == RK_SHARD_ROOT ? SHARD_COUNT : shard;
+  pthread_mutex_lock(shard == RK_SHARD_ROOT ? &root_lock : &shard_locks[shard]);
+  lock_depth[idx]++;
+  lock_calls[idx]++;
+  if (shard == RK_SHARD_ROOT) root_lock_held = true;
+}
+
+void mock_cb_unlock(struct rk_graph *graph, uint32_t shard) {
+  (void)graph;
+  size_t idx = shard == RK_SHARD_ROOT ? SHARD_COUNT : shard;
+  if (shard == RK_SHARD_ROOT) root_lock_held = false;
+  lock_depth[idx]--;
+  pthread_mutex_unlock(shard == RK_SHARD_ROOT ? &root_lock : &shard_locks[shard]);
+}
+
+struct rk_shard shards_buf[SHARD_COUNT];
+struct rk_shards shards = {
+    .buf = shards_buf, .buf_size = sizeof(shards_buf), .cb_lock = mock_cb_lock, .cb_unlock = mock_cb_unlock};
+
+struct rk_stats stats;
+
+struct rk_graph pt = {.nodes = nodes, .node_count = NODE_COUNT, .root = &n_root, .stats = &stats};
+
+// MOCK:
+struct rk_node *failing_node = 0;
+
+// Number of callbacks that enabled a node while one of its parents was disabled:
+atomic_uint illegal_updates;
+
+// Number of callbacks of nodes other than the root called while holding the root lock:
+atomic_uint root_locked_updates;
+
+struct cb_call {
+  const struct rk_node *node;
+  bool desired_state;
+};
+
+struct cb_call cb_log[128];
+size_t cb_log_len = 0;
+bool cb_log_enabled = false;
+
+int mock_cb_update(const struct rk_node *self) {
+  if (self != &n_root && root_lock_held) {
+    atomic_fetch_add(&root_locked_updates, 1);
+  }
+
+  if (self->desired_state) {
+    for (size_t i = 0; i < self->parent_count; i++) {
+      if (!self->parents[i]->state) {
+        atomic_fetch_add(&illegal_updates, 1);
+      }
+    }
+  }
+
+  if (cb_log_enabled) {
+    TEST_ASSERT_LESS_THAN(sizeof(cb_log) / sizeof(cb_log[0]), cb_log_len);
+    cb_log[cb_log_len].node = self;
+    cb_log[cb_log_len].desired_state = self->desired_state;
+    cb_log_len++;
+  }
+
+  return self == failing_node ? -1 : 0;
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_child(&n_root, &n_c);
+  rk_node_add_child(&n_root, &n_d);
+  rk_node_add_client(&n_root, &c_root);
+  rk_node_add_client(&n_root, &c_rootb);
+
+  rk_node_add_child(&n_a, &n_a1);
+  rk_node_add_client(&n_a, &c_a);
+  rk_node_add_client(&n_a1, &c_a1);
+
+  rk_node_add_child(&n_b, &n_b1);
+  rk_node_add_client(&n_b, &c_rootb);
+  rk_node_add_client(&n_b1, &c_b1);
+
+  rk_node_add_child(&n_c, &n_c1);
+  rk_node_add_client(&n_c1, &c_cd);
+  rk_node_add_client(&n_d, &c_cd);
+
+  for (size_t i = 0; i < SHARD_COUNT; i++) {
+    pthread_mutex_init(&shard_locks[i], 0);
+  }
+  pthread_mutex_init(&root_lock, 0);
+}
+
+void assert_graph_state_optimal(void) {
+  assert_graph_state_legal(&pt);
+  bool any = false;
+  for (size_t i = 0; i < CLIENT_COUNT; i++) {
+    any = any || clients[i]->enabled;
+  }
+  ASSERT_NODE(n_root, any);
+  ASSERT_NODE(n_a, c_a.enabled || c_a1.enabled);
+  ASSERT_NODE(n_a1, c_a1.enabled);
+  ASSERT_NODE(n_b, c_b1.enabled || c_rootb.enabled);
+  ASSERT_NODE(n_b1, c_b1.enabled);
+  ASSERT_NODE(n_c, c_cd.enabled);
+  ASSERT_NODE(n_c1, c_cd.enabled);
+  ASSERT_NODE(n_d, c_cd.enabled);
+}
+
+void assert_no_locks_held(void) {
+  for (size_t i = 0; i <= SHARD_COUNT; i++) {
+    TEST_ASSERT_EQUAL(0, lock_depth[i]);
+  }
+}
+
+// Run a sequence of requests, and record the resulting callback calls and work counters.
+void run_sequence(struct cb_call *log, size_t *log_len, struct rk_stats_snapshot *snapshot) {
+  for (size_t i = 0; i < NODE_COUNT; i++) {
+    nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < CLIENT_COUNT; i++) {
+    clients[i]->enabled = false;
+  }
+  ASSERT_OK(rk_init(&pt));
+  rk_stats_reset(&stats);
+  cb_log_len = 0;
+  cb_log_enabled = true;
+
+  ASSERT_OK(rk_enable_client(&pt, &c_a1));
+  ASSERT_OK(rk_enable_client(&pt, &c_cd));
+  ASSERT_OK(rk_enable_client(&pt, &c_rootb));
+  ASSERT_OK(rk_enable_client(&pt, &c_root));
+  ASSERT_OK(rk_disable_client(&pt, &c_a1));
+  ASSERT_OK(rk_enable_client_atomic(&pt, &c_b1));
+  ASSERT_OK(rk_disable_client(&pt, &c_rootb));
+  ASSERT_OK(rk_disable_client(&pt, &c_root));
+  ASSERT_OK(rk_disable_client(&pt, &c_cd));
+
+  failing_node = &n_a1;
+  ASSERT_ERR(rk_enable_client(&pt, &c_a1));
+  ASSERT_ERR(rk_enable_client_atomic(&pt, &c_a1));
+  failing_node = &n_b1;
+  ASSERT_ERR(rk_disable_client(&pt, &c_b1));
+  failing_node = 0;
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  assert_graph_state_optimal();
+
+  cb_log_enabled = false;
+  memcpy(log, cb_log, sizeof(cb_log));
+  *log_len = cb_log_len;
+  rk_stats_read(&stats, snapshot);
+}
+
+// Randomly enable and disable a set of clients.
+struct worker {
+  pthread_t thread;
+  struct rk_client **clients;
+  size_t client_count;
+  uint32_t rng_state;
+  int err;
+};
+
+void *run_worker(void *arg) {
+  struct worker *w = arg;
+
+  for (size_t round = 0; round < 20000; round++) {
+    w->rng_state = w->rng_state * 1103515245u + 12345u;
+    uint32_t rnd = w->rng_state >> 16;
+    struct rk_client *client = w->clients[rnd % w->client_count];
+
+    int err;
+    if (client->enabled) {
+      err = rk_disable_client(&pt, client);
+    } else if (rnd & 0x100) {
+      err = rk_enable_client_atomic(&pt, client);
+    } else {
+      err = rk_enable_client(&pt, client);
+    }
+    if (err) w->err = err;
+  }
+
+  return 0;
+}
+
+// ======== Tests ==================================================================================
+
+void test_shards_size(void) {
+  TEST_ASSERT_EQUAL(SHARD_COUNT * sizeof(struct rk_shard), rk_shards_size(&pt));
+  TEST_ASSERT_EQUAL(0, rk_shards_size(0));
+
+  ASSERT_OK(rk_init(&pt));
+  TEST_ASSERT_EQUAL(SHARD_COUNT, shards.shard_count);
+
+  // Buffer too small:
+  shards.buf_size = sizeof(shards_buf) - 1;
+  ASSERT_ERR(rk_init(&pt));
+  shards.buf_size = sizeof(shards_buf);
+
+  // Lock callbacks are required:
+  shards.cb_unlock = 0;
+  ASSERT_ERR(rk_init(&pt));
+  shards.cb_unlock = mock_cb_unlock;
+
+  ASSERT_OK(rk_init(&pt));
+}
+
+void test_shards_components(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  TEST_ASSERT_EQUAL(RK_SHARD_ROOT, rk_client_shard(&pt, &c_root));
+  TEST_ASSERT_EQUAL(0, rk_client_shard(&pt, &c_a));
+  TEST_ASSERT_EQUAL(0, rk_client_shard(&pt, &c_a1));
+  TEST_ASSERT_EQUAL(1, rk_client_shard(&pt, &c_b1));
+  TEST_ASSERT_EQUAL(1, rk_client_shard(&pt, &c_rootb));
+  TEST_ASSERT_EQUAL(2, rk_client_shard(&pt, &c_cd));
+  TEST_ASSERT_EQUAL(RK_SHARD_ROOT, rk_client_shard(&pt, 0));
+
+  // Every shard lists its nodes in topological order:
+  TEST_ASSERT_EQUAL(2, shards.shard[0].node_count);
+  TEST_ASSERT_EQUAL(2, shards.shard[1].node_count);
+  TEST_ASSERT_EQUAL(3, shards.shard[2].node_count);
+  TEST_ASSERT_EQUAL_PTR(&n_a, shards.shard[0].ll_topo_head);
+  TEST_ASSERT_EQUAL_PTR(&n_a1, n_a.ctx.ll_shard);
+  TEST_ASSERT_NULL(n_a1.ctx.ll_shard);
+
+  size_t count = 0;
+  struct rk_node *prev = 0;
+  for (struct rk_node *node = shards.shard[2].ll_topo_head; node != 0; node = node->ctx.ll_shard) {
+    TEST_ASSERT_EQUAL(2, node->ctx.shard);
+    if (prev != 0) TEST_ASSERT_LESS_THAN(node->ctx.topo_rank, prev->ctx.topo_rank);
+    prev = node;
+    count++;
+  }
+  TEST_ASSERT_EQUAL(3, count);
+
+  // Unsharded graphs have no shards:
+  pt.shards = 0;
+  ASSERT_OK(rk_init(&pt));
+  TEST_ASSERT_EQUAL(RK_SHARD_ROOT, rk_client_shard(&pt, &c_a1));
+  pt.shards = &shards;
+}
+
+void test_shards_locks(void) {
+  ASSERT_OK(rk_init(&pt));
+  memset(lock_calls, 0, sizeof(lock_calls));
+  atomic_store(&root_locked_updates, 0);
+
+  // Only the client's shard and the root are locked:
+  ASSERT_OK(rk_enable_client(&pt, &c_a1));
+  assert_no_locks_held();
+  TEST_ASSERT_EQUAL(1, lock_calls[0]);
+  TEST_ASSERT_EQUAL(0, lock_calls[1]);
+  TEST_ASSERT_EQUAL(0, lock_calls[2]);
+  TEST_ASSERT_GREATER_THAN(0, lock_calls[SHARD_COUNT]);
+
+  ASSERT_OK(rk_disable_client(&pt, &c_a1));
+  assert_no_locks_held();
+  TEST_ASSERT_EQUAL(2, lock_calls[0]);
+
+  // Clients that only depend on the root only take the root lock:
+  memset(lock_calls, 0, sizeof(lock_calls));
+  ASSERT_OK(rk_enable_client(&pt, &c_root));
+  assert_no_locks_held();
+  TEST_ASSERT_EQUAL(0, lock_calls[0] + lock_calls[1] + lock_calls[2]);
+  TEST_ASSERT_EQUAL(1, lock_calls[SHARD_COUNT]);
+
+  // Locks are released if a request fails:
+  failing_node = &n_c1;
+  ASSERT_ERR(rk_enable_client_atomic(&pt, &c_cd));
+  assert_no_locks_held();
+  failing_node = 0;
+  assert_graph_state_optimal();
+
+  // Callbacks of the root's children are called while only holding the lock of their shard:
+  ASSERT_OK(rk_enable_client(&pt, &c_cd));
+  ASSERT_OK(rk_disable_client(&pt, &c_cd));
+  TEST_ASSERT_EQUAL(0, atomic_load(&root_locked_updates));
+}
+
+void test_shards_same_callbacks(void) {
+  static struct cb_call log_global[128];
+  static struct cb_call log_sharded[128];
+  size_t log_global_len;
+  size_t log_sharded_len;
+  struct rk_stats_snapshot stats_global;
+  struct rk_stats_snapshot stats_sharded;
+
+  pt.shards = 0;
+  run_sequence(log_global, &log_global_len, &stats_global);
+
+  pt.shards = &shards;
+  run_sequence(log_sharded, &log_sharded_len, &stats_sharded);
+
+  TEST_ASSERT_EQUAL(log_global_len, log_sharded_len);
+  for (size_t i = 0; i < log_global_len; i++) {
+    TEST_ASSERT_EQUAL_PTR(log_global[i].node, log_sharded[i].node);
+    TEST_ASSERT_EQUAL(log_global[i].desired_state, log_sharded[i].desired_state);
+  }
+
+  // Sharded requests perform the same work:
+  TEST_ASSERT_EQUAL(stats_global.flood_visits, stats_sharded.flood_visits);
+  TEST_ASSERT_EQUAL(stats_global.topo_visits, stats_sharded.topo_visits);
+  TEST_ASSERT_EQUAL(stats_global.dependant_evals, stats_sharded.dependant_evals);
+  TEST_ASSERT_EQUAL(stats_global.cb_calls, stats_sharded.cb_calls);
+  TEST_ASSERT_EQUAL(0, atomic_load(&illegal_updates));
+}
+
+void test_shards_dirty(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  // n_c and n_root are left enabled by the failed enable. The parents of the client are tracked by
+  // the "dirty" list of shard 2:
+  failing_node = &n_c1;
+  ASSERT_ERR(rk_enable_client(&pt, &c_cd));
+  ASSERT_NODE(n_c, true);
+  TEST_ASSERT_EQUAL_PTR(&n_d, shards.shard[2].ll_dirty_head);
+  TEST_ASSERT_EQUAL_PTR(&n_c1, n_d.ctx.ll_dirty);
+  TEST_ASSERT_NULL(pt.ll_dirty_head);
+  failing_node = 0;
+
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  assert_graph_state_optimal();
+  TEST_ASSERT_NULL(shards.shard[2].ll_dirty_head);
+  TEST_ASSERT_NULL(pt.ll_dirty_head);
+}
+
+void test_shards_unsupported(void) {
+  struct rk_bitset bitset = {0};
+  pt.bitset = &bitset;
+  ASSERT_ERR(rk_init(&pt));
+  pt.bitset = 0;
+}
+
+void test_shards_modify(void) {
+  ASSERT_OK(rk_init(&pt));
+  TEST_ASSERT_EQUAL(SHARD_COUNT, shards.shard_count);
+
+  // n_c1 and n_d are on the "dirty" list of shard 2:
+  failing_node = &n_c1;
+  ASSERT_ERR(rk_enable_client(&pt, &c_cd));
+  failing_node = 0;
+
+  // A client that depends on n_a and n_b joins their shards, which are rebuilt by the modification:
+  struct rk_client c_extra = {.name = "c_extra"};
+  ASSERT_OK(rk_graph_add_client(&pt, 0, &n_a, &c_extra));
+  ASSERT_OK(rk_graph_add_client(&pt, 0, &n_b, &c_extra));
+  TEST_ASSERT_EQUAL(SHARD_COUNT - 1, shards.shard_count);
+
+  // Dirty nodes moved to the list of their new shard:
+  TEST_ASSERT_NOT_NULL(shards.shard[n_d.ctx.shard].ll_dirty_head);
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  assert_graph_state_optimal();
+  TEST_ASSERT_NULL(shards.shard[0].ll_dirty_head);
+  TEST_ASSERT_NULL(shards.shard[1].ll_dirty_head);
+  TEST_ASSERT_EQUAL(rk_client_shard(&pt, &c_a1), rk_client_shard(&pt, &c_b1));
+  TEST_ASSERT_EQUAL(rk_client_shard(&pt, &c_a1), rk_client_shard(&pt, &c_extra));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_extra));
+  ASSERT_NODE(n_a, true);
+  ASSERT_NODE(n_b, true);
+  ASSERT_OK(rk_disable_client(&pt, &c_extra));
+  assert_no_locks_held();
+
+  // The shards are split again once the client is removed:
+  ASSERT_OK(rk_graph_remove_client(&pt, &n_b, &c_extra));
+  ASSERT_OK(rk_graph_remove_client(&pt, &n_a, &c_extra));
+  TEST_ASSERT_EQUAL(SHARD_COUNT, shards.shard_count);
+  TEST_ASSERT_NOT_EQUAL(rk_client_shard(&pt, &c_a1), rk_client_shard(&pt, &c_b1));
+  assert_graph_state_optimal();
+}
+
+void test_shards_concurrent(void) {
+  ASSERT_OK(rk_init(&pt));
+  atomic_store(&illegal_updates, 0);
+  atomic_store(&root_locked_updates, 0);
+
+  struct rk_client *clients_a[] = {&c_a, &c_a1};
+  struct rk_client *clients_b[] = {&c_b1, &c_rootb};
+  struct rk_client *clients_c[] = {&c_cd};
+  struct rk_client *clients_root[] = {&c_root};
+  struct worker workers[] = {
+      {.clients = clients_a, .client_count = 2, .rng_state = 1},
+      {.clients = clients_b, .client_count = 2, .rng_state = 2},
+      {.clients = clients_c, .client_count = 1, .rng_state = 3},
+      {.clients = clients_root, .client_count = 1, .rng_state = 4},
+  };
+  size_t worker_count = sizeof(workers) / sizeof(workers[0]);
+
+  for (size_t i = 0; i < worker_count; i++) {
+    TEST_ASSERT_EQUAL(0, pthread_create(&workers[i].thread, 0, run_worker, &workers[i]));
+  }
+  for (size_t i = 0; i < worker_count; i++) {
+    TEST_ASSERT_EQUAL(0, pthread_join(workers[i].thread, 0));
+    TEST_ASSERT_EQUAL(0, workers[i].err);
+  }
+
+  assert_no_locks_held();
+  TEST_ASSERT_EQUAL(0, atomic_load(&illegal_updates));
+  TEST_ASSERT_EQUAL(0, atomic_load(&root_locked_updates));
+  assert_graph_state_optimal();
+
+  // Counters are consistent with the final state:
+  ASSERT_OK(rk_optimize(&pt));
+  assert_graph_state_optimal();
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < NODE_COUNT; i++) {
+    nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < CLIENT_COUNT; i++) {
+    clients[i]->enabled = false;
+  }
+  pt.shards = &shards;
+  failing_node = 0;
+  cb_log_enabled = false;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_shards_size);
+  RUN_TEST(test_shards_components);
+  RUN_TEST(test_shards_locks);
+  RUN_TEST(test_shards_same_callbacks);
+  RUN_TEST(test_shards_dirty);
+  RUN_TEST(test_shards_unsupported);
+  RUN_TEST(test_shards_modify);
+  RUN_TEST(test_shards_concurrent);
+  return UNITY_END();
+}
@@ -0,0 +1,159 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root ----------+
+//                |              |
+//               n_a             |
+//                |              |
+//           +----+----+         |
+//           |         |         |
+//          n_b       n_c        |
+//           |         |         |
+//           +----+----+         |
+//                |              |
+//               n_d ------------+
+//
+// Redundant edges: n_root -> n_d (n_d depends on n_root through n_a), and a second, parallel edge
+// n_a -> n_b.
+// Clients: c_d (n_d), c_bd (n_b and n_d, n_b being redundant), c_aa (n_a twice) and c_bc (n_b and n_c).
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+struct rk_node n_d = {.name = "n_d", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {&n_d, &n_c, &n_b, &n_a, &n_root};
+
+struct rk_graph pt = {
+    .nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root, .simplify = true};
+
+// CLIENTS:
+struct rk_client c_d = {.name = "c_d"};
+struct rk_client c_bd = {.name = "c_bd"};
+struct rk_client c_aa = {.name = "c_aa"};
+struct rk_client c_bc = {.name = "c_bc"};
+
+struct rk_client *clients[] = {&c_d, &c_bd, &c_aa, &c_bc};
+
+// MOCK:
+size_t cb_calls = 0;
+
+int mock_cb_update(const struct rk_node *self) {
+  (void)self;
+  cb_calls++;
+  return 0;
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_d);
+
+  rk_node_add_child(&n_a, &n_b);
+  rk_node_add_child(&n_a, &n_b);
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_client(&n_a, &c_aa);
+  rk_node_add_client(&n_a, &c_aa);
+
+  rk_node_add_child(&n_b, &n_d);
+  rk_node_add_client(&n_b, &c_bd);
+  rk_node_add_client(&n_b, &c_bc);
+
+  rk_node_add_child(&n_c, &n_d);
+  rk_node_add_client(&n_c, &c_bc);
+
+  rk_node_add_client(&n_d, &c_d);
+  rk_node_add_client(&n_d, &c_bd);
+}
+
+// ======== Tests ==================================================================================
+
+void test_simplify_edges(void) {
+  ASSERT_OK(rk_init(&pt));
+  TEST_ASSERT_EQUAL(4, pt.edges_removed);
+
+  TEST_ASSERT_EQUAL(1, n_root.child_count);
+  TEST_ASSERT_EQUAL_PTR(&n_a, n_root.children[0]);
+
+  TEST_ASSERT_EQUAL(2, n_a.child_count);
+  TEST_ASSERT_EQUAL_PTR(&n_b, n_a.children[0]);
+  TEST_ASSERT_EQUAL_PTR(&n_c, n_a.children[1]);
+  TEST_ASSERT_EQUAL(1, n_b.parent_count);
+
+  TEST_ASSERT_EQUAL(2, n_d.parent_count);
+  TEST_ASSERT_EQUAL_PTR(&n_b, n_d.parents[0]);
+  TEST_ASSERT_EQUAL_PTR(&n_c, n_d.parents[1]);
+
+  TEST_ASSERT_EQUAL(1, c_bd.parent_count);
+  TEST_ASSERT_EQUAL_PTR(&n_d, c_bd.parents[0]);
+  TEST_ASSERT_EQUAL(1, n_b.client_count);
+  TEST_ASSERT_EQUAL_PTR(&c_bc, n_b.clients[0]);
+
+  TEST_ASSERT_EQUAL(1, c_aa.parent_count);
+  TEST_ASSERT_EQUAL(1, n_a.client_count);
+
+  // Clients without redundant parents are unchanged:
+  TEST_ASSERT_EQUAL(2, c_bc.parent_count);
+
+  // Nothing left to remove:
+  ASSERT_OK(rk_init(&pt));
+  TEST_ASSERT_EQUAL(0, pt.edges_removed);
+}
+
+void test_simplify_same_states(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_bd));
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_a, true);
+  ASSERT_NODE(n_b, true);
+  ASSERT_NODE(n_c, true);
+  ASSERT_NODE(n_d, true);
+  assert_graph_state_legal(&pt);
+
+  ASSERT_OK(rk_enable_client(&pt, &c_aa));
+  ASSERT_OK(rk_disable_client(&pt, &c_bd));
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_a, true);
+  ASSERT_NODE(n_b, false);
+  ASSERT_NODE(n_c, false);
+  ASSERT_NODE(n_d, false);
+
+  ASSERT_OK(rk_disable_client(&pt, &c_aa));
+  for (size_t i = 0; i < pt.node_count; i++) {
+    ASSERT_NODE(*nodes[i], false);
+  }
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+  cb_calls = 0;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_simplify_edges);
+  RUN_TEST(test_simplify_same_states);
+  return UNITY_END();
+}
@@ -0,0 +1,208 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |
+//          n_c
+//
+// All nodes have a single, identically named client (n_root -> c_root, n_a -> c_a etc).
+// n_b has no callback.
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+struct rk_node n_b = {.name = "n_b"};
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {&n_root, &n_a, &n_b, &n_c};
+
+// COUNTERS:
+struct rk_stats stats;
+
+// Compiled graph:
+void *csr_buf[16];
+struct rk_csr csr = {.buf = csr_buf, .buf_size = sizeof(csr_buf)};
+
+struct rk_graph pt = {
+    .nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root, .stats = &stats};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_b = {.name = "c_b"};
+struct rk_client c_c = {.name = "c_c"};
+
+struct rk_client *clients[] = {&c_root, &c_a, &c_b, &c_c};
+
+struct rk_node *failing_node = 0;
+
+int mock_cb_update(const struct rk_node *self) { return self == failing_node ? -1 : 0; }
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_client(&n_a, &c_a);
+
+  rk_node_add_client(&n_b, &c_b);
+
+  rk_node_add_client(&n_c, &c_c);
+}
+
+void assert_stats(uint32_t requests, uint32_t flood_visits, uint32_t topo_visits, uint32_t dependant_evals,
+                  uint32_t cb_calls, uint32_t cb_transitions, uint32_t cb_failures) {
+  struct rk_stats_snapshot snapshot;
+  rk_stats_read(&stats, &snapshot);
+  TEST_ASSERT_EQUAL_MESSAGE(requests, snapshot.requests, "requests");
+  TEST_ASSERT_EQUAL_MESSAGE(flood_visits, snapshot.flood_visits, "flood_visits");
+  TEST_ASSERT_EQUAL_MESSAGE(topo_visits, snapshot.topo_visits, "topo_visits");
+  TEST_ASSERT_EQUAL_MESSAGE(dependant_evals, snapshot.dependant_evals, "dependant_evals");
+  TEST_ASSERT_EQUAL_MESSAGE(cb_calls, snapshot.cb_calls, "cb_calls");
+  TEST_ASSERT_EQUAL_MESSAGE(cb_transitions, snapshot.cb_transitions, "cb_transitions");
+  TEST_ASSERT_EQUAL_MESSAGE(cb_failures, snapshot.cb_failures, "cb_failures");
+}
+
+// ======== Tests ==================================================================================
+
+void test_stats_enable_disable(void) {
+  ASSERT_OK(rk_init(&pt));
+  assert_stats(0, 0, 0, 0, 0, 0, 0);
+
+  // Flood visits n_c, n_a and n_root, all of which are enabled:
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  assert_stats(1, 3, 3, 0, 3, 3, 0);
+
+  // n_root is already on. n_b has no callback:
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+  assert_stats(2, 5, 5, 0, 4, 3, 0);
+
+  // n_root remains on, and is not visited. Disabling does not flood:
+  ASSERT_OK(rk_disable_client(&pt, &c_c));
+  assert_stats(3, 5, 7, 0, 6, 5, 0);
+}
+
+void test_stats_compiled(void) {
+  pt.csr = &csr;
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+  ASSERT_OK(rk_disable_client(&pt, &c_c));
+  assert_stats(3, 5, 7, 0, 6, 5, 0);
+
+  pt.csr = 0;
+}
+
+// Enabling a client stops the flood at nodes that are already enabled:
+void assert_enable_pruned(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+  rk_stats_reset(&stats);
+
+  // Only n_c and n_a are visited, but not n_root:
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  assert_stats(1, 2, 2, 0, 2, 1, 0);
+
+  // Only n_c is visited:
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  assert_stats(2, 3, 3, 0, 3, 1, 0);
+}
+
+void test_stats_enable_pruned(void) { assert_enable_pruned(); }
+
+void test_stats_enable_pruned_compiled(void) {
+  pt.csr = &csr;
+  assert_enable_pruned();
+  pt.csr = 0;
+}
+
+void test_stats_apply_optimize(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  struct rk_client *enable_list[] = {&c_b, &c_c};
+  ASSERT_OK(rk_apply(&pt, enable_list, 2, 0, 0));
+  assert_stats(1, 4, 4, 4, 3, 3, 0);
+
+  // Optimizing walks the whole graph:
+  ASSERT_OK(rk_optimize(&pt));
+  assert_stats(2, 4, 8, 8, 6, 3, 0);
+}
+
+void test_stats_failure(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  failing_node = &n_a;
+  ASSERT_ERR(rk_enable_client(&pt, &c_c));
+  assert_stats(1, 3, 2, 0, 2, 1, 1);
+}
+
+void test_stats_reset(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  rk_stats_reset(&stats);
+  assert_stats(0, 0, 0, 0, 0, 0, 0);
+
+  // n_a is already enabled, and the flood stops there:
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+  assert_stats(1, 1, 1, 0, 1, 0, 0);
+}
+
+void test_stats_optional(void) {
+  pt.stats = 0;
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  pt.stats = &stats;
+  assert_stats(0, 0, 0, 0, 0, 0, 0);
+
+  // Invalid arguments are ignored:
+  struct rk_stats_snapshot snapshot;
+  rk_stats_read(0, &snapshot);
+  rk_stats_read(&stats, 0);
+  rk_stats_reset(0);
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+  rk_stats_reset(&stats);
+  failing_node = 0;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_stats_enable_disable);
+  RUN_TEST(test_stats_compiled);
+  RUN_TEST(test_stats_enable_pruned);
+  RUN_TEST(test_stats_enable_pruned_compiled);
+  RUN_TEST(test_stats_apply_optimize);
+  RUN_TEST(test_stats_failure);
+  RUN_TEST(test_stats_reset);
+  RUN_TEST(test_stats_optional);
+  return UNITY_END();
+}
@@ -0,0 +1,326 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//        +-------+--- ... ---+
+//        |       |           |
+//       n_0     n_1   ...  n_29
+//
+// The graph initially only contains the root and its children. Edges between the children are added
+// after the graph has been initialized, always from a node with a lower to a node with a higher index.
+// Up to two nodes (n_new0 and n_new1) are hot-plugged into the graph.
+
+#define CHILD_COUNT 30
+#define NODE_CAPACITY (CHILD_COUNT + 3)
+
+int mock_cb_update(const struct rk_node *self);
+
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_child[CHILD_COUNT];
+struct rk_node n_new[2] = {{.name = "n_new0"}, {.name = "n_new1"}};
+struct rk_node *nodes[NODE_CAPACITY];
+
+struct rk_client c_last = {.name = "c_last"};
+struct rk_client c_new = {.name = "c_new"};
+
+void *arena_buf[2048];
+struct rk_arena arena = {.buf = arena_buf, .size = sizeof(arena_buf)};
+
+struct rk_graph pt = {.nodes = nodes, .root = &n_root};
+
+// MOCK:
+size_t cb_calls = 0;
+
+int mock_cb_update(const struct rk_node *self) {
+  (void)self;
+  cb_calls++;
+  return 0;
+}
+
+uint32_t rng_state = 1;
+
+uint32_t rng(void) {
+  rng_state = rng_state * 1103515245u + 12345u;
+  return rng_state >> 16;
+}
+
+// Reset the graph to its initial structure. Nodes are listed in reverse, so that the initial
+// topological order differs from the order of the edges that are added.
+void init_graph(void) {
+  memset(&n_root, 0, sizeof(n_root));
+  snprintf(n_root.name, sizeof(n_root.name), "n_root");
+  n_root.cb_update = mock_cb_update;
+
+  for (size_t i = 0; i < CHILD_COUNT; i++) {
+    memset(&n_child[i], 0, sizeof(n_child[i]));
+    snprintf(n_child[i].name, sizeof(n_child[i].name), "n_%zu", i);
+    n_child[i].cb_update = mock_cb_update;
+  }
+  for (size_t i = 0; i < 2; i++) {
+    memset(&n_new[i], 0, sizeof(n_new[i]));
+    snprintf(n_new[i].name, sizeof(n_new[i].name), "n_new%zu", i);
+  }
+  memset(&c_last, 0, sizeof(c_last));
+  snprintf(c_last.name, sizeof(c_last.name), "c_last");
+  memset(&c_new, 0, sizeof(c_new));
+  snprintf(c_new.name, sizeof(c_new.name), "c_new");
+  arena.used = 0;
+
+  nodes[0] = &n_root;
+  for (size_t i = 0; i < CHILD_COUNT; i++) {
+    nodes[1 + i] = &n_child[CHILD_COUNT - 1 - i];
+    TEST_ASSERT_EQUAL(0, rk_node_add_child_arena(&arena, &n_root, &n_child[CHILD_COUNT - 1 - i]));
+  }
+  TEST_ASSERT_EQUAL(0, rk_node_add_client(&n_child[CHILD_COUNT - 1], &c_last));
+
+  pt = (struct rk_graph){
+      .nodes = nodes, .node_count = CHILD_COUNT + 1, .node_capacity = NODE_CAPACITY, .root = &n_root};
+}
+
+// Check that all nodes are ranked in a valid topological order, and that the topological list
+// matches the ranks.
+void assert_topo_order_valid(void) {
+  size_t count = 0;
+  struct rk_node *prev = 0;
+  for (struct rk_node *node = &n_root; node != 0; node = node->ctx.ll_topo_next) {
+    TEST_ASSERT_EQUAL_MESSAGE(count, node->ctx.topo_rank, node->name);
+    TEST_ASSERT_EQUAL_PTR_MESSAGE(prev, node->ctx.ll_topo_prev, node->name);
+    for (size_t i = 0; i < node->parent_count; i++) {
+      TEST_ASSERT_LESS_THAN_MESSAGE(node->ctx.topo_rank, node->parents[i]->ctx.topo_rank, node->name);
+    }
+    prev = node;
+    count++;
+  }
+  TEST_ASSERT_EQUAL(pt.node_count, count);
+  TEST_ASSERT_EQUAL_PTR(prev, pt.ll_topo_tail);
+}
+
+// ======== Tests ==================================================================================
+
+void test_topo_reorder(void) {
+  ASSERT_OK(rk_init(&pt));
+  assert_topo_order_valid();
+
+  // n_0 is initially ranked last:
+  TEST_ASSERT_EQUAL(CHILD_COUNT, n_child[0].ctx.topo_rank);
+
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[0], &n_child[1]));
+  assert_topo_order_valid();
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[1], &n_child[2]));
+  assert_topo_order_valid();
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[2], &n_child[CHILD_COUNT - 1]));
+  assert_topo_order_valid();
+
+  // The graph can be used without calling rk_init():
+  ASSERT_OK(rk_enable_client(&pt, &c_last));
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_child[0], true);
+  ASSERT_NODE(n_child[1], true);
+  ASSERT_NODE(n_child[2], true);
+  ASSERT_NODE(n_child[3], false);
+  ASSERT_NODE(n_child[CHILD_COUNT - 1], true);
+  assert_graph_state_legal(&pt);
+
+  ASSERT_OK(rk_disable_client(&pt, &c_last));
+  for (size_t i = 0; i < pt.node_count; i++) {
+    ASSERT_NODE(*nodes[i], false);
+  }
+}
+
+void test_topo_random_edges(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  for (size_t i = 0; i < 100; i++) {
+    uint32_t a = rng() % CHILD_COUNT;
+    uint32_t b = rng() % CHILD_COUNT;
+    if (a == b) continue;
+    if (a > b) {
+      uint32_t tmp = a;
+      a = b;
+      b = tmp;
+    }
+    ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[a], &n_child[b]));
+    assert_topo_order_valid();
+  }
+
+  // Same order as a full sort:
+  ASSERT_OK(rk_init(&pt));
+  assert_topo_order_valid();
+}
+
+void test_topo_cycle(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[0], &n_child[1]));
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[1], &n_child[2]));
+
+  // n_2 -> n_0 closes the cycle n_0 -> n_1 -> n_2 -> n_0:
+  ASSERT_ERR(rk_graph_add_child(&pt, &arena, &n_child[2], &n_child[0]));
+  TEST_ASSERT_EQUAL(0, n_child[2].child_count);
+  TEST_ASSERT_EQUAL(1, n_child[0].parent_count);
+  assert_topo_order_valid();
+
+  // Self-loops and edges to the root are cycles:
+  ASSERT_ERR(rk_graph_add_child(&pt, &arena, &n_child[3], &n_child[3]));
+  ASSERT_ERR(rk_graph_add_child(&pt, &arena, &n_child[3], &n_root));
+  assert_topo_order_valid();
+
+  // Adding the edge in the other direction is possible:
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[0], &n_child[2]));
+  assert_topo_order_valid();
+}
+
+void test_topo_new_nodes(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[5], &n_new[0]));
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_new[0], &n_new[1]));
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[6], &n_new[1]));
+  ASSERT_OK(rk_graph_add_client(&pt, &arena, &n_new[1], &c_new));
+  TEST_ASSERT_EQUAL(CHILD_COUNT + 3, pt.node_count);
+  TEST_ASSERT_EQUAL_PTR(&n_new[1], nodes[CHILD_COUNT + 2]);
+  assert_topo_order_valid();
+
+  ASSERT_OK(rk_enable_client(&pt, &c_new));
+  ASSERT_NODE(n_new[0], true);
+  ASSERT_NODE(n_new[1], true);
+  ASSERT_NODE(n_child[5], true);
+  ASSERT_NODE(n_child[6], true);
+  assert_graph_state_legal(&pt);
+
+  // Nodes array is full:
+  struct rk_node n_extra = {.name = "n_extra"};
+  ASSERT_ERR(rk_graph_add_child(&pt, &arena, &n_child[5], &n_extra));
+}
+
+void test_topo_enabled_edges(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_last));
+
+  // Enabled children cannot be added to disabled nodes:
+  ASSERT_ERR(rk_graph_add_child(&pt, &arena, &n_child[0], &n_child[CHILD_COUNT - 1]));
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[CHILD_COUNT - 1], &n_child[0]));
+
+  // Enabled clients cannot be added to disabled nodes:
+  ASSERT_ERR(rk_graph_add_client(&pt, &arena, &n_child[0], &c_last));
+  ASSERT_OK(rk_graph_add_client(&pt, &arena, &n_root, &c_last));
+
+  // Dependant counters are kept up to date:
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  ASSERT_NODE(n_root, true);
+  ASSERT_OK(rk_disable_client(&pt, &c_last));
+  for (size_t i = 0; i < pt.node_count; i++) {
+    ASSERT_NODE(*nodes[i], false);
+  }
+}
+
+void test_topo_invalid(void) {
+  // Not initialized:
+  ASSERT_ERR(rk_graph_add_child(&pt, &arena, &n_child[0], &n_child[1]));
+
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_ERR(rk_graph_add_child(0, &arena, &n_child[0], &n_child[1]));
+  ASSERT_ERR(rk_graph_add_child(&pt, &arena, 0, &n_child[1]));
+  ASSERT_ERR(rk_graph_add_child(&pt, &arena, &n_child[0], 0));
+  ASSERT_ERR(rk_graph_add_client(&pt, &arena, &n_child[0], 0));
+
+  // Node is not part of the graph:
+  ASSERT_ERR(rk_graph_add_child(&pt, &arena, &n_new[0], &n_child[1]));
+}
+
+void test_topo_enabled_new_node(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_last));
+
+  // A new node that is already enabled is not required by any client:
+  n_new[0].state = true;
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_root, &n_new[0]));
+  TEST_ASSERT_TRUE(n_new[0].ctx.dirty);
+  assert_graph_state_legal(&pt);
+
+  ASSERT_OK(rk_optimize_dirty(&pt));
+  ASSERT_NODE(n_new[0], false);
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_child[CHILD_COUNT - 1], true);
+}
+
+void test_topo_indices(void) {
+  static void *csr_buf[128];
+  static void *plans_buf[64];
+  static void *impact_buf[64];
+  static uint64_t bitset_buf[64];
+  struct rk_csr csr = {.buf = csr_buf, .buf_size = sizeof(csr_buf)};
+  struct rk_plans plans = {.buf = plans_buf, .buf_size = sizeof(plans_buf)};
+  struct rk_impact impact = {.buf = impact_buf, .buf_size = sizeof(impact_buf)};
+  struct rk_bitset bitset = {.buf = bitset_buf, .buf_size = sizeof(bitset_buf)};
+  pt.csr = &csr;
+  pt.plans = &plans;
+  pt.impact = &impact;
+  pt.bitset = &bitset;
+  ASSERT_OK(rk_init(&pt));
+
+  // Edges can be added without rk_init(). Indices are rebuilt by the next request:
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[0], &n_child[1]));
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[1], &n_child[CHILD_COUNT - 1]));
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[0], &n_new[0]));
+  ASSERT_OK(rk_graph_add_client(&pt, &arena, &n_new[0], &c_new));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_last));
+  assert_topo_order_valid();
+  TEST_ASSERT_EQUAL(4, c_last.plan_len);
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_child[0], true);
+  ASSERT_NODE(n_child[1], true);
+  ASSERT_NODE(n_child[2], false);
+  ASSERT_NODE(n_child[CHILD_COUNT - 1], true);
+  assert_graph_state_legal(&pt);
+
+  struct rk_client **clients = 0;
+  size_t count = 0;
+  ASSERT_OK(rk_node_impact(&pt, &n_child[0], &clients, &count));
+  TEST_ASSERT_EQUAL(2, count);
+
+  ASSERT_OK(rk_enable_client(&pt, &c_new));
+  ASSERT_OK(rk_optimize(&pt));
+  ASSERT_NODE(n_new[0], true);
+
+  // Requests fail while a buffer is too small to rebuild the indices:
+  csr.buf_size = 0;
+  ASSERT_OK(rk_graph_add_child(&pt, &arena, &n_child[2], &n_child[3]));
+  ASSERT_ERR(rk_disable_client(&pt, &c_last));
+  TEST_ASSERT_TRUE(c_last.enabled);
+
+  csr.buf_size = sizeof(csr_buf);
+  ASSERT_OK(rk_disable_client(&pt, &c_last));
+  ASSERT_OK(rk_disable_client(&pt, &c_new));
+  for (size_t i = 0; i < pt.node_count; i++) {
+    ASSERT_NODE(*nodes[i], false);
+  }
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) { init_graph(); }
+
+void tearDown(void) {}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_topo_reorder);
+  RUN_TEST(test_topo_random_edges);
+  RUN_TEST(test_topo_cycle);
+  RUN_TEST(test_topo_new_nodes);
+  RUN_TEST(test_topo_enabled_edges);
+  RUN_TEST(test_topo_invalid);
+  RUN_TEST(test_topo_enabled_new_node);
+  RUN_TEST(test_topo_indices);
+  return UNITY_END();
+}
@@ -0,0 +1,364 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+#include "resource_khan_ext.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |
+//          n_c
+//
+// All nodes have a single, identically named client (n_root -> c_root, n_a -> c_a etc).
+// n_b has no callback.
+//
+// Every call to the timestamp source advances time by one tick, and every callback takes 10 ticks.
+// Every node update with a callback therefore takes 12 ticks, and every request one tick plus its node updates.
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+#define N_ROOT 0
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+#define N_A 1
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+#define N_B 2
+struct rk_node n_b = {.name = "n_b"};
+#define N_C 3
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {[N_ROOT] = &n_root, [N_A] = &n_a, [N_B] = &n_b, [N_C] = &n_c};
+
+// TRACE:
+struct rk_trace_record records[8];
+uint32_t now = 0;
+
+uint32_t mock_timestamp(void) { return now++; }
+
+struct rk_trace trace = {.records = records, .record_count = 8, .cb_timestamp = mock_timestamp};
+
+struct rk_graph pt = {
+    .nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root, .trace = &trace};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_b = {.name = "c_b"};
+struct rk_client c_c = {.name = "c_c"};
+
+struct rk_client *clients[] = {&c_root, &c_a, &c_b, &c_c};
+
+struct rk_node *failing_node = 0;
+
+int mock_cb_update(const struct rk_node *self) {
+  now += 10;
+  return self == failing_node ? -1 : 0;
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_client(&n_a, &c_a);
+
+  rk_node_add_client(&n_b, &c_b);
+
+  rk_node_add_client(&n_c, &c_c);
+}
+
+void assert_record(uint32_t node, bool old_state, bool new_state, int cb_return, uint32_t duration) {
+  struct rk_trace_record record;
+  TEST_ASSERT_TRUE_MESSAGE(rk_trace_read(&trace, &record), "Trace is empty!");
+  TEST_ASSERT_EQUAL(node, record.node);
+  TEST_ASSERT_EQUAL(old_state, record.old_state);
+  TEST_ASSERT_EQUAL(new_state, record.new_state);
+  TEST_ASSERT_EQUAL(cb_return, record.cb_return);
+  TEST_ASSERT_EQUAL(duration, record.duration);
+  TEST_ASSERT_EQUAL(RK_TRACE_UPDATE, record.type);
+}
+
+void assert_request(uint32_t request, int err, uint32_t duration) {
+  struct rk_trace_record record;
+  TEST_ASSERT_TRUE_MESSAGE(rk_trace_read(&trace, &record), "Trace is empty!");
+  TEST_ASSERT_EQUAL(RK_TRACE_REQUEST, record.type);
+  TEST_ASSERT_EQUAL(request, record.node);
+  TEST_ASSERT_EQUAL(err, record.cb_return);
+  TEST_ASSERT_EQUAL(duration, record.duration);
+}
+
+void assert_trace_empty(void) {
+  struct rk_trace_record record;
+  TEST_ASSERT_FALSE_MESSAGE(rk_trace_read(&trace, &record), "Trace is not empty!");
+}
+
+// ======== Tests ==================================================================================
+
+void test_trace_enable_disable(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  assert_record(N_ROOT, false, true, 0, 11);
+  assert_record(N_A, false, true, 0, 11);
+  assert_record(N_C, false, true, 0, 11);
+  assert_request(RK_TRACE_ENABLE, 0, 37);
+  assert_trace_empty();
+
+  // Node without callback is only recorded if it changes state:
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+  assert_record(N_ROOT, true, true, 0, 11);
+  assert_record(N_B, false, true, 0, 1);
+  assert_request(RK_TRACE_ENABLE, 0, 15);
+  assert_trace_empty();
+
+  ASSERT_OK(rk_disable_client(&pt, &c_c));
+  assert_record(N_C, true, false, 0, 11);
+  assert_record(N_A, true, false, 0, 11);
+  assert_request(RK_TRACE_DISABLE, 0, 25);
+  assert_trace_empty();
+
+  TEST_ASSERT_EQUAL(0, trace.dropped);
+}
+
+void test_trace_timestamps(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  now = 100;
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+
+  struct rk_trace_record first;
+  struct rk_trace_record second;
+  struct rk_trace_record request;
+  TEST_ASSERT_TRUE(rk_trace_read(&trace, &first));
+  TEST_ASSERT_TRUE(rk_trace_read(&trace, &second));
+  TEST_ASSERT_TRUE(rk_trace_read(&trace, &request));
+  TEST_ASSERT_EQUAL(101, first.timestamp);
+  TEST_ASSERT_EQUAL(first.timestamp + first.duration + 1, second.timestamp);
+
+  // Request spans all of its updates:
+  TEST_ASSERT_EQUAL(100, request.timestamp);
+  TEST_ASSERT_EQUAL(second.timestamp + second.duration + 1, request.timestamp + request.duration);
+}
+
+void test_trace_failure(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  failing_node = &n_a;
+  ASSERT_ERR(rk_enable_client(&pt, &c_c));
+  assert_record(N_ROOT, false, true, 0, 11);
+  assert_record(N_A, false, false, -1, 11);
+  assert_request(RK_TRACE_ENABLE, -1, 25);
+  assert_trace_empty();
+}
+
+void test_trace_requests(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client_atomic(&pt, &c_b));
+  assert_record(N_ROOT, false, true, 0, 11);
+  assert_record(N_B, false, true, 0, 1);
+  assert_request(RK_TRACE_ENABLE_ATOMIC, 0, 15);
+  assert_trace_empty();
+
+  struct rk_client *enable_list[] = {&c_a};
+  struct rk_client *disable_list[] = {&c_b};
+  ASSERT_OK(rk_apply(&pt, enable_list, 1, disable_list, 1));
+  assert_record(N_B, true, false, 0, 1);
+  assert_record(N_ROOT, true, true, 0, 11);
+  assert_record(N_A, false, true, 0, 11);
+  assert_request(RK_TRACE_APPLY, 0, 27);
+  assert_trace_empty();
+
+  // Nodes without callback are not recorded if they do not change state:
+  ASSERT_OK(rk_optimize(&pt));
+  assert_record(N_C, false, false, 0, 11);
+  assert_record(N_A, true, true, 0, 11);
+  assert_record(N_ROOT, true, true, 0, 11);
+  assert_request(RK_TRACE_OPTIMIZE, 0, 38);
+  assert_trace_empty();
+}
+
+void test_trace_overflow(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+  ASSERT_OK(rk_disable_client(&pt, &c_b));
+  TEST_ASSERT_EQUAL(1, trace.dropped);
+
+  // Oldest records are kept:
+  assert_record(N_ROOT, false, true, 0, 11);
+  assert_record(N_A, false, true, 0, 11);
+  assert_record(N_C, false, true, 0, 11);
+  assert_request(RK_TRACE_ENABLE, 0, 37);
+  assert_record(N_ROOT, true, true, 0, 11);
+  assert_record(N_B, false, true, 0, 1);
+  assert_request(RK_TRACE_ENABLE, 0, 15);
+  assert_record(N_B, true, false, 0, 1);
+  assert_trace_empty();
+
+  // Buffer wraps around:
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+  assert_record(N_ROOT, true, true, 0, 11);
+  assert_record(N_B, false, true, 0, 1);
+  assert_request(RK_TRACE_ENABLE, 0, 15);
+  assert_trace_empty();
+}
+
+char json[4096];
+
+void out_to_json(const char *msg) { strncat(json, msg, sizeof(json) - strlen(json) - 1); }
+
+void test_trace_export(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  now = 1000;
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+
+  struct rk_trace_record drained[8];
+  size_t drained_count = 0;
+  while (rk_trace_read(&trace, &drained[drained_count])) {
+    drained_count++;
+  }
+  TEST_ASSERT_EQUAL(3, drained_count);
+
+  ASSERT_OK(rk_exporttrace_cb(&pt, drained, drained_count, 4, out_to_json));
+
+  // Track names:
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"tid\":0,\"args\":{\"name\":\"requests\"}"));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"tid\":2,\"args\":{\"name\":\"n_a\"}"));
+
+  // Updates, at 4 ticks per microsecond:
+  TEST_ASSERT_NOT_NULL(strstr(json, "{\"name\":\"n_root\",\"cat\":\"update\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                                    "\"ts\":250.250,\"dur\":2.750,"
+                                    "\"args\":{\"old_state\":\"OFF\",\"new_state\":\"ON\",\"return\":0}}"));
+  TEST_ASSERT_NOT_NULL(strstr(json, "{\"name\":\"n_a\",\"cat\":\"update\",\"ph\":\"X\",\"pid\":1,\"tid\":2,"
+                                    "\"ts\":253.250,"));
+
+  // n_a waited for n_root:
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"new_state\":\"ON\",\"waits_for\":[\"n_root\"],\"return\":0}}"));
+  TEST_ASSERT_NOT_NULL(strstr(json, "{\"name\":\"wait\",\"cat\":\"dependency\",\"ph\":\"s\",\"id\":0,"
+                                    "\"pid\":1,\"tid\":1,\"ts\":250.250}"));
+  TEST_ASSERT_NOT_NULL(strstr(json, "{\"name\":\"wait\",\"cat\":\"dependency\",\"ph\":\"f\",\"bp\":\"e\","
+                                    "\"id\":0,\"pid\":1,\"tid\":2,\"ts\":253.250}"));
+  TEST_ASSERT_NULL(strstr(json, "\"id\":1,"));
+
+  // Request:
+  TEST_ASSERT_NOT_NULL(strstr(json, "{\"name\":\"rk_enable_client\",\"cat\":\"request\",\"ph\":\"X\","
+                                    "\"pid\":1,\"tid\":0,\"ts\":250.000,\"dur\":6.250,\"args\":{\"return\":0}}"));
+
+  TEST_ASSERT_EQUAL_STRING_LEN("{\"traceEvents\":[", json, 16);
+  TEST_ASSERT_EQUAL_STRING("]}\r\n", &json[strlen(json) - 4]);
+
+  // Invalid records are rejected without output:
+  json[0] = '\0';
+  drained[drained_count - 1].node = RK_TRACE_RECOVER + 1;
+  ASSERT_ERR(rk_exporttrace_cb(&pt, drained, drained_count, 4, out_to_json));
+  drained[drained_count - 1].node = RK_TRACE_ENABLE;
+  drained[1].node = 4;
+  ASSERT_ERR(rk_exporttrace_cb(&pt, drained, drained_count, 4, out_to_json));
+  drained[1].node = N_A;
+  drained[1].type = 2;
+  ASSERT_ERR(rk_exporttrace_cb(&pt, drained, drained_count, 4, out_to_json));
+  drained[1].type = RK_TRACE_UPDATE;
+  TEST_ASSERT_EQUAL_STRING("", json);
+
+  ASSERT_ERR(rk_exporttrace_cb(&pt, drained, drained_count, 0, out_to_json));
+  ASSERT_ERR(rk_exporttrace_cb(&pt, 0, drained_count, 4, out_to_json));
+  ASSERT_ERR(rk_exporttrace_cb(&pt, drained, drained_count, 4, 0));
+
+  // When disabling, n_root waits for n_a:
+  ASSERT_OK(rk_disable_client(&pt, &c_a));
+  drained_count = 0;
+  while (rk_trace_read(&trace, &drained[drained_count])) {
+    drained_count++;
+  }
+  json[0] = '\0';
+  ASSERT_OK(rk_exporttrace_cb(&pt, drained, drained_count, 4, out_to_json));
+  TEST_ASSERT_NOT_NULL(strstr(json, "{\"name\":\"n_root\",\"cat\":\"update\","));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"new_state\":\"OFF\",\"waits_for\":[\"n_a\"],\"return\":0}}"));
+
+  // Node names are escaped:
+  char name_a[sizeof(n_a.name)];
+  strcpy(name_a, n_a.name);
+  strcpy(n_a.name, "n_\"a\\\n");
+  json[0] = '\0';
+  ASSERT_OK(rk_exporttrace_cb(&pt, drained, drained_count, 4, out_to_json));
+  strcpy(n_a.name, name_a);
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"tid\":2,\"args\":{\"name\":\"n_\\\"a\\\\\\u000a\"}"));
+  TEST_ASSERT_NOT_NULL(strstr(json, "{\"name\":\"n_\\\"a\\\\\\u000a\",\"cat\":\"update\","));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"waits_for\":[\"n_\\\"a\\\\\\u000a\"]"));
+
+  // Escaped names may be longer than the buffer used while escaping them:
+  char escaped[2 * RK_MAX_NAME_LEN + 1] = {0};
+  for (size_t i = 0; i < RK_MAX_NAME_LEN; i++) {
+    n_a.name[i] = '"';
+    strcat(escaped, "\\\"");
+  }
+  n_a.name[RK_MAX_NAME_LEN] = '\0';
+  json[0] = '\0';
+  ASSERT_OK(rk_exporttrace_cb(&pt, drained, drained_count, 4, out_to_json));
+  strcpy(n_a.name, name_a);
+  TEST_ASSERT_NOT_NULL(strstr(json, escaped));
+}
+
+void test_trace_invalid(void) {
+  trace.record_count = 3;
+  ASSERT_ERR(rk_init(&pt));
+  trace.record_count = 0;
+  ASSERT_ERR(rk_init(&pt));
+  trace.record_count = 8;
+  ASSERT_OK(rk_init(&pt));
+
+  // Invalid requests are rejected before they are started, and not recorded:
+  struct rk_client *invalid_list[] = {&c_a, 0};
+  ASSERT_ERR(rk_apply(&pt, invalid_list, 2, 0, 0));
+  ASSERT_ERR(rk_apply(&pt, 0, 0, invalid_list, 2));
+  assert_trace_empty();
+
+  struct rk_trace_record record;
+  TEST_ASSERT_FALSE(rk_trace_read(0, &record));
+  TEST_ASSERT_FALSE(rk_trace_read(&trace, 0));
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+  memset(records, 0, sizeof(records));
+  trace.head = 0;
+  trace.tail = 0;
+  trace.dropped = 0;
+  failing_node = 0;
+  json[0] = '\0';
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_trace_enable_disable);
+  RUN_TEST(test_trace_timestamps);
+  RUN_TEST(test_trace_failure);
+  RUN_TEST(test_trace_requests);
+  RUN_TEST(test_trace_overflow);
+  RUN_TEST(test_trace_export);
+  RUN_TEST(test_trace_invalid);
+  return UNITY_END();
+}
@@ -0,0 +1,237 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//          n_c        |
+//           |         |
+//           +---+ +---+
+//               | |
+//               n_d
+//
+// All nodes have a single, identically named client (n_root -> c_root, n_a -> c_a etc).
+//
+// Node callbacks are only called on transitions.
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+#define N_ROOT 0
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+#define N_A 1
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+#define N_B 2
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+#define N_C 3
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+#define N_D 4
+struct rk_node n_d = {.name = "n_d", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {[N_ROOT] = &n_root, [N_A] = &n_a, [N_B] = &n_b, [N_C] = &n_c, [N_D] = &n_d};
+struct rk_graph pt = {
+    .nodes = nodes, .node_count = sizeof(nodes) / sizeof(nodes[0]), .root = &n_root, .transitions_only = true};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_b = {.name = "c_b"};
+struct rk_client c_c = {.name = "c_c"};
+struct rk_client c_d = {.name = "c_d"};
+
+struct rk_client *clients[] = {&c_root, &c_a, &c_b, &c_c, &c_d};
+
+bool node_cb_called[sizeof(nodes) / sizeof(nodes[0])] = {0};
+struct rk_node *failing_node = 0;
+
+int mock_cb_update(const struct rk_node *self) {
+  assert_graph_state_legal(&pt);
+  if (pt.transitions_only || self->transitions_only) {
+    TEST_ASSERT_MESSAGE(self->state != self->desired_state, "Callback called without transition!");
+  }
+  // Track that the callback for this node was called:
+  for (size_t i = 0; i < pt.node_count; i++) {
+    if (pt.nodes[i] == self) {
+      node_cb_called[i] = true;
+      return self == failing_node ? -1 : 0;
+    }
+  }
+  TEST_FAIL(); // Node not in nodes array?!
+}
+
+void init_graph(void) {
+
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_client(&n_a, &c_a);
+
+  rk_node_add_child(&n_b, &n_d);
+  rk_node_add_client(&n_b, &c_b);
+
+  rk_node_add_child(&n_c, &n_d);
+  rk_node_add_client(&n_c, &c_c);
+
+  rk_node_add_client(&n_d, &c_d);
+}
+
+void assert_correct_callbacks_called(bool *is, bool *expected, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (is[i] != expected[i]) {
+      if (is[i]) {
+        TEST_FAIL_MESSAGE("Callback was called, but it should not have been!");
+      } else {
+        TEST_FAIL_MESSAGE("Callback was not called, but it should have been!");
+      }
+    }
+  }
+}
+
+// ======== Tests ==================================================================================
+
+void test_transitions_enable(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  memset(node_cb_called, 0, sizeof(node_cb_called));
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  bool expected1[] = {[N_ROOT] = true, [N_A] = true, [N_B] = false, [N_C] = true, [N_D] = false};
+  assert_correct_callbacks_called(node_cb_called, expected1, pt.node_count);
+  TEST_ASSERT_EQUAL(0, pt.cb_elided);
+
+  // n_root is already on:
+  memset(node_cb_called, 0, sizeof(node_cb_called));
+  ASSERT_OK(rk_enable_client(&pt, &c_b));
+  bool expected2[] = {[N_ROOT] = false, [N_A] = false, [N_B] = true, [N_C] = false, [N_D] = false};
+  assert_correct_callbacks_called(node_cb_called, expected2, pt.node_count);
+  TEST_ASSERT_EQUAL(1, pt.cb_elided);
+  TEST_ASSERT_EQUAL(1, n_root.cb_elided);
+
+  // All parents are already on:
+  memset(node_cb_called, 0, sizeof(node_cb_called));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  bool expected3[] = {[N_ROOT] = false, [N_A] = false, [N_B] = false, [N_C] = false, [N_D] = true};
+  assert_correct_callbacks_called(node_cb_called, expected3, pt.node_count);
+  TEST_ASSERT_EQUAL(3, pt.cb_elided);
+
+  // Nothing changes:
+  memset(node_cb_called, 0, sizeof(node_cb_called));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  bool expected4[] = {[N_ROOT] = false, [N_A] = false, [N_B] = false, [N_C] = false, [N_D] = false};
+  assert_correct_callbacks_called(node_cb_called, expected4, pt.node_count);
+  TEST_ASSERT_EQUAL(4, pt.cb_elided);
+}
+
+void test_transitions_disable(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_c));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  pt.cb_elided = 0;
+
+  // n_c remains on for c_c, and neither it nor its parents are visited:
+  memset(node_cb_called, 0, sizeof(node_cb_called));
+  ASSERT_OK(rk_disable_client(&pt, &c_d));
+  bool expected1[] = {[N_ROOT] = false, [N_A] = false, [N_B] = true, [N_C] = false, [N_D] = true};
+  assert_correct_callbacks_called(node_cb_called, expected1, pt.node_count);
+  TEST_ASSERT_EQUAL(0, pt.cb_elided);
+
+  memset(node_cb_called, 0, sizeof(node_cb_called));
+  ASSERT_OK(rk_disable_client(&pt, &c_c));
+  bool expected2[] = {[N_ROOT] = true, [N_A] = true, [N_B] = false, [N_C] = true, [N_D] = false};
+  assert_correct_callbacks_called(node_cb_called, expected2, pt.node_count);
+  TEST_ASSERT_EQUAL(0, pt.cb_elided);
+}
+
+void test_transitions_apply_optimize(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+
+  memset(node_cb_called, 0, sizeof(node_cb_called));
+  struct rk_client *enable_list[] = {&c_b};
+  struct rk_client *disable_list[] = {&c_a};
+  ASSERT_OK(rk_apply(&pt, enable_list, 1, disable_list, 1));
+  bool expected1[] = {[N_ROOT] = false, [N_A] = true, [N_B] = true, [N_C] = false, [N_D] = false};
+  assert_correct_callbacks_called(node_cb_called, expected1, pt.node_count);
+
+  // Only n_b is enabled. Optimizing does not change anything:
+  memset(node_cb_called, 0, sizeof(node_cb_called));
+  pt.cb_elided = 0;
+  ASSERT_OK(rk_optimize(&pt));
+  bool expected2[] = {[N_ROOT] = false, [N_A] = false, [N_B] = false, [N_C] = false, [N_D] = false};
+  assert_correct_callbacks_called(node_cb_called, expected2, pt.node_count);
+  TEST_ASSERT_EQUAL(pt.node_count, pt.cb_elided);
+}
+
+void test_transitions_per_node(void) {
+  pt.transitions_only = false;
+  n_root.transitions_only = true;
+  ASSERT_OK(rk_init(&pt));
+
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+
+  memset(node_cb_called, 0, sizeof(node_cb_called));
+  ASSERT_OK(rk_enable_client(&pt, &c_d));
+  bool expected[] = {[N_ROOT] = false, [N_A] = true, [N_B] = true, [N_C] = true, [N_D] = true};
+  assert_correct_callbacks_called(node_cb_called, expected, pt.node_count);
+  TEST_ASSERT_EQUAL(1, n_root.cb_elided);
+  TEST_ASSERT_EQUAL(0, n_a.cb_elided);
+  TEST_ASSERT_EQUAL(1, pt.cb_elided);
+}
+
+// Callbacks that were elided do not change previous_cb_return:
+void test_transitions_previous_cb_return(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  failing_node = &n_b;
+  ASSERT_ERR(rk_enable_client(&pt, &c_b));
+  failing_node = 0;
+  TEST_ASSERT_EQUAL(-1, n_b.previous_cb_return);
+  TEST_ASSERT_EQUAL(0, n_root.previous_cb_return);
+
+  ASSERT_OK(rk_optimize(&pt));
+  TEST_ASSERT_EQUAL(-1, n_b.previous_cb_return);
+  TEST_ASSERT_FALSE(n_root.state);
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+    pt.nodes[i]->transitions_only = false;
+    pt.nodes[i]->cb_elided = 0;
+  }
+  for (size_t i = 0; i < (sizeof(clients) / sizeof(clients[0])); i++) {
+    clients[i]->enabled = false;
+  }
+  pt.transitions_only = true;
+  pt.cb_elided = 0;
+  failing_node = 0;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_transitions_enable);
+  RUN_TEST(test_transitions_disable);
+  RUN_TEST(test_transitions_apply_optimize);
+  RUN_TEST(test_transitions_per_node);
+  RUN_TEST(test_transitions_previous_cb_return);
+  return UNITY_END();
+}
@@ -0,0 +1,191 @@
+#include "stdlib.h"
+#include "string.h"
+#include "unity.h"
+#include "unity_internals.h"
+#include "utils.h"
+
+#include "resource_khan.h"
+
+// ======== Resource Graph =========================================================================
+
+//
+//              n_root
+//                |
+//           +----+----+
+//           |         |
+//          n_a       n_b
+//           |         |
+//           +----+----+
+//                |
+//               n_c
+//                |
+//               n_d
+//
+// Clients: c_root (n_root), c_a (n_a), c_c (n_c), c_d (n_d) and c_bd (n_b and n_d).
+
+int mock_cb_update(const struct rk_node *self);
+
+// NODES:
+struct rk_node n_root = {.name = "n_root", .cb_update = mock_cb_update};
+struct rk_node n_a = {.name = "n_a", .cb_update = mock_cb_update};
+struct rk_node n_b = {.name = "n_b", .cb_update = mock_cb_update};
+struct rk_node n_c = {.name = "n_c", .cb_update = mock_cb_update};
+struct rk_node n_d = {.name = "n_d", .cb_update = mock_cb_update};
+
+struct rk_node *nodes[] = {&n_d, &n_root, &n_c, &n_b, &n_a};
+
+#define NODE_COUNT (sizeof(nodes) / sizeof(nodes[0]))
+
+struct rk_graph pt = {.nodes = nodes, .node_count = NODE_COUNT, .root = &n_root};
+
+// CLIENTS:
+struct rk_client c_root = {.name = "c_root"};
+struct rk_client c_a = {.name = "c_a"};
+struct rk_client c_c = {.name = "c_c"};
+struct rk_client c_d = {.name = "c_d"};
+struct rk_client c_bd = {.name = "c_bd"};
+
+struct rk_client *clients[] = {&c_root, &c_a, &c_c, &c_d, &c_bd};
+
+#define CLIENT_COUNT (sizeof(clients) / sizeof(clients[0]))
+
+// MOCK:
+size_t cb_calls = 0;
+
+int mock_cb_update(const struct rk_node *self) {
+  (void)self;
+  cb_calls++;
+  return 0;
+}
+
+void init_graph(void) {
+  rk_node_add_child(&n_root, &n_a);
+  rk_node_add_child(&n_root, &n_b);
+  rk_node_add_client(&n_root, &c_root);
+
+  rk_node_add_child(&n_a, &n_c);
+  rk_node_add_child(&n_b, &n_c);
+  rk_node_add_client(&n_a, &c_a);
+  rk_node_add_client(&n_b, &c_bd);
+
+  rk_node_add_child(&n_c, &n_d);
+  rk_node_add_client(&n_c, &c_c);
+
+  rk_node_add_client(&n_d, &c_d);
+  rk_node_add_client(&n_d, &c_bd);
+}
+
+// ======== Tests ==================================================================================
+
+void test_what_if_all_configurations(void) {
+  ASSERT_OK(rk_init(&pt));
+
+  // Configuration k enables every client i for which bit i of k is set. The 32 configurations
+  // cover all combinations of the five clients:
+  uint64_t enabled[CLIENT_COUNT] = {0};
+  for (uint64_t config = 0; config < (1u << CLIENT_COUNT); config++) {
+    for (size_t i = 0; i < CLIENT_COUNT; i++) {
+      if (config & (1u << i)) enabled[i] |= (uint64_t)1 << config;
+    }
+  }
+
+  uint64_t node_on[NODE_COUNT];
+  uint32_t on_count[64];
+  ASSERT_OK(rk_what_if(&pt, clients, enabled, CLIENT_COUNT, node_on, on_count));
+  TEST_ASSERT_EQUAL(0, cb_calls);
+
+  // Compare every configuration against the state reached by enabling its clients:
+  for (uint64_t config = 0; config < (1u << CLIENT_COUNT); config++) {
+    for (size_t i = 0; i < NODE_COUNT; i++) {
+      nodes[i]->state = false;
+    }
+    ASSERT_OK(rk_init(&pt));
+    uint32_t expected_count = 0;
+    for (size_t i = 0; i < CLIENT_COUNT; i++) {
+      clients[i]->enabled = false;
+      if (config & (1u << i)) ASSERT_OK(rk_enable_client(&pt, clients[i]));
+    }
+
+    for (size_t i = 0; i < NODE_COUNT; i++) {
+      bool on = (node_on[i] >> config) & 1;
+      TEST_ASSERT_EQUAL_MESSAGE(nodes[i]->state, on, nodes[i]->name);
+      expected_count += nodes[i]->state ? 1 : 0;
+    }
+    TEST_ASSERT_EQUAL(expected_count, on_count[config]);
+  }
+
+  // Unused configurations are empty:
+  for (size_t config = (1u << CLIENT_COUNT); config < 64; config++) {
+    TEST_ASSERT_EQUAL(0, on_count[config]);
+  }
+}
+
+void test_what_if_no_side_effects(void) {
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_OK(rk_enable_client(&pt, &c_a));
+  cb_calls = 0;
+
+  // Clients that are not listed are disabled in every configuration, regardless of their state:
+  struct rk_client *what_if_clients[] = {&c_d};
+  uint64_t enabled[] = {0x2};
+  uint64_t node_on[NODE_COUNT];
+  ASSERT_OK(rk_what_if(&pt, what_if_clients, enabled, 1, node_on, 0));
+
+  TEST_ASSERT_EQUAL_HEX64(0x2, node_on[0]); // n_d
+  TEST_ASSERT_EQUAL_HEX64(0x2, node_on[1]); // n_root
+  TEST_ASSERT_EQUAL_HEX64(0x2, node_on[2]); // n_c
+  TEST_ASSERT_EQUAL_HEX64(0x2, node_on[3]); // n_b
+  TEST_ASSERT_EQUAL_HEX64(0x2, node_on[4]); // n_a
+
+  // Graph is unchanged:
+  TEST_ASSERT_EQUAL(0, cb_calls);
+  TEST_ASSERT_TRUE(c_a.enabled);
+  ASSERT_NODE(n_root, true);
+  ASSERT_NODE(n_a, true);
+  ASSERT_NODE(n_b, false);
+  ASSERT_NODE(n_c, false);
+  ASSERT_NODE(n_d, false);
+  assert_graph_state_legal(&pt);
+}
+
+void test_what_if_invalid(void) {
+  uint64_t enabled[] = {1};
+  uint64_t node_on[NODE_COUNT];
+  struct rk_client *invalid_clients[] = {0};
+
+  ASSERT_OK(rk_init(&pt));
+  ASSERT_ERR(rk_what_if(0, clients, enabled, 1, node_on, 0));
+  ASSERT_ERR(rk_what_if(&pt, 0, enabled, 1, node_on, 0));
+  ASSERT_ERR(rk_what_if(&pt, clients, 0, 1, node_on, 0));
+  ASSERT_ERR(rk_what_if(&pt, clients, enabled, 1, 0, 0));
+  ASSERT_ERR(rk_what_if(&pt, invalid_clients, enabled, 1, node_on, 0));
+
+  // No clients:
+  ASSERT_OK(rk_what_if(&pt, 0, 0, 0, node_on, 0));
+  for (size_t i = 0; i < NODE_COUNT; i++) {
+    TEST_ASSERT_EQUAL_HEX64(0, node_on[i]);
+  }
+}
+
+// ======== Main ===================================================================================
+
+void setUp(void) {
+  for (size_t i = 0; i < pt.node_count; i++) {
+    pt.nodes[i]->state = false;
+  }
+  for (size_t i = 0; i < CLIENT_COUNT; i++) {
+    clients[i]->enabled = false;
+  }
+  cb_calls = 0;
+}
+
+void tearDown(void) {}
+
+int main(void) {
+  init_graph();
+  UNITY_BEGIN();
+  RUN_TEST(test_what_if_all_configurations);
+  RUN_TEST(test_what_if_no_side_effects);
+  RUN_TEST(test_what_if_invalid);
+  return UNITY_END();
+}